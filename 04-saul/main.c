@@ -6,14 +6,247 @@
  * directory for more details.
  */
 
+#include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "fmt.h"
+#include "mutex.h"
 #include "ztimer.h"
 #include "phydat.h"
+#include "phydat_stats.h"
+#include "phydat_ts.h"
 #include "saul_reg.h"
+#include "saul_sampler.h"
+#include "shell.h"
+#include "thread.h"
+#include "thread_flags.h"
 #include "board.h"
 
-#define TEMPERATURE_THRESHOLD 2600 /* factor of 10^-3 */
+#define TEMPERATURE_THRESHOLD  2600 /* factor of 10^-3 */
+
+/* the LED only switches back once the temperature dropped this much below the
+ * threshold, so noise around the threshold does not make it flicker */
+#define TEMPERATURE_HYSTERESIS 100
+
+#define TEMPERATURE_PERIOD     500  /* ms between two temperature reads */
+
+#define STATS_WINDOW           (60U * MS_PER_SEC) /* aggregation window, ms */
+
+/* the temperature history keeps one sample of this period, in ms. Slowly
+ * changing values take about two bytes per sample, so the blocks hold a few
+ * hours of history */
+#define HISTORY_PERIOD         (10U * MS_PER_SEC)
+#define HISTORY_BLOCKS         8
+
+#define HISTORY_SHOW           300  /* seconds shown by default */
+
+/* statistics of each sampled device, by sampler index */
+static phydat_stats_t _stats[CONFIG_SAUL_SAMPLER_DEVS_MAX];
+static mutex_t _stats_lock = MUTEX_INIT;
+
+static saul_sampler_cursor_t _cursor;
+static int _temp_idx;
+static phydat_stats_hyst_t _temp_hyst;
+
+static phydat_ts_block_t _history_blocks[HISTORY_BLOCKS];
+static phydat_ts_t _history;
+static uint32_t _history_last;
+static mutex_t _history_lock = MUTEX_INIT;
+
+static char _samples_stack[THREAD_STACKSIZE_MAIN];
+
+static void _stats_reset(void)
+{
+    uint32_t now = ztimer_now(ZTIMER_MSEC);
+
+    mutex_lock(&_stats_lock);
+    for (unsigned i = 0; i < ARRAY_SIZE(_stats); i++) {
+        phydat_stats_init(&_stats[i], STATS_WINDOW, now);
+    }
+    mutex_unlock(&_stats_lock);
+}
+
+static void _handle_sample(const saul_sampler_sample_t *sample)
+{
+    mutex_lock(&_stats_lock);
+    phydat_stats_add(&_stats[sample->dev], &sample->data, sample->dims,
+                     sample->time);
+    mutex_unlock(&_stats_lock);
+
+    /* [TASK 3: handle the acceleration samples here ] */
+
+    if (sample->dev != _temp_idx) {
+        return;
+    }
+
+    mutex_lock(&_history_lock);
+    if (!_history.used || sample->time - _history_last >= HISTORY_PERIOD) {
+        if (phydat_ts_append(&_history, sample->time, &sample->data, 1) < 0) {
+            printf("History: sample at %" PRIu32 " ms is out of order\n",
+                   sample->time);
+        }
+        _history_last = sample->time;
+    }
+    mutex_unlock(&_history_lock);
+
+    /* only report when the temperature crossed the threshold band */
+    if (!phydat_stats_hyst_update(&_temp_hyst, sample->data.val[0])) {
+        return;
+    }
+    if (_temp_hyst.on) {
+        puts("Temperature above threshold");
+        LED0_ON;
+        LED1_OFF;
+    }
+    else {
+        puts("Temperature below threshold");
+        LED0_OFF;
+        LED1_ON;
+    }
+}
+
+/* processes the samples stored by the sampler */
+static void *_samples_thread(void *arg)
+{
+    (void)arg;
+
+    while (1) {
+        /* wait until the sampler stored new samples */
+        thread_flags_wait_any(CONFIG_SAUL_SAMPLER_NOTIFY_FLAG);
+
+        saul_sampler_sample_t sample;
+        int res;
+        while ((res = saul_sampler_read(&_cursor, &sample)) != 0) {
+            if (res == -EOVERFLOW) {
+                puts("Some samples were lost");
+            }
+            _handle_sample(&sample);
+        }
+    }
+
+    return NULL;
+}
+
+static void _print_value(const char *label, const phydat_t *value)
+{
+    char str[16];
+    size_t len;
+
+    if (value->scale < 0) {
+        len = fmt_s16_dfp(str, value->val[0], -value->scale);
+    }
+    else {
+        len = fmt_s32_dec(str, value->val[0]);
+        for (int i = 0; i < value->scale && len < sizeof(str); i++) {
+            str[len++] = '0';
+        }
+    }
+    printf(" %s %.*s", label, (int)len, str);
+}
+
+static void _print_stats(int idx)
+{
+    phydat_stats_t stats;
+    phydat_stats_summary_t summary;
+
+    mutex_lock(&_stats_lock);
+    stats = _stats[idx];
+    mutex_unlock(&_stats_lock);
+
+    printf("[%d] %s: %" PRIu32 " samples, unit %s\n", idx,
+           saul_sampler_dev(idx)->name, stats.count,
+           phydat_unit_to_str(stats.unit));
+
+    for (unsigned d = 0; phydat_stats_summary(&stats, d, &summary); d++) {
+        printf("  [%u]", d);
+        _print_value("min", &summary.min);
+        _print_value("max", &summary.max);
+        _print_value("mean", &summary.mean);
+        _print_value("sd", &summary.stddev);
+        _print_value("ewma", &summary.ewma);
+        puts("");
+
+        if (phydat_stats_window(&stats, d, &summary)) {
+            printf("      last %u s:", (unsigned)(STATS_WINDOW / MS_PER_SEC));
+            _print_value("min", &summary.min);
+            _print_value("max", &summary.max);
+            _print_value("mean", &summary.mean);
+            puts("");
+        }
+    }
+}
+
+static int _stats_cmd(int argc, char **argv)
+{
+    if (argc == 2 && !strcmp(argv[1], "reset")) {
+        _stats_reset();
+        return 0;
+    }
+    if (argc > 2) {
+        printf("usage: %s [<index>|reset]\n", argv[0]);
+        return 1;
+    }
+
+    for (int i = 0; i < (int)CONFIG_SAUL_SAMPLER_DEVS_MAX; i++) {
+        if (saul_sampler_dev(i) && (argc == 1 || atoi(argv[1]) == i)) {
+            _print_stats(i);
+        }
+    }
+    return 0;
+}
+
+SHELL_COMMAND(stats, "Show statistics of the sampled sensors", _stats_cmd);
+
+static int _history_cmd(int argc, char **argv)
+{
+    uint32_t seconds = HISTORY_SHOW;
+
+    if (argc > 2) {
+        printf("usage: %s [<seconds>]\n", argv[0]);
+        return 1;
+    }
+    if (argc == 2) {
+        seconds = strtoul(argv[1], NULL, 10);
+    }
+
+    uint32_t now = ztimer_now(ZTIMER_MSEC);
+    /* the store compares times across a wrap of the clock, within 2^31 ms */
+    uint32_t span = MIN(seconds, INT32_MAX / MS_PER_SEC) * MS_PER_SEC;
+    uint32_t from = now - span;
+
+    /* appending invalidates the iterator, hold the lock while printing */
+    mutex_lock(&_history_lock);
+
+    phydat_ts_iter_t it;
+    phydat_t data;
+    uint32_t time;
+    int res;
+
+    phydat_ts_iter_init(&_history, &it, from, now);
+    while ((res = phydat_ts_iter_next(&it, &time, &data)) > 0) {
+        printf("-%5" PRIu32 " s", (uint32_t)((now - time) / MS_PER_SEC));
+        _print_value("", &data);
+        puts("");
+    }
+
+    phydat_ts_usage_t usage;
+    phydat_ts_usage(&_history, &usage);
+    mutex_unlock(&_history_lock);
+
+    if (res < 0) {
+        printf("Could not read the history: %d\n", res);
+    }
+    printf("%" PRIu32 " samples of the last %" PRIu32 " s in %" PRIu32
+           " bytes\n", usage.samples,
+           (uint32_t)((usage.last - usage.first) / MS_PER_SEC),
+           usage.bytes);
+    return 0;
+}
+
+SHELL_COMMAND(history, "Show the temperature history", _history_cmd);
 
 int main(void)
 {
@@ -29,38 +262,37 @@ int main(void)
         printf("Found temperature device: %s\n", temp_sensor->name);
     }
 
-    /* [TASK 3: find your device here] */
+    /* the sampler reads the sensors in the background and wakes up the
+     * samples thread when there are new samples, start with the first one */
+    _stats_reset();
+    phydat_ts_init(&_history, _history_blocks, ARRAY_SIZE(_history_blocks));
+    saul_sampler_cursor_init(&_cursor);
+    phydat_stats_hyst_init(&_temp_hyst, TEMPERATURE_THRESHOLD,
+                           TEMPERATURE_THRESHOLD - TEMPERATURE_HYSTERESIS);
 
-    /* record the starting time */
-    ztimer_now_t last_wakeup = ztimer_now(ZTIMER_MSEC);
-
-    while (1) {
-        /* read a temperature value from the sensor */
-        phydat_t temperature;
-        int dimensions = saul_reg_read(temp_sensor, &temperature);
-        if (dimensions < 1) {
-            puts("Error reading a value from the device");
-            break;
-        }
+    _temp_idx = saul_sampler_add(temp_sensor, TEMPERATURE_PERIOD);
+    if (_temp_idx < 0) {
+        puts("Could not sample the temperature device");
+        return 1;
+    }
 
-        /* dump the read value to STDIO */
-        phydat_dump(&temperature, dimensions);
+    /* [TASK 3: find your device here and add it to the sampler] */
 
-        /* [TASK 3: perform the acceleration read here ] */
+    /* samples are processed at a lower priority than the sampler runs */
+    kernel_pid_t pid = thread_create(_samples_stack, sizeof(_samples_stack),
+                                     CONFIG_SAUL_SAMPLER_PRIO + 1,
+                                     THREAD_CREATE_STACKTEST, _samples_thread,
+                                     NULL, "samples");
+    saul_sampler_notify(thread_get(pid));
+    saul_sampler_init();
 
-        /* check if the temperature value is above the threshold */
-        if (temperature.val[0] >= TEMPERATURE_THRESHOLD) {
-            LED0_ON;
-            LED1_OFF;
-        }
-        else {
-            LED0_OFF;
-            LED1_ON;
-        }
+    /* LEDs start in the state below the threshold */
+    LED0_OFF;
+    LED1_ON;
 
-        /* wait for 500 ms */
-        ztimer_periodic_wakeup(ZTIMER_MSEC, &last_wakeup, 500);
-    }
+    /* the statistics and the history can be queried from the shell */
+    char line_buf[SHELL_DEFAULT_BUFSIZE];
+    shell_run(NULL, line_buf, SHELL_DEFAULT_BUFSIZE);
 
     return 0;
 }
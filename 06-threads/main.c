@@ -14,6 +14,10 @@
 
 /* [TASK 1: create the thread handler and stack here] */
 
+/* [TASK 2: include worker_pool.h, create the pool and the jobs here] */
+
+/* [TASK 3: include ptask.h, create the blinky task here] */
+
 int main(void)
 {
     puts("Threads example");
@@ -23,9 +27,14 @@ int main(void)
 
     /* [TASK 1: create the thread here] */
 
+    /* [TASK 2: start the pool and initialize the jobs here] */
+
+    /* [TASK 3: start the blinky task here] */
+
     while (1) {
         printf("Thread %s\n", this_thread_name);
         LED0_TOGGLE;
+        /* [TASK 2: submit the jobs here] */
         ztimer_sleep(ZTIMER_MSEC, 1000);
     }
 
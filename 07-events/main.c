@@ -21,6 +21,12 @@
 
 /* [TASK 2: instantiate queue and event here] */
 
+/* [TASK 3: include irq_event.h, create the batch handler and the
+ * interrupt event here] */
+
+/* [TASK 4: include event_edf.h and shell.h, create the EDF queue, the report
+ * event and the thread running the queue here] */
+
 void button_callback(void *arg)
 {
     (void) arg;    /* Not used */
@@ -32,12 +38,19 @@ int main(void)
 {
     puts("Threads and event queue example.");
 
+    /* [TASK 3: initialize the interrupt event and pass irq_event_isr to
+     * gpio_init_int instead of button_callback] */
+
     /* Setup button callback */
     if (gpio_init_int(BTN0_PIN, BTN0_MODE, GPIO_FALLING, button_callback, NULL) < 0) {
         puts("[FAILED] init BTN0!");
         return 1;
     }
 
+    /* [TASK 4: initialize the EDF queue, post the report periodically, run
+     * event_edf_loop in a thread of its own and the shell instead of the loop
+     * below] */
+
     while (1) {
         puts("Main");
         ztimer_sleep(ZTIMER_MSEC, 1000);
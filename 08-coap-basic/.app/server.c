@@ -6,6 +6,7 @@
  * directory for more details.
  */
 
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -13,33 +14,146 @@
 
 #include "fmt.h"
 #include "net/gcoap.h"
+#include "net/sock/util.h"
 #include "net/utils.h"
 #include "od.h"
 
 #include "saul_reg.h"
 #include "phydat.h"
+#include "senml/saul.h"
 #include "assert.h"
 
+#include "container.h"
+#include "event/thread.h"
+#include "event/timeout.h"
+#include "mutex.h"
+#include "random.h"
+#include "shell.h"
+#include "ztimer.h"
+
 #include "gcoap_example.h"
 
+/* Interval in which observed resources are checked for changes, in ms */
+#ifndef CONFIG_SENSE_OBS_CHECK_INTERVAL
+#define CONFIG_SENSE_OBS_CHECK_INTERVAL     (1U * MS_PER_SEC)
+#endif
+
+/* Maximum time between two notifications, even if the value did not change,
+ * in ms */
+#ifndef CONFIG_SENSE_OBS_MAX_INTERVAL
+#define CONFIG_SENSE_OBS_MAX_INTERVAL       (60U * MS_PER_SEC)
+#endif
+
+/* Minimum change of the first dimension (in units of the device scale) that
+ * triggers a notification */
+#ifndef CONFIG_SENSE_OBS_DELTA
+#define CONFIG_SENSE_OBS_DELTA              (10)
+#endif
+
+/* Observers kept per sensor resource */
+#ifndef CONFIG_SENSE_OBS_MAX
+#define CONFIG_SENSE_OBS_MAX                (8U)
+#endif
+
+/* Answer sensor requests with a separate response by default */
+#ifndef CONFIG_SENSE_DEFERRED
+#define CONFIG_SENSE_DEFERRED               (1)
+#endif
+
+/* Maximum number of requests waiting for a separate response */
+#ifndef CONFIG_SENSE_DEFERRED_MAX
+#define CONFIG_SENSE_DEFERRED_MAX           (4)
+#endif
+
+/* Time a sensor value is served from the cache, in seconds. Also used as
+ * Max-Age of the responses. */
+#ifndef CONFIG_SENSE_CACHE_MAX_AGE
+#define CONFIG_SENSE_CACHE_MAX_AGE          (2U)
+#endif
+
+/* Size of the buffer the SenML representation of all sensors is encoded to */
+#ifndef CONFIG_SENSE_SENML_BUF_SIZE
+#define CONFIG_SENSE_SENML_BUF_SIZE         (512U)
+#endif
+
+/* Length of the longest plain text value ("-32768") */
+#define SENSE_PAYLOAD_MAX                   (6U)
+
+/* Length of the ETag derived from a sensor value */
+#define SENSE_ETAG_LEN                      (4U)
+
+/* A sensor value together with its encoded representation */
+typedef struct {
+    phydat_t value;             /**< value read from the device */
+    int dimensions;             /**< number of valid dimensions in value */
+    ztimer_now_t read_at;       /**< time the value was read */
+    uint8_t etag[SENSE_ETAG_LEN]; /**< ETag derived from the value */
+    uint8_t payload_len;        /**< length of the payload */
+    char payload[SENSE_PAYLOAD_MAX]; /**< plain text representation */
+} sense_sample_t;
+
+/* A client observing a sensor resource */
+typedef struct {
+    sock_udp_ep_t remote;       /**< endpoint of the observer */
+    uint8_t token[GCOAP_TOKENLEN_MAX]; /**< token of the registration */
+    uint8_t token_len;          /**< length of the token */
+    ztimer_now_t registered_at; /**< time of the last registration */
+    bool used;                  /**< slot is in use */
+} sense_observer_t;
+
+/* State of a sensor resource, used as context of the CoAP resource */
+typedef struct {
+    saul_reg_t *device;         /**< SAUL device backing the resource */
+    sense_sample_t cache;       /**< last value read from the device */
+    bool cached;                /**< cache holds a value */
+    sense_observer_t observers[CONFIG_SENSE_OBS_MAX]; /**< observers */
+    uint32_t obs_seq;           /**< value of the last Observe option */
+    phydat_t notified;          /**< last value sent to the observers */
+    int dimensions;             /**< number of valid dimensions in notified */
+    ztimer_now_t notified_at;   /**< time of the last notification */
+    int16_t delta;              /**< change that triggers a notification */
+} sense_res_t;
+
+/* A request whose response is sent later from the event thread */
+typedef struct {
+    event_t event;              /**< event that performs the read */
+    sense_res_t *res;           /**< resource that was requested */
+    sock_udp_ep_t remote;       /**< requesting endpoint */
+    uint8_t token[GCOAP_TOKENLEN_MAX]; /**< token of the request */
+    uint8_t token_len;          /**< length of the token */
+    uint8_t etag[SENSE_ETAG_LEN]; /**< ETag of a conditional request */
+    uint8_t etag_len;           /**< length of etag, 0 if unconditional */
+    bool used;                  /**< slot is in use */
+} sense_deferred_t;
+
+/* Time the gcoap thread spent in the sensor handler */
+typedef struct {
+    uint32_t count;             /**< number of handled requests */
+    uint64_t total_us;          /**< total time spent in the handler */
+    uint32_t max_us;            /**< longest time spent in the handler */
+} sense_block_stats_t;
+
 static ssize_t _sensor_handler(coap_pkt_t* pdu, uint8_t *buf, size_t len, coap_request_ctx_t *ctx);
+static ssize_t _senml_handler(coap_pkt_t* pdu, uint8_t *buf, size_t len, coap_request_ctx_t *ctx);
 
 /* CoAP resources. Must be sorted by path (ASCII order). */
 #if defined(TASK_4)
-static saul_reg_t *temp_device = NULL;
-static saul_reg_t *hum_device = NULL;
+static sense_res_t temp_res = { .delta = CONFIG_SENSE_OBS_DELTA };
+static sense_res_t hum_res = { .delta = CONFIG_SENSE_OBS_DELTA };
 
 static coap_resource_t _resources[] = {
-    { "/sense/hum", COAP_GET, _sensor_handler, &hum_device },
-    { "/sense/temp", COAP_GET, _sensor_handler, &temp_device },
+    { "/sense", COAP_GET, _senml_handler, NULL },
+    { "/sense/hum", COAP_GET, _sensor_handler, &hum_res },
+    { "/sense/temp", COAP_GET, _sensor_handler, &temp_res },
 };
 #elif defined(TASK_5)
-static saul_reg_t *press_device = NULL;
-static saul_reg_t *mag_device = NULL;
+static sense_res_t press_res = { .delta = CONFIG_SENSE_OBS_DELTA };
+static sense_res_t mag_res = { .delta = CONFIG_SENSE_OBS_DELTA };
 
 static coap_resource_t _resources[] = {
-    { "/sense/mag", COAP_GET, _sensor_handler, &mag_device },
-    { "/sense/press", COAP_GET, _sensor_handler, &press_device },
+    { "/sense", COAP_GET, _senml_handler, NULL },
+    { "/sense/mag", COAP_GET, _sensor_handler, &mag_res },
+    { "/sense/press", COAP_GET, _sensor_handler, &press_res },
 };
 #else
 #error "Set either TASK_4 or TASK_5 CFLAGS"
@@ -54,59 +168,657 @@ static gcoap_listener_t _listener = {
     NULL
 };
 
+/* buffer used to build notifications and separate responses, only accessed
+ * from the event thread */
+static uint8_t _event_buf[CONFIG_GCOAP_PDU_BUF_SIZE];
+
+static void _obs_check(event_t *event);
+static event_t _obs_event = { .handler = _obs_check };
+static event_timeout_t _obs_timeout;
+
+/* SenML representation of all sensors, encoded at the first block of a
+ * transfer and served for the following ones, with its ETag. Only accessed
+ * from the gcoap thread */
+static uint8_t _senml_buf[CONFIG_SENSE_SENML_BUF_SIZE];
+static size_t _senml_len;
+static uint8_t _senml_etag[SENSE_ETAG_LEN];
+
+static bool _deferred = CONFIG_SENSE_DEFERRED;
+static sense_deferred_t _deferred_reqs[CONFIG_SENSE_DEFERRED_MAX];
+static mutex_t _deferred_lock = MUTEX_INIT;
+
+/* index 0: synchronous responses, index 1: deferred responses */
+static sense_block_stats_t _block_stats[2];
+
+/* protects the observers of all resources */
+static mutex_t _obs_lock = MUTEX_INIT;
+
+/* protects the cached samples of all resources */
+static mutex_t _cache_lock = MUTEX_INIT;
+static uint32_t _cache_hits;
+static uint32_t _sensor_reads;
+
+/* Derives an ETag from a value, equal values always get the same ETag */
+static void _etag_from_value(uint8_t *etag, const phydat_t *value, int dimensions)
+{
+    /* 32-bit FNV-1a over the relevant fields */
+    uint32_t hash = 2166136261U;
+    uint8_t fields[] = { value->unit, (uint8_t)value->scale, (uint8_t)dimensions };
+
+    for (unsigned i = 0; i < sizeof(fields); i++) {
+        hash = (hash ^ fields[i]) * 16777619U;
+    }
+    for (int i = 0; i < dimensions; i++) {
+        hash = (hash ^ (value->val[i] & 0xff)) * 16777619U;
+        hash = (hash ^ ((uint16_t)value->val[i] >> 8)) * 16777619U;
+    }
+    memcpy(etag, &hash, SENSE_ETAG_LEN);
+}
+
+/* Derives an ETag from a representation */
+static void _etag_from_bytes(uint8_t *etag, const uint8_t *data, size_t len)
+{
+    /* 32-bit FNV-1a, as for the values */
+    uint32_t hash = 2166136261U;
+
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ data[i]) * 16777619U;
+    }
+    memcpy(etag, &hash, SENSE_ETAG_LEN);
+}
+
+/* Returns true if the sample is recent enough to be served from the cache */
+static bool _sample_fresh(const sense_sample_t *sample, ztimer_now_t now)
+{
+    return (now - sample->read_at) < CONFIG_SENSE_CACHE_MAX_AGE * MS_PER_SEC;
+}
+
+/* Returns the remaining freshness of a sample in seconds */
+static uint32_t _sample_max_age(const sense_sample_t *sample)
+{
+    uint32_t age = ztimer_now(ZTIMER_MSEC) - sample->read_at;
+
+    if (age >= CONFIG_SENSE_CACHE_MAX_AGE * MS_PER_SEC) {
+        return 0;
+    }
+    return CONFIG_SENSE_CACHE_MAX_AGE - (age / MS_PER_SEC);
+}
+
+/* Copies the cached sample of a resource, returns false if it is stale */
+static bool _cache_get(sense_res_t *res, sense_sample_t *sample)
+{
+    bool hit;
+
+    mutex_lock(&_cache_lock);
+    hit = res->cached && _sample_fresh(&res->cache, ztimer_now(ZTIMER_MSEC));
+    if (hit) {
+        *sample = res->cache;
+        _cache_hits++;
+    }
+    mutex_unlock(&_cache_lock);
+    return hit;
+}
+
+/*
+ * Gets the current value of a sensor resource, from the cache if it is fresh
+ * or from the device otherwise. Returns 0 on success, -1 on read errors.
+ */
+static int _sense_get(sense_res_t *res, sense_sample_t *sample)
+{
+    if (_cache_get(res, sample)) {
+        return 0;
+    }
+
+    /* the device is read without holding the lock, concurrent misses may
+     * read it twice but never block each other */
+    sample->dimensions = saul_reg_read(res->device, &sample->value);
+    if (sample->dimensions < 1) {
+        puts("Error reading sensor");
+        return -1;
+    }
+
+    sample->read_at = ztimer_now(ZTIMER_MSEC);
+    sample->payload_len = fmt_s16_dec(sample->payload, sample->value.val[0]);
+    _etag_from_value(sample->etag, &sample->value, sample->dimensions);
+
+    mutex_lock(&_cache_lock);
+    res->cache = *sample;
+    res->cached = true;
+    _sensor_reads++;
+    mutex_unlock(&_cache_lock);
+    return 0;
+}
+
+/*
+ * Adds the options and (for 2.05 responses) the plain text payload of a
+ * sample to the PDU. The ETag can only be added to responses without the
+ * Observe option, as options have to be added in order.
+ * Returns the total length of the PDU or -1 if the payload does not fit.
+ */
+static ssize_t _encode_sample(coap_pkt_t *pdu, const sense_sample_t *sample,
+                              bool etag)
+{
+    bool payload = (coap_get_code_raw(pdu) == COAP_CODE_CONTENT);
+
+    if (etag) {
+        coap_opt_add_opaque(pdu, COAP_OPT_ETAG, sample->etag, SENSE_ETAG_LEN);
+    }
+
+    if (payload) {
+        /* set the format option to "plain text" */
+        coap_opt_add_format(pdu, COAP_FORMAT_TEXT);
+    }
+
+    coap_opt_add_uint(pdu, COAP_OPT_MAX_AGE, _sample_max_age(sample));
+
+    /* finish the options sections */
+    /* it is important to keep track of the amount of used bytes (resp_len) */
+    ssize_t resp_len = coap_opt_finish(pdu, payload ? COAP_OPT_FINISH_PAYLOAD
+                                                    : COAP_OPT_FINISH_NONE);
+    if (!payload) {
+        return resp_len;
+    }
+
+    /* check that we have enough space */
+    if (sample->payload_len > pdu->payload_len) {
+        puts("Error buffer too small");
+        return -1;
+    }
+
+    memcpy(pdu->payload, sample->payload, sample->payload_len);
+    return resp_len + sample->payload_len;
+}
+
+/* Returns true if a request ETag matches the ETag of the sample */
+static bool _etag_matches(const sense_sample_t *sample, const uint8_t *etag,
+                          size_t etag_len)
+{
+    return (etag_len == SENSE_ETAG_LEN) &&
+           !memcmp(etag, sample->etag, SENSE_ETAG_LEN);
+}
+
+/*
+ * Returns true if @p value differs enough from the last notified value of
+ * @p res to be worth a notification.
+ */
+static bool _value_changed(const sense_res_t *res, const sense_sample_t *sample)
+{
+    const phydat_t *value = &sample->value;
+    int dimensions = sample->dimensions;
+
+    if (dimensions != res->dimensions ||
+        value->unit != res->notified.unit ||
+        value->scale != res->notified.scale) {
+        return true;
+    }
+
+    for (int i = 0; i < dimensions; i++) {
+        if (abs(value->val[i] - res->notified.val[i]) >= res->delta) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Returns the observer of @p res with the given endpoint and token, or NULL */
+static sense_observer_t *_obs_find(sense_res_t *res, const sock_udp_ep_t *remote,
+                                   const uint8_t *token, size_t token_len)
+{
+    for (unsigned i = 0; i < ARRAY_SIZE(res->observers); i++) {
+        sense_observer_t *obs = &res->observers[i];
+        if (obs->used && obs->token_len == token_len &&
+            !memcmp(obs->token, token, token_len) &&
+            sock_udp_ep_equal(&obs->remote, remote)) {
+            return obs;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Registers the requester of @p pdu as observer of @p res, or renews its
+ * registration. When all slots are taken, the registration that was renewed
+ * the longest time ago is replaced. Returns the value of the Observe option
+ * of the response.
+ */
+static uint32_t _obs_register(sense_res_t *res, coap_pkt_t *pdu,
+                              const sock_udp_ep_t *remote)
+{
+    ztimer_now_t now = ztimer_now(ZTIMER_MSEC);
+    uint8_t token_len = coap_get_token_len(pdu);
+
+    mutex_lock(&_obs_lock);
+    sense_observer_t *obs = _obs_find(res, remote, coap_get_token(pdu),
+                                      token_len);
+    if (!obs) {
+        /* a free slot, else the oldest registration, compared by age */
+        obs = &res->observers[0];
+        for (unsigned i = 0; i < ARRAY_SIZE(res->observers); i++) {
+            sense_observer_t *slot = &res->observers[i];
+            if (!slot->used) {
+                obs = slot;
+                break;
+            }
+            if (now - slot->registered_at > now - obs->registered_at) {
+                obs = slot;
+            }
+        }
+        obs->remote = *remote;
+        obs->token_len = token_len;
+        memcpy(obs->token, coap_get_token(pdu), token_len);
+        obs->used = true;
+    }
+    obs->registered_at = now;
+    uint32_t seq = res->obs_seq;
+    mutex_unlock(&_obs_lock);
+
+    return seq;
+}
+
+/* Removes the observer with the endpoint and token of @p pdu */
+static void _obs_deregister(sense_res_t *res, coap_pkt_t *pdu,
+                            const sock_udp_ep_t *remote)
+{
+    mutex_lock(&_obs_lock);
+    sense_observer_t *obs = _obs_find(res, remote, coap_get_token(pdu),
+                                      coap_get_token_len(pdu));
+    if (obs) {
+        obs->used = false;
+    }
+    mutex_unlock(&_obs_lock);
+}
+
+/*
+ * Copies the observers of @p res, returns their number. The value of the
+ * Observe option is advanced for the notification and returned in @p seq.
+ */
+static unsigned _obs_get(sense_res_t *res, sense_observer_t *observers,
+                         uint32_t *seq)
+{
+    unsigned count = 0;
+
+    mutex_lock(&_obs_lock);
+    for (unsigned i = 0; i < ARRAY_SIZE(res->observers); i++) {
+        if (res->observers[i].used) {
+            observers[count++] = res->observers[i];
+        }
+    }
+    if (count) {
+        /* the option holds 24 bits */
+        res->obs_seq = (res->obs_seq + 1) & 0xffffff;
+    }
+    *seq = res->obs_seq;
+    mutex_unlock(&_obs_lock);
+
+    return count;
+}
+
+/*
+ * Periodically called from the event thread. Reads each observed sensor once
+ * and notifies its observers if the value changed or the maximum interval
+ * between notifications has passed.
+ */
+static void _obs_check(event_t *event)
+{
+    (void)event;
+
+    for (unsigned i = 0; i < ARRAY_SIZE(_resources); i++) {
+        const coap_resource_t *resource = &_resources[i];
+        sense_res_t *res = resource->context;
+        sense_observer_t observers[CONFIG_SENSE_OBS_MAX];
+        uint32_t seq;
+
+        if (resource->handler != _sensor_handler) {
+            continue;
+        }
+
+        /* skip the sensor read altogether when nobody is observing */
+        mutex_lock(&_obs_lock);
+        bool observed = false;
+        for (unsigned j = 0; j < ARRAY_SIZE(res->observers); j++) {
+            observed |= res->observers[j].used;
+        }
+        mutex_unlock(&_obs_lock);
+        if (!observed) {
+            continue;
+        }
+
+        sense_sample_t sample;
+        if (_sense_get(res, &sample) < 0) {
+            continue;
+        }
+
+        ztimer_now_t now = ztimer_now(ZTIMER_MSEC);
+        if (!_value_changed(res, &sample) &&
+            (now - res->notified_at) < CONFIG_SENSE_OBS_MAX_INTERVAL) {
+            continue;
+        }
+
+        /* one read serves every observer, each gets a NON with its token */
+        unsigned count = _obs_get(res, observers, &seq);
+        unsigned sent = 0;
+        for (unsigned j = 0; j < count; j++) {
+            coap_pkt_t pdu;
+            ssize_t hdr_len = coap_build_hdr((coap_hdr_t *)_event_buf,
+                                             COAP_TYPE_NON, observers[j].token,
+                                             observers[j].token_len,
+                                             COAP_CODE_CONTENT,
+                                             random_uint32() & 0xffff);
+            coap_pkt_init(&pdu, _event_buf, sizeof(_event_buf), hdr_len);
+            coap_opt_add_uint(&pdu, COAP_OPT_OBSERVE, seq);
+
+            ssize_t len = _encode_sample(&pdu, &sample, false);
+            if (len > 0 &&
+                gcoap_req_send(_event_buf, len, &observers[j].remote,
+                               NULL, NULL)) {
+                sent++;
+            }
+        }
+
+        if (sent) {
+            res->notified = sample.value;
+            res->dimensions = sample.dimensions;
+            res->notified_at = now;
+        }
+    }
+
+    event_timeout_set(&_obs_timeout, CONFIG_SENSE_OBS_CHECK_INTERVAL);
+}
+
+/*
+ * Called from the event thread for a deferred request. Reads the sensor and
+ * sends the result as a separate (NON) response carrying the original token.
+ */
+static void _deferred_read(event_t *event)
+{
+    sense_deferred_t *req = container_of(event, sense_deferred_t, event);
+    coap_pkt_t pdu;
+    sense_sample_t sample;
+
+    unsigned code = COAP_CODE_INTERNAL_SERVER_ERROR;
+    if (_sense_get(req->res, &sample) == 0) {
+        code = _etag_matches(&sample, req->etag, req->etag_len)
+               ? COAP_CODE_VALID : COAP_CODE_CONTENT;
+    }
+
+    ssize_t hdr_len = coap_build_hdr((coap_hdr_t *)_event_buf, COAP_TYPE_NON,
+                                     req->token, req->token_len, code,
+                                     random_uint32() & 0xffff);
+    coap_pkt_init(&pdu, _event_buf, sizeof(_event_buf), hdr_len);
+
+    ssize_t len;
+    if (code == COAP_CODE_INTERNAL_SERVER_ERROR) {
+        len = coap_opt_finish(&pdu, COAP_OPT_FINISH_NONE);
+    }
+    else {
+        len = _encode_sample(&pdu, &sample, true);
+    }
+
+    if (len > 0 && !gcoap_req_send(_event_buf, len, &req->remote, NULL, NULL)) {
+        puts("Error sending separate response");
+    }
+
+    mutex_lock(&_deferred_lock);
+    req->used = false;
+    mutex_unlock(&_deferred_lock);
+}
+
+/*
+ * Queues a request for a separate response. Returns NULL if all slots are in
+ * use, in which case the request has to be answered right away.
+ */
+static sense_deferred_t *_deferred_queue(coap_pkt_t *pdu, sense_res_t *res,
+                                         const sock_udp_ep_t *remote,
+                                         const uint8_t *etag, size_t etag_len)
+{
+    sense_deferred_t *req = NULL;
+
+    mutex_lock(&_deferred_lock);
+    for (unsigned i = 0; i < ARRAY_SIZE(_deferred_reqs); i++) {
+        if (!_deferred_reqs[i].used) {
+            req = &_deferred_reqs[i];
+            req->used = true;
+            break;
+        }
+    }
+    mutex_unlock(&_deferred_lock);
+
+    if (!req) {
+        return NULL;
+    }
+
+    req->event.handler = _deferred_read;
+    req->res = res;
+    req->remote = *remote;
+    req->token_len = coap_get_token_len(pdu);
+    memcpy(req->token, coap_get_token(pdu), req->token_len);
+    req->etag_len = etag_len;
+    memcpy(req->etag, etag, etag_len);
+    event_post(EVENT_PRIO_MEDIUM, &req->event);
+    return req;
+}
+
+/* Returns true if the request registers for notifications */
+static bool _is_obs_register(coap_pkt_t *pdu)
+{
+    uint32_t observe;
+    return (coap_opt_get_uint(pdu, COAP_OPT_OBSERVE, &observe) == 0) &&
+           (observe == COAP_OBS_REGISTER);
+}
+
+/* Returns true if the request cancels a registration */
+static bool _is_obs_deregister(coap_pkt_t *pdu)
+{
+    uint32_t observe;
+    return (coap_opt_get_uint(pdu, COAP_OPT_OBSERVE, &observe) == 0) &&
+           (observe == COAP_OBS_DEREGISTER);
+}
+
+static void _block_stats_add(bool deferred, uint32_t start)
+{
+    sense_block_stats_t *stats = &_block_stats[deferred];
+    uint32_t elapsed = ztimer_now(ZTIMER_USEC) - start;
+
+    stats->count++;
+    stats->total_us += elapsed;
+    if (elapsed > stats->max_us) {
+        stats->max_us = elapsed;
+    }
+}
+
 void server_init(void)
 {
     gcoap_register_listener(&_listener);
 
     /* find sensors */
 #if defined(TASK_4)
-    temp_device = saul_reg_find_type(SAUL_SENSE_TEMP);
-    hum_device = saul_reg_find_type(SAUL_SENSE_HUM);
-    if (!temp_device || !hum_device) {
+    temp_res.device = saul_reg_find_type(SAUL_SENSE_TEMP);
+    hum_res.device = saul_reg_find_type(SAUL_SENSE_HUM);
+    if (!temp_res.device || !hum_res.device) {
         puts("Error, could not find the devices");
         assert(0);
     }
 #elif defined(TASK_5)
-    press_device = saul_reg_find_type(SAUL_SENSE_TEMP);
-    mag_device = saul_reg_find_type(SAUL_SENSE_HUM);
-    if (!press_device || !mag_device) {
+    press_res.device = saul_reg_find_type(SAUL_SENSE_TEMP);
+    mag_res.device = saul_reg_find_type(SAUL_SENSE_HUM);
+    if (!press_res.device || !mag_res.device) {
         puts("Error, could not find the devices");
         assert(0);
     }
 #endif
+
+    /* start checking the observed resources periodically */
+    event_timeout_ztimer_init(&_obs_timeout, ZTIMER_MSEC, EVENT_PRIO_MEDIUM,
+                              &_obs_event);
+    event_timeout_set(&_obs_timeout, CONFIG_SENSE_OBS_CHECK_INTERVAL);
 }
 
 /*
- * GET: Returns the current sensor value as plain text
+ * GET: Returns the current sensor value as plain text. A GET with the Observe
+ * option registers the client for notifications, up to CONFIG_SENSE_OBS_MAX
+ * clients per resource.
+ *
+ * Values are served from a cache for CONFIG_SENSE_CACHE_MAX_AGE seconds.
+ * Requests carrying the current ETag are answered with 2.03 Valid.
+ *
+ * In deferred mode a cache miss is read from the event thread, the request is
+ * acknowledged right away and the value follows in a separate response.
  */
 static ssize_t _sensor_handler(coap_pkt_t *pdu, uint8_t *buf, size_t len, coap_request_ctx_t *ctx)
 {
-    saul_reg_t *device = *(saul_reg_t**)ctx;
+    sense_res_t *res = coap_request_ctx_get_context(ctx);
+    uint32_t start = ztimer_now(ZTIMER_USEC);
+    bool obs_register = _is_obs_register(pdu);
+    sense_sample_t sample;
 
-    /* initialize a new coap response */
-    gcoap_resp_init(pdu, buf, len, COAP_CODE_CONTENT);
+    /* the observers are kept in the resource, gcoap must not add the Observe
+     * option of its own registration to the response */
+    coap_clear_observe(pdu);
+    if (_is_obs_deregister(pdu)) {
+        _obs_deregister(res, pdu, coap_request_ctx_get_remote_udp(ctx));
+    }
 
-    /* first we set all the options */
-    /* set the format option to "plain text" */
-    coap_opt_add_format(pdu, COAP_FORMAT_TEXT);
+    /* the request options are overwritten by the response, keep the ETag */
+    uint8_t etag[SENSE_ETAG_LEN];
+    size_t etag_len = 0;
+    uint8_t *opt;
+    ssize_t opt_len = coap_opt_get_opaque(pdu, COAP_OPT_ETAG, &opt);
+    if (!obs_register && opt_len > 0 && opt_len <= (ssize_t)sizeof(etag)) {
+        etag_len = opt_len;
+        memcpy(etag, opt, etag_len);
+    }
 
-    /* finish the options sections */
-    /* it is important to keep track of the amount of used bytes (resp_len) */
-    size_t resp_len = coap_opt_finish(pdu, COAP_OPT_FINISH_PAYLOAD);
+    bool cached = _cache_get(res, &sample);
 
-    phydat_t result;
-    int dimensions = saul_reg_read(device, &result);
-    if (dimensions < 0) {
-        puts("Error reading sensor");
-        return gcoap_response(pdu, buf, len, COAP_CODE_INTERNAL_SERVER_ERROR);
+    /* registrations need the Observe option in the immediate response */
+    if (!cached && _deferred && !obs_register) {
+        uint16_t id = coap_get_id(pdu);
+        bool confirmable = (coap_get_type(pdu) == COAP_TYPE_CON);
+
+        if (_deferred_queue(pdu, res, coap_request_ctx_get_remote_udp(ctx),
+                            etag, etag_len)) {
+            ssize_t resp_len = 0;
+            if (confirmable) {
+                /* empty ACK, the request buffer is no longer needed */
+                resp_len = coap_build_hdr((coap_hdr_t *)buf, COAP_TYPE_ACK,
+                                          NULL, 0, COAP_CODE_EMPTY, id);
+            }
+            _block_stats_add(true, start);
+            return resp_len;
+        }
     }
 
-    /* check that we have enough space */
-    if (fmt_s16_dec(NULL, result.val[0]) > pdu->payload_len) {
-        puts("Error buffer too small");
-        return gcoap_response(pdu, buf, len, COAP_CODE_INTERNAL_SERVER_ERROR);
+    ssize_t resp_len;
+    if (!cached && _sense_get(res, &sample) < 0) {
+        resp_len = gcoap_response(pdu, buf, len, COAP_CODE_INTERNAL_SERVER_ERROR);
     }
+    else {
+        unsigned code = _etag_matches(&sample, etag, etag_len)
+                        ? COAP_CODE_VALID : COAP_CODE_CONTENT;
+
+        /* initialize a new coap response, a registration is acknowledged
+         * with the Observe option */
+        gcoap_resp_init(pdu, buf, len, code);
+        if (obs_register) {
+            coap_opt_add_uint(pdu, COAP_OPT_OBSERVE,
+                              _obs_register(res, pdu,
+                                            coap_request_ctx_get_remote_udp(ctx)));
+        }
 
-    resp_len += fmt_s16_dec((char *)pdu->payload, result.val[0]);
+        resp_len = _encode_sample(pdu, &sample, !obs_register);
+        if (resp_len < 0) {
+            resp_len = gcoap_response(pdu, buf, len,
+                                      COAP_CODE_INTERNAL_SERVER_ERROR);
+        }
+    }
+
+    _block_stats_add(false, start);
+    return resp_len;
+}
+
+/*
+ * GET: Returns all registered SAUL devices as a SenML pack encoded in CBOR,
+ * including every dimension with its unit and scale. Representations larger
+ * than a block are split using Block2.
+ *
+ * The devices are read and encoded at the first block only. The following
+ * blocks are cut from that snapshot, so that they fit together. Each block
+ * carries the ETag of the snapshot: a client whose transfer is overtaken by
+ * the first block of another one sees the ETag change and starts over.
+ */
+static ssize_t _senml_handler(coap_pkt_t *pdu, uint8_t *buf, size_t len, coap_request_ctx_t *ctx)
+{
+    (void)ctx;
+    coap_block_slicer_t slicer;
+
+    /* the requested block has to be read before the response overwrites it */
+    coap_block2_init(pdu, &slicer);
+
+    if (slicer.start == 0 || _senml_len == 0) {
+        size_t senml_len = senml_saul_encode_cbor(_senml_buf,
+                                                  sizeof(_senml_buf), saul_reg);
+        if (senml_len == 0 || senml_len > sizeof(_senml_buf)) {
+            _senml_len = 0;
+            puts("Error SenML buffer too small");
+            return gcoap_response(pdu, buf, len,
+                                  COAP_CODE_INTERNAL_SERVER_ERROR);
+        }
+        _senml_len = senml_len;
+        _etag_from_bytes(_senml_etag, _senml_buf, _senml_len);
+    }
+
+    gcoap_resp_init(pdu, buf, len, COAP_CODE_CONTENT);
+    coap_opt_add_opaque(pdu, COAP_OPT_ETAG, _senml_etag, SENSE_ETAG_LEN);
+    coap_opt_add_format(pdu, COAP_FORMAT_SENML_CBOR);
+    coap_opt_add_block2(pdu, &slicer, true);
+    ssize_t resp_len = coap_opt_finish(pdu, COAP_OPT_FINISH_PAYLOAD);
+
+    /* only the part of the pack that belongs to the block is copied */
+    resp_len += coap_blockwise_put_bytes(&slicer, pdu->payload, _senml_buf,
+                                         _senml_len);
+    coap_block2_finish(&slicer);
     return resp_len;
 }
+
+static void _print_block_stats(const char *name, const sense_block_stats_t *stats)
+{
+    uint32_t avg = stats->count ? stats->total_us / stats->count : 0;
+
+    printf("%-9s %8" PRIu32 " req, avg %6" PRIu32 " us, max %6" PRIu32 " us\n",
+           name, stats->count, avg, stats->max_us);
+}
+
+static int _sense_cmd(int argc, char **argv)
+{
+    if (argc == 3 && !strcmp(argv[1], "deferred")) {
+        if (!strcmp(argv[2], "on")) {
+            _deferred = true;
+        }
+        else if (!strcmp(argv[2], "off")) {
+            _deferred = false;
+        }
+        else {
+            printf("usage: %s deferred <on|off>\n", argv[0]);
+            return 1;
+        }
+    }
+    else if (argc == 2 && !strcmp(argv[1], "reset")) {
+        memset(_block_stats, 0, sizeof(_block_stats));
+        _cache_hits = 0;
+        _sensor_reads = 0;
+    }
+    else if (argc != 1) {
+        printf("usage: %s [deferred <on|off>|reset]\n", argv[0]);
+        return 1;
+    }
+
+    printf("deferred responses: %s\n", _deferred ? "on" : "off");
+    puts("gcoap thread blocked in sensor handler:");
+    _print_block_stats("sync", &_block_stats[0]);
+    _print_block_stats("deferred", &_block_stats[1]);
+    printf("sensor reads: %" PRIu32 ", cache hits: %" PRIu32 "\n",
+           _sensor_reads, _cache_hits);
+    return 0;
+}
+
+SHELL_COMMAND(sense, "Sensor resource statistics and settings", _sense_cmd);
@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @brief       CoAP load generator for the `coap bench` shell command
+ *
+ * Keeps a number of GET requests in flight and records the round trip time
+ * of each response in a logarithmic histogram.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitarithm.h"
+#include "coap_pdu_pool.h"
+#include "irq.h"
+#include "mutex.h"
+#include "net/gcoap.h"
+#include "time_units.h"
+#include "ztimer.h"
+
+#include "gcoap_example.h"
+
+/* Values below this are stored exactly, above with 8 buckets per power of 2 */
+#define HIST_LINEAR         (16U)
+#define HIST_SUB_BITS       (3U)
+#define HIST_BUCKETS        (HIST_LINEAR + (32U - 4U) * (1U << HIST_SUB_BITS))
+
+/* Requests in flight are bounded by the gcoap request memos, and for
+ * confirmable requests by the retransmission buffers */
+#define BENCH_INFLIGHT_MAX  MIN(CONFIG_GCOAP_REQ_WAITING_MAX, \
+                                CONFIG_GCOAP_RESEND_BUFS_MAX)
+
+typedef struct {
+    sock_udp_ep_t remote;                   /**< server under test */
+    char path[CONFIG_NANOCOAP_URI_MAX];     /**< requested path */
+    unsigned total;                         /**< requests to send */
+    unsigned sent;                          /**< requests sent so far */
+    unsigned done;                          /**< requests finished so far */
+    unsigned responses;                     /**< requests answered */
+    unsigned timeouts;                      /**< requests timed out */
+    unsigned errors;                        /**< failed requests */
+    uint32_t sent_at[BENCH_INFLIGHT_MAX];   /**< send time per slot, in us */
+    uint32_t rtt_min;                       /**< shortest RTT, in us */
+    uint32_t rtt_max;                       /**< longest RTT, in us */
+    uint16_t hist[HIST_BUCKETS];            /**< RTT histogram */
+    mutex_t finished;                       /**< unlocked when all are done */
+} _bench_t;
+
+static _bench_t _bench;
+
+/* request buffer of the response handler, only used by the gcoap thread */
+static uint8_t _bench_buf[CONFIG_GCOAP_PDU_BUF_SIZE];
+
+static unsigned _hist_bucket(uint32_t value)
+{
+    if (value < HIST_LINEAR) {
+        return value;
+    }
+    unsigned msb = bitarithm_msb(value);
+    unsigned sub = (value >> (msb - HIST_SUB_BITS)) & ((1U << HIST_SUB_BITS) - 1);
+    return HIST_LINEAR + ((msb - 4) << HIST_SUB_BITS) + sub;
+}
+
+/* smallest value that falls into a bucket */
+static uint32_t _hist_value(unsigned bucket)
+{
+    if (bucket < HIST_LINEAR) {
+        return bucket;
+    }
+    bucket -= HIST_LINEAR;
+    unsigned msb = (bucket >> HIST_SUB_BITS) + 4;
+    uint32_t sub = bucket & ((1U << HIST_SUB_BITS) - 1);
+    return (1UL << msb) | (sub << (msb - HIST_SUB_BITS));
+}
+
+/* value below which @p permille of the recorded RTTs are */
+static uint32_t _hist_percentile(unsigned permille)
+{
+    uint32_t rank = ((uint32_t)_bench.responses * permille + 999) / 1000;
+    uint32_t seen = 0;
+
+    for (unsigned i = 0; i < HIST_BUCKETS; i++) {
+        seen += _bench.hist[i];
+        if (seen >= rank && seen) {
+            return _hist_value(i);
+        }
+    }
+    return 0;
+}
+
+static void _bench_resp_handler(const gcoap_request_memo_t *memo,
+                                coap_pkt_t *pdu, const sock_udp_ep_t *remote);
+
+/* Claims the next request number, returns false if all were sent */
+static bool _bench_claim(void)
+{
+    unsigned state = irq_disable();
+    bool claimed = _bench.sent < _bench.total;
+    if (claimed) {
+        _bench.sent++;
+    }
+    irq_restore(state);
+    return claimed;
+}
+
+/* Counts a failed request, on the shell thread or the gcoap thread */
+static void _bench_error(void)
+{
+    unsigned state = irq_disable();
+    _bench.errors++;
+    irq_restore(state);
+}
+
+/* Counts a finished request and wakes up the shell after the last one */
+static void _bench_finish(void)
+{
+    unsigned state = irq_disable();
+    bool last = (++_bench.done == _bench.total);
+    irq_restore(state);
+
+    if (last) {
+        mutex_unlock(&_bench.finished);
+    }
+}
+
+/* Sends a request in the given in-flight slot */
+static void _bench_send(unsigned slot, uint8_t *buf, size_t len)
+{
+    coap_pkt_t pdu;
+
+    gcoap_req_init(&pdu, buf, len, COAP_METHOD_GET, _bench.path);
+    coap_hdr_set_type(pdu.hdr, COAP_TYPE_CON);
+    ssize_t req_len = coap_opt_finish(&pdu, COAP_OPT_FINISH_NONE);
+
+    /* a failed send moves on to the next request, so that the slot is not
+     * lost and the benchmark always terminates */
+    do {
+        _bench.sent_at[slot] = ztimer_now(ZTIMER_USEC);
+        if (req_len > 0 && gcoap_req_send(buf, req_len, &_bench.remote,
+                                          _bench_resp_handler,
+                                          (void *)(uintptr_t)slot)) {
+            return;
+        }
+        _bench_error();
+        _bench_finish();
+    } while (_bench_claim());
+}
+
+/*
+ * Records the result of a request and sends the next one in the same slot.
+ * Runs in the gcoap thread.
+ */
+static void _bench_resp_handler(const gcoap_request_memo_t *memo,
+                                coap_pkt_t *pdu, const sock_udp_ep_t *remote)
+{
+    (void)pdu;
+    (void)remote;
+    unsigned slot = (uintptr_t)memo->context;
+    uint32_t rtt = ztimer_now(ZTIMER_USEC) - _bench.sent_at[slot];
+
+    if (memo->state == GCOAP_MEMO_RESP) {
+        _bench.responses++;
+        _bench.hist[_hist_bucket(rtt)]++;
+        _bench.rtt_min = MIN(_bench.rtt_min, rtt);
+        _bench.rtt_max = MAX(_bench.rtt_max, rtt);
+    }
+    else if (memo->state == GCOAP_MEMO_TIMEOUT) {
+        _bench.timeouts++;
+    }
+    else {
+        _bench_error();
+    }
+
+    if (_bench_claim()) {
+        _bench_send(slot, _bench_buf, sizeof(_bench_buf));
+    }
+    _bench_finish();
+}
+
+static int _bench_usage(char **argv)
+{
+    printf("usage: %s bench <addr>[%%iface] <port> <path> -n <requests> "
+           "-c <concurrency>\n", argv[0]);
+    printf("       at most %u requests can be in flight\n", BENCH_INFLIGHT_MAX);
+    return 1;
+}
+
+int gcoap_cli_bench(int argc, char **argv)
+{
+    unsigned total = 0;
+    unsigned concurrency = 1;
+
+    /* <cmd> bench <addr> <port> <path> [-n N] [-c C] */
+    if (argc < 5 || (argc % 2) == 0) {
+        return _bench_usage(argv);
+    }
+    for (int i = 5; i < argc; i += 2) {
+        if (!strcmp(argv[i], "-n")) {
+            total = atoi(argv[i + 1]);
+        }
+        else if (!strcmp(argv[i], "-c")) {
+            concurrency = atoi(argv[i + 1]);
+        }
+        else {
+            return _bench_usage(argv);
+        }
+    }
+    /* the histogram counts are 16 bit wide */
+    if (total == 0 || total > UINT16_MAX ||
+        concurrency == 0 || concurrency > BENCH_INFLIGHT_MAX ||
+        strlen(argv[4]) >= sizeof(_bench.path)) {
+        return _bench_usage(argv);
+    }
+
+    memset(&_bench, 0, sizeof(_bench));
+    if (!gcoap_cli_parse_endpoint(&_bench.remote, argv[2], argv[3])) {
+        return 1;
+    }
+
+    /* gcoap copies each request, the buffer is only needed to start the
+     * requests of all slots */
+    uint8_t *buf = coap_pdu_pool_acquire();
+    if (!buf) {
+        puts("bench: no free PDU buffer");
+        return 1;
+    }
+    strcpy(_bench.path, argv[4]);
+    _bench.total = total;
+    _bench.rtt_min = UINT32_MAX;
+    mutex_init(&_bench.finished);
+    mutex_lock(&_bench.finished);
+
+    printf("bench: %u requests to %s, %u in flight\n", total, _bench.path,
+           concurrency);
+
+    uint32_t start = ztimer_now(ZTIMER_USEC);
+    for (unsigned slot = 0; slot < concurrency && _bench_claim(); slot++) {
+        _bench_send(slot, buf, CONFIG_COAP_PDU_POOL_BUF_SIZE);
+    }
+    coap_pdu_pool_release(buf);
+
+    /* the response handler keeps the slots busy until all requests are done */
+    mutex_lock(&_bench.finished);
+    uint32_t elapsed = ztimer_now(ZTIMER_USEC) - start;
+
+    printf("bench: %" PRIu32 " ms, %" PRIu32 " req/s\n",
+           (uint32_t)(elapsed / US_PER_MS),
+           (uint32_t)((uint64_t)_bench.responses * US_PER_SEC / MAX(elapsed, 1)));
+    printf("bench: %u responses, %u timeouts, %u errors\n", _bench.responses,
+           _bench.timeouts, _bench.errors);
+    if (_bench.responses) {
+        printf("bench: rtt us min %" PRIu32 " median %" PRIu32 " p99 %" PRIu32
+               " max %" PRIu32 "\n", _bench.rtt_min, _hist_percentile(500),
+               _hist_percentile(990), _bench.rtt_max);
+    }
+    return 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "net/gcoap.h"
+
+#include "gcoap_example.h"
+
+/* Maximum size of the blob that can be uploaded, in bytes */
+#ifndef CONFIG_BLOB_SIZE
+#define CONFIG_BLOB_SIZE    (2048U)
+#endif
+
+static ssize_t _blob_handler(coap_pkt_t* pdu, uint8_t *buf, size_t len, coap_request_ctx_t *ctx);
+
+static const coap_resource_t _resources[] = {
+    { "/riot/blob", COAP_GET | COAP_PUT, _blob_handler, NULL },
+};
+
+static gcoap_listener_t _listener = {
+    _resources,
+    ARRAY_SIZE(_resources),
+    GCOAP_SOCKET_TYPE_UDP,
+    NULL,
+    NULL,
+    NULL
+};
+
+/* Blocks are written to and read from this buffer directly, a transfer never
+ * needs more than one PDU buffer. Only accessed from the gcoap thread. */
+static uint8_t _blob[CONFIG_BLOB_SIZE];
+static size_t _blob_len;
+
+void blob_server_init(void)
+{
+    gcoap_register_listener(&_listener);
+}
+
+/*
+ * GET: Returns the blob. Each response carries only the requested block.
+ */
+static ssize_t _blob_get(coap_pkt_t *pdu, uint8_t *buf, size_t len)
+{
+    coap_block_slicer_t slicer;
+
+    /* the requested block has to be read before the response overwrites it */
+    coap_block2_init(pdu, &slicer);
+
+    gcoap_resp_init(pdu, buf, len, COAP_CODE_CONTENT);
+    coap_opt_add_format(pdu, COAP_FORMAT_OCTET);
+    coap_opt_add_block2(pdu, &slicer, true);
+    ssize_t resp_len = coap_opt_finish(pdu, COAP_OPT_FINISH_PAYLOAD);
+
+    /* copies just the slice of the blob that belongs to the block */
+    resp_len += coap_blockwise_put_bytes(&slicer, pdu->payload, _blob, _blob_len);
+    coap_block2_finish(&slicer);
+    return resp_len;
+}
+
+/*
+ * PUT: Replaces the blob. Blocks have to arrive in order, each is stored at
+ * its final position as it arrives.
+ */
+static ssize_t _blob_put(coap_pkt_t *pdu, uint8_t *buf, size_t len)
+{
+    coap_block1_t block1;
+    bool blockwise = coap_get_block1(pdu, &block1) > 0;
+    size_t offset = blockwise ? block1.offset : 0;
+    unsigned code;
+
+    if (offset == 0) {
+        /* first block of a new upload */
+        _blob_len = 0;
+    }
+
+    if (offset != _blob_len) {
+        /* a block is missing, the client has to start over */
+        code = COAP_CODE_REQUEST_ENTITY_INCOMPLETE;
+    }
+    else if (offset + pdu->payload_len > sizeof(_blob)) {
+        code = COAP_CODE_REQUEST_ENTITY_TOO_LARGE;
+    }
+    else {
+        memcpy(&_blob[offset], pdu->payload, pdu->payload_len);
+        _blob_len = offset + pdu->payload_len;
+        code = (blockwise && block1.more) ? COAP_CODE_CONTINUE
+                                          : COAP_CODE_CHANGED;
+    }
+
+    gcoap_resp_init(pdu, buf, len, code);
+    if (blockwise && code != COAP_CODE_REQUEST_ENTITY_INCOMPLETE) {
+        coap_opt_add_block1_control(pdu, &block1);
+    }
+    return coap_opt_finish(pdu, COAP_OPT_FINISH_NONE);
+}
+
+/*
+ * Server callback for /riot/blob. Accepts GET and PUT, both blockwise.
+ */
+static ssize_t _blob_handler(coap_pkt_t *pdu, uint8_t *buf, size_t len, coap_request_ctx_t *ctx)
+{
+    (void)ctx;
+
+    switch (coap_method2flag(coap_get_code_detail(pdu))) {
+    case COAP_GET:
+        return _blob_get(pdu, buf, len);
+    case COAP_PUT:
+        return _blob_put(pdu, buf, len);
+    default:
+        return gcoap_response(pdu, buf, len, COAP_CODE_METHOD_NOT_ALLOWED);
+    }
+}
@@ -19,39 +19,221 @@
  * @}
  */
 
+#include <errno.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "shell.h"
+#include "coap_pdu_pool.h"
 #include "fmt.h"
+#include "mutex.h"
 #include "net/gcoap.h"
+#include "net/ipv6/addr.h"
 #include "net/utils.h"
 #include "od.h"
 
 #include "gcoap_example.h"
 
+/* Block size exponent (SZX) for blockwise requests, block size is 2^(SZX+4) */
+#define CLI_BLOCK_SZX   (CONFIG_NANOCOAP_BLOCK_SIZE_EXP_MAX - 4)
+
+/* Longest generated body, the Block1 option numbers at most 2^20 blocks */
+#define CLI_UPLOAD_MAX  ((1UL << 20) * coap_szx2size(CLI_BLOCK_SZX))
+
+/* Reads @p len bytes of an upload body at @p offset into @p dst */
+typedef void (*_upload_read_t)(size_t offset, uint8_t *dst, size_t len);
+
+/* State of a blockwise (Block1) upload */
+typedef struct {
+    _upload_read_t read;    /**< produces the body, NULL if no upload */
+    size_t len;             /**< total length of the body */
+    size_t offset;          /**< offset of the block being sent */
+    uint8_t szx;            /**< block size exponent */
+    unsigned code;          /**< request method */
+    unsigned format;        /**< content format of the body */
+} _upload_t;
+
 uint16_t req_count = 0;
 
+/* Path of a request, kept with its pool buffer */
+typedef struct {
+    const uint8_t *buf;     /**< pool buffer of the request, NULL if free */
+    char path[CONFIG_NANOCOAP_URI_MAX]; /**< path of the request */
+} _req_path_t;
+
+/* paths of the requests in flight, needed for the follow-up blockwise
+ * requests sent from the gcoap thread while new commands are run */
+static _req_path_t _req_paths[CONFIG_COAP_PDU_POOL_SIZE];
+static mutex_t _req_paths_lock = MUTEX_INIT;
+
+static _upload_t _upload;
+
+/* body given on the command line, copied only if it has to outlive the
+ * shell command */
+static char _upload_data[SHELL_DEFAULT_BUFSIZE];
+static const char *_upload_src;
+
+/* Keeps @p path with the pool buffer @p buf, there is a slot for each */
+static void _path_set(const uint8_t *buf, const char *path)
+{
+    mutex_lock(&_req_paths_lock);
+    for (unsigned i = 0; i < ARRAY_SIZE(_req_paths); i++) {
+        if (!_req_paths[i].buf) {
+            _req_paths[i].buf = buf;
+            strcpy(_req_paths[i].path, path);
+            break;
+        }
+    }
+    mutex_unlock(&_req_paths_lock);
+}
+
+/* Returns the path kept with @p buf, it does not change until the buffer is
+ * released */
+static const char *_path_get(const uint8_t *buf)
+{
+    const char *path = "";
+
+    mutex_lock(&_req_paths_lock);
+    for (unsigned i = 0; i < ARRAY_SIZE(_req_paths); i++) {
+        if (_req_paths[i].buf == buf) {
+            path = _req_paths[i].path;
+            break;
+        }
+    }
+    mutex_unlock(&_req_paths_lock);
+    return path;
+}
+
+/* Returns the buffer of a request to the pool, together with its path */
+static void _release(uint8_t *buf)
+{
+    mutex_lock(&_req_paths_lock);
+    for (unsigned i = 0; i < ARRAY_SIZE(_req_paths); i++) {
+        if (_req_paths[i].buf == buf) {
+            _req_paths[i].buf = NULL;
+            break;
+        }
+    }
+    mutex_unlock(&_req_paths_lock);
+    _release(buf);
+}
+
+static void _read_data(size_t offset, uint8_t *dst, size_t len)
+{
+    memcpy(dst, &_upload_src[offset], len);
+}
+
+/* test pattern of arbitrary length, produced block by block */
+static void _read_pattern(size_t offset, uint8_t *dst, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = 'a' + (offset + i) % 26;
+    }
+}
+
 /*
- * Response callback.
+ * Builds the request for the next block of the current upload into @p buf.
+ * Only the bytes of this block are produced. Returns the request length.
  */
+static ssize_t _upload_block(coap_pkt_t *pdu, uint8_t *buf, size_t len)
+{
+    coap_block_slicer_t slicer;
+    size_t blksize = coap_szx2size(_upload.szx);
+
+    coap_block_slicer_init(&slicer, _upload.offset / blksize, blksize);
+    size_t chunk = MIN(slicer.end, _upload.len) - slicer.start;
+
+    gcoap_req_init(pdu, buf, len, _upload.code, _path_get(buf));
+    coap_hdr_set_type(pdu->hdr, COAP_TYPE_CON);
+    coap_opt_add_format(pdu, _upload.format);
+    coap_opt_add_block1(pdu, &slicer, slicer.end < _upload.len);
+
+    ssize_t req_len = coap_opt_finish(pdu, COAP_OPT_FINISH_PAYLOAD);
+    if (pdu->payload_len < chunk) {
+        puts("The buffer is too small, reduce the block size");
+        return -1;
+    }
+
+    _upload.read(slicer.start, pdu->payload, chunk);
+    return req_len + chunk;
+}
+
 static void _resp_handler(const gcoap_request_memo_t *memo, coap_pkt_t* pdu,
-                          const sock_udp_ep_t *remote)
+                          const sock_udp_ep_t *remote);
+
+/*
+ * Sends the next block of the current upload after the server acknowledged
+ * the previous one with 2.31 Continue. The block is built in the pool buffer
+ * of the upload. Returns false if the upload ended.
+ */
+static bool _upload_continue(const gcoap_request_memo_t *memo, coap_pkt_t *pdu,
+                             const sock_udp_ep_t *remote)
 {
-    (void)remote;       /* not interested in the source currently */
+    coap_block1_t block1;
+    uint8_t *buf = memo->context;
 
-    if (memo->state == GCOAP_MEMO_TIMEOUT) {
-        printf("gcoap: timeout for msg ID %02u\n", coap_get_id(pdu));
-        return;
+    if (coap_get_block1(pdu, &block1) <= 0) {
+        puts("gcoap_cli: 2.31 response without Block1 option");
+        _upload.read = NULL;
+        return false;
     }
-    else if (memo->state != GCOAP_MEMO_RESP) {
-        printf("gcoap: error in response\n");
-        printf("state: %d\n", memo->state);
-        return;
+
+    /* the server may ask for smaller blocks than we sent, as sizes are
+     * powers of two the next offset is a multiple of the new size */
+    _upload.offset += coap_szx2size(_upload.szx);
+    _upload.szx = MIN(_upload.szx, block1.szx);
+
+    ssize_t len = _upload_block(pdu, buf, CONFIG_COAP_PDU_POOL_BUF_SIZE);
+    if (len < 0 || !gcoap_req_send(buf, len, remote, _resp_handler, buf)) {
+        puts("gcoap_cli: msg send failed");
+        _upload.read = NULL;
+        return false;
     }
+    printf("gcoap_cli: sent %u of %u bytes\n", (unsigned)_upload.offset,
+           (unsigned)_upload.len);
+    return true;
+}
+
+/*
+ * Builds the request for the block following @p block of a Block2 response
+ * into @p buf. Returns the request length.
+ */
+static ssize_t _download_block(coap_pkt_t *pdu, uint8_t *buf,
+                               coap_block1_t *block)
+{
+    /* the path is copied before the request overwrites the buffer */
+    char path[CONFIG_NANOCOAP_URI_MAX];
+    strcpy(path, _path_get(buf));
+    gcoap_req_init(pdu, buf, CONFIG_COAP_PDU_POOL_BUF_SIZE, COAP_METHOD_GET,
+                   path);
+    coap_hdr_set_type(pdu->hdr, COAP_TYPE_CON);
+
+    block->blknum++;
+    coap_opt_add_block2_control(pdu, block);
+    return coap_opt_finish(pdu, COAP_OPT_FINISH_NONE);
+}
+
+/*
+ * Requests the next block of a Block2 response in the pool buffer of the
+ * request. Returns false if the request could not be sent.
+ */
+static bool _download_continue(const gcoap_request_memo_t *memo, coap_pkt_t *pdu,
+                               const sock_udp_ep_t *remote, coap_block1_t *block)
+{
+    uint8_t *buf = memo->context;
+    ssize_t len = _download_block(pdu, buf, block);
 
+    if (!gcoap_req_send(buf, len, remote, _resp_handler, buf)) {
+        puts("gcoap_cli: msg send failed");
+        return false;
+    }
+    return true;
+}
+
+static void _print_response(coap_pkt_t *pdu)
+{
     char *class_str = (coap_get_code_class(pdu) == COAP_CLASS_SUCCESS) ? "Success" : "Error";
 
     printf("gcoap: response %s, code %1u.%02u", class_str,
@@ -77,8 +259,52 @@ static void _resp_handler(const gcoap_request_memo_t *memo, coap_pkt_t* pdu,
     }
 }
 
-static bool _parse_endpoint(sock_udp_ep_t *remote,
-                            const char *addr_str, const char *port_str)
+/*
+ * Response callback. The pool buffer of the request is passed as context, it
+ * is released once no follow-up request is sent from it.
+ */
+static void _resp_handler(const gcoap_request_memo_t *memo, coap_pkt_t* pdu,
+                          const sock_udp_ep_t *remote)
+{
+    if (memo->state == GCOAP_MEMO_TIMEOUT) {
+        printf("gcoap: timeout for msg ID %02u\n", coap_get_id(pdu));
+        _upload.read = NULL;
+        _release(memo->context);
+        return;
+    }
+    else if (memo->state != GCOAP_MEMO_RESP) {
+        printf("gcoap: error in response\n");
+        printf("state: %d\n", memo->state);
+        _upload.read = NULL;
+        _release(memo->context);
+        return;
+    }
+
+    if (_upload.read && coap_get_code_raw(pdu) == COAP_CODE_CONTINUE) {
+        if (!_upload_continue(memo, pdu, remote)) {
+            _release(memo->context);
+        }
+        return;
+    }
+    _upload.read = NULL;
+
+    coap_block1_t block2;
+    bool more_blocks = coap_get_block2(pdu, &block2) > 0 && block2.more;
+
+    _print_response(pdu);
+
+    /* each block is printed as it arrives, the body is never reassembled */
+    if (more_blocks) {
+        printf("gcoap_cli: requesting block %u\n", (unsigned)block2.blknum + 1);
+        if (_download_continue(memo, pdu, remote, &block2)) {
+            return;
+        }
+    }
+    _release(memo->context);
+}
+
+bool gcoap_cli_parse_endpoint(sock_udp_ep_t *remote,
+                              const char *addr_str, const char *port_str)
 {
     netif_t *netif;
 
@@ -100,26 +326,57 @@ static bool _parse_endpoint(sock_udp_ep_t *remote,
     return true;
 }
 
-static size_t _send(uint8_t *buf, size_t len, char *addr_str, char *port_str)
+static size_t _send(uint8_t *buf, size_t len, const sock_udp_ep_t *remote)
 {
     size_t bytes_sent;
-    sock_udp_ep_t remote;
-
-    if (!_parse_endpoint(&remote, addr_str, port_str)) {
-        return 0;
-    }
 
-    bytes_sent = gcoap_req_send(buf, len, &remote, _resp_handler, NULL);
+    bytes_sent = gcoap_req_send(buf, len, remote, _resp_handler, buf);
     if (bytes_sent > 0) {
         req_count++;
     }
     return bytes_sent;
 }
 
+/*
+ * Sends a confirmable request with adaptive retransmission timeouts and
+ * waits for the response, used with CONFIG_GCOAP_CLI_COCOA. Follow-up requests for Block2 responses are sent
+ * the same way, the command returns after the last block.
+ */
+static int _exchange(coap_pkt_t *pdu, size_t len, const sock_udp_ep_t *remote)
+{
+    while (1) {
+        ssize_t res = gcoap_cli_cocoa_exchange(pdu, len,
+                                               CONFIG_COAP_PDU_POOL_BUF_SIZE,
+                                               remote);
+        req_count++;
+        if (res == -ETIMEDOUT) {
+            puts("gcoap: timeout, no response");
+            return 1;
+        }
+        else if (res < 0) {
+            printf("gcoap: error in response (%d)\n", (int)res);
+            return 1;
+        }
+
+        coap_block1_t block2;
+        bool more_blocks = coap_get_block2(pdu, &block2) > 0 && block2.more;
+
+        _print_response(pdu);
+        if (!more_blocks) {
+            return 0;
+        }
+        printf("gcoap_cli: requesting block %u\n", (unsigned)block2.blknum + 1);
+        len = _download_block(pdu, (uint8_t *)pdu->hdr, &block2);
+    }
+}
+
 static int _print_usage(char **argv)
 {
     printf("usage: %s info\n", argv[0]);
     printf("       %s <get|post|put|delete> <addr>[%%iface] <port> <path> [data]\n",argv[0]);
+    printf("       %s <post|put> <addr>[%%iface] <port> <path> -n <bytes>\n", argv[0]);
+    printf("       %s bench <addr>[%%iface] <port> <path> -n <requests> -c <concurrency>\n",
+           argv[0]);
     return 1;
 }
 
@@ -130,6 +387,20 @@ static int _coap_info_cmd(void)
     printf("CoAP server is listening on port %u\n", CONFIG_GCOAP_PORT);
     printf(" CLI requests sent: %u\n", req_count);
     printf("CoAP open requests: %u\n", open_reqs);
+
+    coap_pdu_pool_stats_t stats;
+    coap_pdu_pool_stats(&stats);
+    printf("PDU buffers: %u of %u in use, at most %u, %u times exhausted\n",
+           stats.in_use, CONFIG_COAP_PDU_POOL_SIZE, stats.high_water,
+           stats.exhausted);
+
+    if (CONFIG_GCOAP_CLI_COCOA) {
+        gcoap_cli_cocoa_info();
+    }
+    else {
+        puts("Retransmission timeouts: fixed, estimated from the RTTs only "
+             "with COAP_COCOA=1");
+    }
     return 0;
 }
 
@@ -156,7 +427,7 @@ int _method_str_to_code(const char *method)
 int gcoap_cli_cmd(int argc, char **argv)
 {
 
-    uint8_t buf[CONFIG_GCOAP_PDU_BUF_SIZE];
+    uint8_t *buf;
     coap_pkt_t pdu;
     size_t len;
     int position = 1;
@@ -171,7 +442,11 @@ int gcoap_cli_cmd(int argc, char **argv)
         return _coap_info_cmd();
     }
 
-    if ((argc != 5) && (argc != 6)) {
+    if (strcmp(argv[position], "bench") == 0) {
+        return gcoap_cli_bench(argc, argv);
+    }
+
+    if ((argc != 5) && (argc != 6) && (argc != 7)) {
         /* invalid number of arguments, show help for the command */
         return _print_usage(argv);
     }
@@ -194,30 +469,115 @@ int gcoap_cli_cmd(int argc, char **argv)
         return _print_usage(argv);
     }
 
-    char *data = NULL;
+    /* requests to a multicast group collect the responses of all members */
+    sock_udp_ep_t remote;
+    if (!gcoap_cli_parse_endpoint(&remote, addr, port)) {
+        return 1;
+    }
+    if (ipv6_addr_is_multicast((ipv6_addr_t *)&remote.addr.ipv6)) {
+        if (code != COAP_METHOD_GET || argc != 5) {
+            puts("gcoap_cli: only GET without data can be sent to a group");
+            return 1;
+        }
+        return gcoap_cli_group_get(&remote, path);
+    }
+
+    if (strlen(path) >= CONFIG_NANOCOAP_URI_MAX) {
+        puts("gcoap_cli: path too long");
+        return 1;
+    }
+
     size_t data_len = 0;
+    _upload_read_t read = _read_data;
+    unsigned format = COAP_FORMAT_TEXT;
     if (argc == 6) {
-        data = argv[position++];
-        data_len = strlen(data);
+        _upload_src = argv[position++];
+        data_len = strlen(_upload_src);
+    }
+    else if (argc == 7) {
+        /* generated body of the given length */
+        if (strcmp(argv[position++], "-n")) {
+            return _print_usage(argv);
+        }
+        const char *len_str = argv[position++];
+        char *end;
+        errno = 0;
+        unsigned long n = strtoul(len_str, &end, 10);
+        if (errno || end == len_str || *end || n == 0 || n > CLI_UPLOAD_MAX) {
+            printf("gcoap_cli: body length must be 1 to %lu bytes\n",
+                   (unsigned long)CLI_UPLOAD_MAX);
+            return _print_usage(argv);
+        }
+        data_len = n;
+        read = _read_pattern;
+        format = COAP_FORMAT_OCTET;
     }
     printf("%s\n", path);
+
+    if (_upload.read) {
+        puts("gcoap_cli: upload in progress");
+        return 1;
+    }
+
+    /* the request is built in place, payloads are written straight into the
+     * buffer */
+    buf = coap_pdu_pool_acquire();
+    if (!buf) {
+        puts("gcoap_cli: no free PDU buffer");
+        return 1;
+    }
+    _path_set(buf, path);
+
+    /* bodies larger than a block are uploaded blockwise, the remaining blocks
+     * are sent from the response handler, which also releases the buffer */
+    if (data_len > coap_szx2size(CLI_BLOCK_SZX)) {
+        if (read == _read_data) {
+            /* keep the data, blocks are sent after the command returned */
+            strcpy(_upload_data, _upload_src);
+            _upload_src = _upload_data;
+        }
+        _upload = (_upload_t){
+            .read = read, .len = data_len, .szx = CLI_BLOCK_SZX,
+            .code = code, .format = format,
+        };
+
+        ssize_t req_len = _upload_block(&pdu, buf, CONFIG_COAP_PDU_POOL_BUF_SIZE);
+        if (req_len < 0) {
+            _upload.read = NULL;
+            _release(buf);
+            return 1;
+        }
+        len = req_len;
+
+        printf("gcoap_cli: sending msg ID %u, %u bytes\n", coap_get_id(&pdu),
+               (unsigned)len);
+        if (!_send(buf, len, &remote)) {
+            puts("gcoap_cli: msg send failed");
+            _upload.read = NULL;
+            _release(buf);
+            return -1;
+        }
+        return 0;
+    }
+
     /* initialize the CoAP request */
-    gcoap_req_init(&pdu, buf, CONFIG_GCOAP_PDU_BUF_SIZE, code, path);
+    gcoap_req_init(&pdu, buf, CONFIG_COAP_PDU_POOL_BUF_SIZE, code, path);
 
     /* send a confirmable message */
     coap_hdr_set_type(pdu.hdr, COAP_TYPE_CON);
 
-    /* if there is data, we specify the plain text format and copy the payload */
+    /* if there is data, we specify the format and write the payload */
     if (data_len) {
-        coap_opt_add_format(&pdu, COAP_FORMAT_TEXT);
+        coap_opt_add_format(&pdu, format);
 
         len = coap_opt_finish(&pdu, COAP_OPT_FINISH_PAYLOAD);
         if (pdu.payload_len >= data_len) {
-            memcpy(pdu.payload, data, data_len);
+            read(0, pdu.payload, data_len);
             len += data_len;
         }
         else {
             puts("The buffer is too small, reduce the message length");
+            _release(buf);
             return 1;
         }
     } else {
@@ -225,8 +585,16 @@ int gcoap_cli_cmd(int argc, char **argv)
     }
 
     printf("gcoap_cli: sending msg ID %u, %u bytes\n", coap_get_id(&pdu), (unsigned) len);
-    if (!_send(buf, len, addr, port)) {
+    if (CONFIG_GCOAP_CLI_COCOA) {
+        /* the command waits for the response, the retransmission timeouts
+         * adapt to the round trip times to the destination */
+        int res = _exchange(&pdu, len, &remote);
+        _release(buf);
+        return res;
+    }
+    if (!_send(buf, len, &remote)) {
         puts("gcoap_cli: msg send failed");
+        _release(buf);
         return -1;
     }
     return 0;
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @brief       Confirmable requests with adaptive retransmission timeouts
+ *
+ * gcoap retransmits confirmable requests after a fixed initial timeout. With
+ * CONFIG_GCOAP_CLI_COCOA set, this file sends the single requests of the
+ * `coap` command from a socket of its own instead and derives the timeouts
+ * from the round trip times measured per destination (CoCoA).
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "coap_cocoa.h"
+#include "net/gcoap.h"
+#include "net/ipv6/addr.h"
+#include "net/sock/udp.h"
+#include "random.h"
+#include "ztimer.h"
+
+#include "gcoap_example.h"
+
+/* Number of destinations whose RTO state is kept */
+#ifndef CONFIG_GCOAP_CLI_COCOA_DESTS
+#define CONFIG_GCOAP_CLI_COCOA_DESTS    (4U)
+#endif
+
+/* Time to wait for a separate response after an empty ACK, in ms */
+#ifndef CONFIG_GCOAP_CLI_SEPARATE_TIMEOUT
+#define CONFIG_GCOAP_CLI_SEPARATE_TIMEOUT   (10U * MS_PER_SEC)
+#endif
+
+/* RTO state and statistics of one destination */
+typedef struct {
+    ipv6_addr_t addr;           /**< destination address */
+    coap_cocoa_t cocoa;         /**< RTO estimator */
+    uint32_t last_used;         /**< time of the last exchange */
+    uint32_t exchanges;         /**< exchanges with the destination */
+    uint32_t retransmissions;   /**< retransmitted requests */
+    uint32_t timeouts;          /**< exchanges that got no response */
+} _dest_t;
+
+static _dest_t _dests[CONFIG_GCOAP_CLI_COCOA_DESTS];
+
+/* Returns the state of a destination, replacing the least recently used one
+ * when the address is not known yet */
+static _dest_t *_dest_get(const ipv6_addr_t *addr, uint32_t now)
+{
+    for (unsigned i = 0; i < ARRAY_SIZE(_dests); i++) {
+        if (_dests[i].exchanges && ipv6_addr_equal(&_dests[i].addr, addr)) {
+            return &_dests[i];
+        }
+    }
+
+    /* a free entry, else the one unused for the longest time. Ages are
+     * compared instead of times, which survives a wrap of the clock. */
+    _dest_t *lru = &_dests[0];
+    for (unsigned i = 0; i < ARRAY_SIZE(_dests); i++) {
+        if (!_dests[i].exchanges) {
+            lru = &_dests[i];
+            break;
+        }
+        if (now - _dests[i].last_used > now - lru->last_used) {
+            lru = &_dests[i];
+        }
+    }
+
+    memset(lru, 0, sizeof(*lru));
+    lru->addr = *addr;
+    coap_cocoa_init(&lru->cocoa, now);
+    return lru;
+}
+
+/* Acknowledges a confirmable separate response */
+static void _send_empty_ack(sock_udp_t *sock, uint16_t id,
+                            const sock_udp_ep_t *remote)
+{
+    coap_hdr_t ack;
+
+    coap_build_hdr(&ack, COAP_TYPE_ACK, NULL, 0, COAP_CODE_EMPTY, id);
+    sock_udp_send(sock, &ack, sizeof(ack), remote);
+}
+
+ssize_t gcoap_cli_cocoa_exchange(coap_pkt_t *req, size_t len, size_t buf_len,
+                                 const sock_udp_ep_t *remote)
+{
+    sock_udp_ep_t local = SOCK_IPV6_EP_ANY;
+    sock_udp_t sock;
+    coap_pkt_t pdu;
+    uint8_t *buf = (uint8_t *)req->hdr;
+    uint32_t now = ztimer_now(ZTIMER_MSEC);
+    _dest_t *dest = _dest_get((const ipv6_addr_t *)&remote->addr.ipv6, now);
+
+    /* responses are received behind the request, which has to stay intact
+     * for retransmissions */
+    uint16_t id = coap_get_id(req);
+    uint8_t token[COAP_TOKEN_LENGTH_MAX];
+    uint8_t token_len = coap_get_token_len(req);
+    memcpy(token, coap_get_token(req), token_len);
+
+    local.netif = remote->netif;
+    if (sock_udp_create(&sock, &local, NULL, 0) < 0) {
+        return -ENOTCONN;
+    }
+
+    dest->exchanges++;
+    dest->last_used = now;
+
+    /* the first timeout is dithered between 1 and 1.5 times the RTO */
+    uint32_t rto = coap_cocoa_rto(&dest->cocoa, now);
+    uint32_t timeout = random_uint32_range(rto, rto + rto / 2 + 1);
+    uint32_t first_sent = now;
+    unsigned transmissions = 0;
+    bool acked = false;
+    ssize_t res = -ETIMEDOUT;
+
+    while (!acked && transmissions <= CONFIG_COAP_MAX_RETRANSMIT) {
+        if (transmissions++) {
+            dest->retransmissions++;
+        }
+        if (sock_udp_send(&sock, buf, len, remote) < 0) {
+            res = -EIO;
+            break;
+        }
+
+        uint32_t sent_at = ztimer_now(ZTIMER_MSEC);
+        uint32_t waited;
+        while (!acked &&
+               (waited = ztimer_now(ZTIMER_MSEC) - sent_at) < timeout) {
+            sock_udp_ep_t ep;
+            ssize_t rcvd = sock_udp_recv(&sock, buf + len, buf_len - len,
+                                         (timeout - waited) * US_PER_MS, &ep);
+            if (rcvd == -ETIMEDOUT) {
+                break;
+            }
+            if (rcvd < 0 || coap_parse(&pdu, buf + len, rcvd) < 0 ||
+                !(coap_get_type(&pdu) == COAP_TYPE_ACK ||
+                  coap_get_type(&pdu) == COAP_TYPE_RST) ||
+                coap_get_id(&pdu) != id) {
+                continue;
+            }
+
+            acked = true;
+            now = ztimer_now(ZTIMER_MSEC);
+            coap_cocoa_sample(&dest->cocoa, now - first_sent, transmissions, now);
+            if (coap_get_type(&pdu) == COAP_TYPE_RST) {
+                res = -ECONNREFUSED;
+            }
+            else if (coap_get_code_raw(&pdu) != COAP_CODE_EMPTY) {
+                /* piggybacked response */
+                res = rcvd;
+            }
+        }
+        timeout = coap_cocoa_backoff(timeout);
+    }
+
+    /* after an empty ACK the response follows in a message of its own */
+    if (acked && res == -ETIMEDOUT) {
+        uint32_t acked_at = ztimer_now(ZTIMER_MSEC);
+        uint32_t waited;
+        while ((waited = ztimer_now(ZTIMER_MSEC) - acked_at) <
+               CONFIG_GCOAP_CLI_SEPARATE_TIMEOUT) {
+            sock_udp_ep_t ep;
+            ssize_t rcvd = sock_udp_recv(&sock, buf + len, buf_len - len,
+                (CONFIG_GCOAP_CLI_SEPARATE_TIMEOUT - waited) * US_PER_MS, &ep);
+            if (rcvd == -ETIMEDOUT) {
+                break;
+            }
+            if (rcvd < 0 || coap_parse(&pdu, buf + len, rcvd) < 0 ||
+                coap_get_token_len(&pdu) != token_len ||
+                memcmp(coap_get_token(&pdu), token, token_len)) {
+                continue;
+            }
+            if (coap_get_type(&pdu) == COAP_TYPE_CON) {
+                _send_empty_ack(&sock, coap_get_id(&pdu), &ep);
+            }
+            res = rcvd;
+            break;
+        }
+    }
+
+    sock_udp_close(&sock);
+
+    if (res == -ETIMEDOUT) {
+        dest->timeouts++;
+    }
+    else if (res > 0) {
+        /* hand the response to the caller at the start of the buffer */
+        memmove(buf, buf + len, res);
+        coap_parse(req, buf, res);
+    }
+    return res;
+}
+
+void gcoap_cli_cocoa_info(void)
+{
+    char addr_str[IPV6_ADDR_MAX_STR_LEN];
+    uint32_t now = ztimer_now(ZTIMER_MSEC);
+
+    puts("CoCoA RTO per destination (ms):");
+    for (unsigned i = 0; i < ARRAY_SIZE(_dests); i++) {
+        _dest_t *dest = &_dests[i];
+        if (!dest->exchanges) {
+            continue;
+        }
+        ipv6_addr_to_str(addr_str, &dest->addr, sizeof(addr_str));
+        printf("%s\n", addr_str);
+        printf("    rto %" PRIu32 ", strong srtt %" PRIu32 " rttvar %" PRIu32
+               " (%u samples), weak srtt %" PRIu32 " rttvar %" PRIu32
+               " (%u samples)\n",
+               coap_cocoa_rto_peek(&dest->cocoa, now),
+               dest->cocoa.strong.srtt, dest->cocoa.strong.rttvar,
+               dest->cocoa.strong.samples,
+               dest->cocoa.weak.srtt, dest->cocoa.weak.rttvar,
+               dest->cocoa.weak.samples);
+        printf("    %" PRIu32 " exchanges, %" PRIu32 " retransmissions, %"
+               PRIu32 " timeouts\n", dest->exchanges, dest->retransmissions,
+               dest->timeouts);
+    }
+}
@@ -35,6 +35,74 @@ extern "C" {
 
 extern uint16_t req_count;  /**< Counts requests sent by CLI. */
 
+/**
+ * @brief   Parses an endpoint given on the shell
+ *
+ * @param[out] remote       parsed endpoint
+ * @param[in]  addr_str     IPv6 address, optionally with `%iface`
+ * @param[in]  port_str     UDP port
+ *
+ * @return  true on success, false if the endpoint is invalid
+ */
+bool gcoap_cli_parse_endpoint(sock_udp_ep_t *remote,
+                              const char *addr_str, const char *port_str);
+
+/**
+ * @brief   Runs the `coap bench` load generator
+ *
+ * Blocks until all requests were answered or timed out.
+ */
+int gcoap_cli_bench(int argc, char **argv);
+
+/**
+ * @brief   Sends a NON GET request to a multicast group
+ *
+ * Collects the responses arriving within CONFIG_GCOAP_CLI_GROUP_WINDOW ms
+ * and prints a summary per responding node.
+ *
+ * @param[in] remote    multicast endpoint of the group
+ * @param[in] path      requested path
+ */
+int gcoap_cli_group_get(const sock_udp_ep_t *remote, const char *path);
+
+/**
+ * @brief   Send the single requests of the `coap` command with CoCoA
+ *          retransmission timeouts
+ *
+ * The command then blocks the shell until the response arrived or the
+ * request timed out, which may take more than a minute. By default requests
+ * are sent through gcoap with its fixed timeouts.
+ */
+#ifndef CONFIG_GCOAP_CLI_COCOA
+#define CONFIG_GCOAP_CLI_COCOA      0
+#endif
+
+/**
+ * @brief   Sends a confirmable request with CoCoA retransmission timeouts
+ *
+ * Blocks until the response arrived or the request timed out. The request
+ * is not tracked by gcoap and does not show in its open requests. The response
+ * is received into the free part of the request buffer and then moved to its
+ * start.
+ *
+ * @param[in,out] req       request to send, holds the response on success
+ * @param[in]     len       length of the request
+ * @param[in]     buf_len   size of the buffer of @p req
+ * @param[in]     remote    destination of the request
+ *
+ * @return  length of the response
+ * @return  -ETIMEDOUT if no response arrived
+ * @return  -ECONNREFUSED if the request was rejected with a reset
+ * @return  other negative errno values on send errors
+ */
+ssize_t gcoap_cli_cocoa_exchange(coap_pkt_t *req, size_t len, size_t buf_len,
+                                 const sock_udp_ep_t *remote);
+
+/**
+ * @brief   Prints the RTO state of all known destinations
+ */
+void gcoap_cli_cocoa_info(void);
+
 /**
  * @brief   Registers the CoAP resources exposed in the example app
  *
@@ -42,6 +110,13 @@ extern uint16_t req_count;  /**< Counts requests sent by CLI. */
  */
 void server_init(void);
 
+/**
+ * @brief   Registers the blockwise /riot/blob resource
+ *
+ * Run this exactly one during startup.
+ */
+void blob_server_init(void);
+
 #ifdef __cplusplus
 }
 #endif
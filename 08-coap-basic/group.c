@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @brief       CoAP group requests for the `coap` shell command
+ *
+ * A request to a multicast address is answered by every member of the group.
+ * gcoap finishes a request with the first response, so group requests are
+ * sent from a socket of their own, which collects all responses that arrive
+ * within a time window.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "coap_pdu_pool.h"
+#include "net/gcoap.h"
+#include "net/ipv6/addr.h"
+#include "net/sock/udp.h"
+#include "ztimer.h"
+
+#include "gcoap_example.h"
+
+/* Time to wait for responses to a group request, in ms */
+#ifndef CONFIG_GCOAP_CLI_GROUP_WINDOW
+#define CONFIG_GCOAP_CLI_GROUP_WINDOW   (2U * MS_PER_SEC)
+#endif
+
+/* Maximum number of nodes listed in the summary of a group request */
+#ifndef CONFIG_GCOAP_CLI_GROUP_NODES_MAX
+#define CONFIG_GCOAP_CLI_GROUP_NODES_MAX    (16U)
+#endif
+
+/* Responses of one group member */
+typedef struct {
+    sock_udp_ep_t ep;       /**< endpoint of the member */
+    uint32_t rtt_us;        /**< round trip time of the first response */
+    unsigned responses;     /**< number of responses, duplicates included */
+    uint8_t code;           /**< code of the first response */
+    uint16_t payload_len;   /**< payload length of the first response */
+} _group_node_t;
+
+static _group_node_t _nodes[CONFIG_GCOAP_CLI_GROUP_NODES_MAX];
+
+/* Finds the entry of an endpoint or adds a new one, NULL if full */
+static _group_node_t *_node_get(const sock_udp_ep_t *ep, unsigned *count)
+{
+    for (unsigned i = 0; i < *count; i++) {
+        if (sock_udp_ep_equal(&_nodes[i].ep, ep)) {
+            return &_nodes[i];
+        }
+    }
+    if (*count == ARRAY_SIZE(_nodes)) {
+        return NULL;
+    }
+    _group_node_t *node = &_nodes[(*count)++];
+    memset(node, 0, sizeof(*node));
+    node->ep = *ep;
+    return node;
+}
+
+static void _print_summary(unsigned count, unsigned dropped)
+{
+    char addr_str[IPV6_ADDR_MAX_STR_LEN];
+
+    printf("gcoap_cli: %u nodes responded within %u ms\n", count,
+           (unsigned)CONFIG_GCOAP_CLI_GROUP_WINDOW);
+    for (unsigned i = 0; i < count; i++) {
+        const _group_node_t *node = &_nodes[i];
+
+        ipv6_addr_to_str(addr_str, (ipv6_addr_t *)&node->ep.addr.ipv6,
+                         sizeof(addr_str));
+        printf("[%s]:%u code %1u.%02u, %u bytes, rtt %" PRIu32 " us",
+               addr_str, node->ep.port, node->code >> 5, node->code & 0x1f,
+               node->payload_len, node->rtt_us);
+        if (node->responses > 1) {
+            printf(", %u duplicates", node->responses - 1);
+        }
+        puts("");
+    }
+    if (dropped) {
+        printf("gcoap_cli: %u responses of further nodes dropped\n", dropped);
+    }
+}
+
+int gcoap_cli_group_get(const sock_udp_ep_t *remote, const char *path)
+{
+    sock_udp_ep_t local = SOCK_IPV6_EP_ANY;
+    sock_udp_t sock;
+    coap_pkt_t pdu;
+
+    uint8_t *buf = coap_pdu_pool_acquire();
+    if (!buf) {
+        puts("gcoap_cli: no free PDU buffer");
+        return 1;
+    }
+
+    /* responses are sent to the source port of the request */
+    local.netif = remote->netif;
+    if (sock_udp_create(&sock, &local, NULL, 0) < 0) {
+        puts("gcoap_cli: unable to create socket");
+        coap_pdu_pool_release(buf);
+        return 1;
+    }
+
+    /* multicast requests must not be confirmable */
+    gcoap_req_init(&pdu, buf, CONFIG_COAP_PDU_POOL_BUF_SIZE, COAP_METHOD_GET,
+                   path);
+    coap_hdr_set_type(pdu.hdr, COAP_TYPE_NON);
+    ssize_t len = coap_opt_finish(&pdu, COAP_OPT_FINISH_NONE);
+
+    uint8_t token[COAP_TOKEN_LENGTH_MAX];
+    uint8_t token_len = coap_get_token_len(&pdu);
+    memcpy(token, coap_get_token(&pdu), token_len);
+
+    printf("gcoap_cli: sending group msg ID %u, %u bytes\n", coap_get_id(&pdu),
+           (unsigned)len);
+    uint32_t start = ztimer_now(ZTIMER_USEC);
+    if (sock_udp_send(&sock, buf, len, remote) < 0) {
+        puts("gcoap_cli: msg send failed");
+        sock_udp_close(&sock);
+        coap_pdu_pool_release(buf);
+        return 1;
+    }
+    req_count++;
+
+    unsigned count = 0;
+    unsigned dropped = 0;
+    uint32_t window = CONFIG_GCOAP_CLI_GROUP_WINDOW * US_PER_MS;
+    uint32_t elapsed;
+
+    /* collect responses until the window closes */
+    while ((elapsed = ztimer_now(ZTIMER_USEC) - start) < window) {
+        sock_udp_ep_t ep;
+        ssize_t res = sock_udp_recv(&sock, buf, CONFIG_COAP_PDU_POOL_BUF_SIZE,
+                                    window - elapsed, &ep);
+        if (res == -ETIMEDOUT) {
+            break;
+        }
+        uint32_t rtt = ztimer_now(ZTIMER_USEC) - start;
+
+        if (res < 0 || coap_parse(&pdu, buf, res) < 0 ||
+            coap_get_token_len(&pdu) != token_len ||
+            memcmp(coap_get_token(&pdu), token, token_len)) {
+            /* not a response to our request */
+            continue;
+        }
+
+        _group_node_t *node = _node_get(&ep, &count);
+        if (!node) {
+            dropped++;
+            continue;
+        }
+        if (node->responses++ == 0) {
+            node->rtt_us = rtt;
+            node->code = coap_get_code_raw(&pdu);
+            node->payload_len = pdu.payload_len;
+        }
+    }
+
+    sock_udp_close(&sock);
+    coap_pdu_pool_release(buf);
+    _print_summary(count, dropped);
+    return 0;
+}
@@ -23,6 +23,7 @@ int main(void)
     /* for the thread running the shell */
     msg_init_queue(_main_msg_queue, MAIN_QUEUE_SIZE);
     server_init();
+    blob_server_init();
 
     /* start shell */
     puts("All up, running the shell now");
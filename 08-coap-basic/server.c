@@ -16,6 +16,7 @@
 #include "net/utils.h"
 #include "od.h"
 
+#include "coap_index.h"
 #include "gcoap_example.h"
 
 #include "periph/gpio.h"
@@ -33,24 +34,35 @@ static const coap_resource_t _resources[] = {
     { "/riot/board", COAP_GET, _riot_board_handler, NULL },
 };
 
+/* hash slots of the index over the resources */
+static uint16_t _index_slots[COAP_INDEX_SLOTS(ARRAY_SIZE(_resources))];
+
 /* a gcoap listener is a collection of resources. Additionally we can specify
  * custom functions to:
  *      - list our resources on the /.well-known/core
  *      - how our resources are matched on an incoming request (simple string
- *        comparison is the default)
+ *        comparison is the default, here we look them up in a hash index)
  */
-static gcoap_listener_t _listener = {
-    _resources,
-    ARRAY_SIZE(_resources),
-    GCOAP_SOCKET_TYPE_UDP,
-    NULL,
-    NULL,
-    NULL
+static coap_index_listener_t _listener = {
+    .listener = {
+        _resources,
+        ARRAY_SIZE(_resources),
+        GCOAP_SOCKET_TYPE_UDP,
+        NULL,
+        NULL,
+        coap_index_request_matcher
+    },
 };
 
 void server_init(void)
 {
-    gcoap_register_listener(&_listener);
+    if (coap_index_init(&_listener.index, _resources, ARRAY_SIZE(_resources),
+                        _index_slots, ARRAY_SIZE(_index_slots)) < 0) {
+        /* the default matcher of gcoap compares the paths one by one */
+        puts("CoAP: could not index the resources, matching them linearly");
+        _listener.listener.request_matcher = NULL;
+    }
+    gcoap_register_listener(&_listener.listener);
 
     /* [TASK 2: initialize the GPIOs here] */
 }
@@ -16,22 +16,95 @@
  * @}
  */
 
+#include <inttypes.h>
 #include <stdio.h>
 
 /* Include required GNRC and Shell headers */
+#include "board.h"
+#include "event/thread.h"
+#include "kernel_defines.h"
+#include "lorawan_dispatch.h"
+#include "od.h"
 #include "shell.h"
-#include "net/gnrc/netreg.h"
-#include "net/gnrc/pktdump.h"
+
+#if IS_USED(MODULE_NETDEV_LORA_SIM)
+#include "netdev_lora_sim.h"
+#endif
+
+/* FPorts of the downlinks handled by the application */
+#define PORT_PRINT  (1U)
+#define PORT_LED    (10U)
+
+static void _print(const gnrc_pktsnip_t *payload, uint8_t port, void *arg)
+{
+    (void)arg;
+
+    printf("Downlink on port %u, %u bytes\n", port, (unsigned)payload->size);
+    od_hex_dump(payload->data, payload->size, OD_WIDTH_DEFAULT);
+}
+
+/* Switches LED0 off with a payload of 0, on with any other value */
+static void _led(const gnrc_pktsnip_t *payload, uint8_t port, void *arg)
+{
+    (void)port;
+    (void)arg;
+
+    if (payload->size != 1) {
+        puts("LED downlink needs one byte");
+        return;
+    }
+#ifdef LED0_ON
+    if (*(uint8_t *)payload->data) {
+        LED0_ON;
+    }
+    else {
+        LED0_OFF;
+    }
+#endif
+}
+
+/* Handlers of the downlinks by FPort */
+static lorawan_dispatch_port_t _ports[] = {
+    { .port = PORT_PRINT, .cb = _print },
+    { .port = PORT_LED, .cb = _led },
+};
+
+static lorawan_dispatch_t _dispatch;
+
+static int _downlinks_cmd(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    puts("port  count  bytes  run avg  run max  wait max (us)");
+    for (unsigned i = 0; i < ARRAY_SIZE(_ports); i++) {
+        const lorawan_dispatch_stats_t *stats = &_ports[i].stats;
+        uint32_t avg = stats->count ? stats->run_total / stats->count : 0;
+
+        printf("%4u %6" PRIu32 " %6" PRIu32 " %8" PRIu32 " %8" PRIu32
+               " %9" PRIu32 "\n", _ports[i].port, stats->count, stats->bytes,
+               avg, stats->run_max, stats->wait_max);
+    }
+    printf("unknown port: %" PRIu32 ", dropped: %" PRIu32 "\n",
+           _dispatch.unknown, _dispatch.dropped);
+    return 0;
+}
+
+SHELL_COMMAND(downlinks, "Show statistics of the downlinks", _downlinks_cmd);
 
 int main(void)
 {
-    puts("Initialization successful - starting the shell now");
+#if IS_USED(MODULE_NETDEV_LORA_SIM)
+    /* the simulated radio of native is not set up by auto_init */
+    netdev_lora_sim_auto_init();
+#endif
 
-    /* [OPTIONAL] Receive LoRaWAN packets in GNRC pktdump */
-    gnrc_netreg_entry_t dump = GNRC_NETREG_ENTRY_INIT_PID(GNRC_NETREG_DEMUX_CTX_ALL,
-                                                          gnrc_pktdump_pid);
+    puts("Initialization successful - starting the shell now");
 
-    gnrc_netreg_register(GNRC_NETTYPE_UNDEF, &dump);
+    /* Pass LoRaWAN downlinks to the handlers of their port. They run on the
+     * event thread, no thread of their own is needed */
+    lorawan_dispatch_init(&_dispatch, EVENT_PRIO_MEDIUM, _ports,
+                          ARRAY_SIZE(_ports));
 
     /* start the shell */
     char line_buf[SHELL_DEFAULT_BUFSIZE];
@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""Decodes the uplinks sent by the LoRaWAN sensor application.
+
+An uplink carries one or more records, each a batch of samples framed by its
+length and its age in seconds.
+
+Usage: decode.py <payload as hex or base64>
+"""
+import base64
+import binascii
+import sys
+
+# Fields of each schema: name, bits, signed and scale. Keep in sync with the
+# schemas in main.c
+SCHEMAS = {
+    1: [("counter", 8, False, 1)],
+    2: [("counter", 8, False, 1), ("temperature", 16, True, 0.01)],
+}
+
+
+class BitReader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def get(self, bits):
+        if self.pos + bits > len(self.data) * 8:
+            raise ValueError("payload truncated")
+        value = 0
+        for _ in range(bits):
+            byte = self.data[self.pos >> 3]
+            value = (value << 1) | ((byte >> (7 - (self.pos & 7))) & 1)
+            self.pos += 1
+        return value
+
+
+def decode(payload):
+    """Returns the period in seconds and the samples, oldest first, as list
+    of dicts"""
+    r = BitReader(payload)
+    schema_id = r.get(8)
+    count = r.get(8)
+    period = r.get(16)
+    if schema_id not in SCHEMAS:
+        raise ValueError(f"unknown schema {schema_id}")
+    fields = SCHEMAS[schema_id]
+
+    bases = []
+    widths = []
+    for name, bits, signed, scale in fields:
+        base = r.get(bits)
+        if signed and base >> (bits - 1):
+            base -= 1 << bits
+        bases.append(base)
+        widths.append(r.get(5))
+
+    samples = []
+    for _ in range(count):
+        sample = {}
+        for (name, bits, signed, scale), base, width in \
+                zip(fields, bases, widths):
+            value = base + r.get(width)
+            sample[name] = value * scale if scale != 1 else value
+        samples.append(sample)
+    return period, samples
+
+
+def records(payload):
+    """Splits an uplink into its records, returns a list of the age in
+    seconds and the payload of each record"""
+    result = []
+    pos = 0
+    while pos < len(payload):
+        if pos + 3 > len(payload):
+            raise ValueError("record header truncated")
+        length = payload[pos]
+        age = int.from_bytes(payload[pos + 1:pos + 3], "big")
+        pos += 3
+        if pos + length > len(payload):
+            raise ValueError("record truncated")
+        result.append((age, payload[pos:pos + length]))
+        pos += length
+    return result
+
+
+def samples(payload):
+    """Returns the samples of all records of an uplink as list of the age in
+    seconds and the sample"""
+    result = []
+    for age, record in records(payload):
+        period, batch = decode(record)
+        for i, sample in enumerate(batch):
+            result.append((age + (len(batch) - 1 - i) * period, sample))
+    return result
+
+
+def parse(text):
+    try:
+        return bytes.fromhex(text)
+    except ValueError:
+        return base64.b64decode(text)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 2:
+        print(__doc__)
+        sys.exit(1)
+    try:
+        decoded = samples(parse(sys.argv[1]))
+    except (ValueError, binascii.Error) as e:
+        print(f"Could not decode: {e}")
+        sys.exit(1)
+    for age, sample in decoded:
+        print(f"-{age:5d} s", sample)
@@ -15,6 +15,8 @@
  *
  */
 
+#include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 
 /* Board PIN definitions */
@@ -26,6 +28,23 @@
 /* Event Queues and Event Thread */
 #include "event.h"
 #include "event/thread.h"
+#include "event/timeout.h"
+#include "time_units.h"
+#include "ztimer.h"
+
+/* Time-on-air and duty-cycle ledger, data rate and size of the uplinks */
+#include "lorawan_airtime.h"
+#include "lorawan_policy.h"
+
+/* Sensor access and packing of the samples */
+#include "saul_reg.h"
+#include "sample_pack.h"
+
+/* Records kept until their uplink was delivered */
+#include "uplink_journal.h"
+
+/* Debounced button presses, handled in batches */
+#include "irq_event.h"
 
 /* LoRa defines */
 #include "net/lora.h"
@@ -37,25 +56,162 @@
 /* GNRC's network communication interface */
 #include "net/gnrc/netapi.h"
 
+/* Result of the uplinks */
+#include "msg.h"
+#include "net/gnrc/neterr.h"
+#include "thread.h"
+
 /* String formatting */
 #include "fmt.h"
 
+/* MIN, MAX and ARRAY_SIZE */
+#include "kernel_defines.h"
+
+/* Jitter of the join backoff */
+#include "random.h"
+
+/* Session stored across reboots */
+#include "session.h"
+
+#if IS_USED(MODULE_NETDEV_LORA_SIM)
+/* Simulated radio of the native board */
+#include "netdev_lora_sim.h"
+#endif
+
 /* Unit system wait time to complete join procedure in seconds */
 #define JOIN_DELAY      (10U * MS_PER_SEC)
 
-/* LoRaWAN data rate */
-#define LORAWAN_DATARATE    LORAMAC_DR_5
+/* After a failed join the node waits a random time of half to all of a
+ * backoff before trying again. The backoff starts here and doubles with each
+ * failure, up to JOIN_BACKOFF_MAX, so that many nodes restarting at once do
+ * not keep joining in lockstep */
+#define JOIN_BACKOFF_MIN    (10U * MS_PER_SEC)
+#define JOIN_BACKOFF_MAX    (30U * 60U * MS_PER_SEC)
+
+/* LoRaWAN data rate of the join and of the uplinks until the link is known,
+ * set by LORAWAN_DR in the Makefile */
+#define LORAWAN_DATARATE    CONFIG_LORAMAC_DEFAULT_DR
+
+/* Range of data rates the policy picks from for each uplink */
+#define LORAWAN_DR_MIN      LORAMAC_DR_0
+#define LORAWAN_DR_MAX      LORAMAC_DR_5
+
+/* Longest a sample is held back to fill an uplink */
+#define MAX_DELAY           (15U * 60U * MS_PER_SEC)
+
+/* Airtime per day, as in the fair-use policy of The Things Network */
+#define AIRTIME_BUDGET      (30U * MS_PER_SEC)
+
+/* Every few uplinks ask the network for the margin of the link */
+#define LINK_CHECK_INTERVAL (8U)
 
 /* Delay between transmission in milliseconds */
 /* [TASK 3: Find suitable value for transmission interval ] */
 #define TRANSMISSION_INTERVAL           (0U * MS_PER_SEC)
 
-/* Forward declaration of send function */
+/* The default EU868 channels (868.1, 868.3 and 868.5 MHz) share one sub-band
+ * with a duty cycle of 1 %. The MAC does not tell which channel it picked,
+ * so each uplink is debited from the sub-band of this frequency. That is
+ * exact only while all channels are in this sub-band. Channels the network
+ * adds in another 1 % sub-band, e.g. 867.1 to 867.9 MHz in the CFList of the
+ * join-accept, are then debited here too, which errs on the safe side. */
+#define TX_FREQUENCY        (868100000LU)
+
+/* Period between two samples in seconds */
+#define SAMPLE_PERIOD       (10U)
+
+/* Samples kept until they are sent, the oldest are dropped beyond */
+#define SAMPLES_MAX         (64U)
+
+/* Set to 1 to request an acknowledgement of each uplink from the network.
+ * The records of an uplink are only removed from the journal once it was
+ * acknowledged, otherwise once it was sent */
+#define CONFIRMED_UPLINKS   (0)
+
+/* Time to wait for the result of an uplink before it is considered lost */
+#define UPLINK_TIMEOUT      (30U * MS_PER_SEC)
+
+/* Priorities of the records: samples, and a press of the button which is sent
+ * before them */
+#define PRIO_SAMPLES        (0U)
+#define PRIO_BUTTON         (1U)
+
+/* Edges of the button within this time after a press are bounces, in ms */
+#define BUTTON_DEBOUNCE     (50U)
+
+/* Sectors of MTD_0 the journal spills records to, after the session */
+#define JOURNAL_SECTOR      (SESSION_SECTOR + SESSION_SECTORS)
+#define JOURNAL_SECTORS     (2U)
+
+#define MAIN_QUEUE_SIZE     (4U)
+
+/* Fields of a sample: the counter and, if the board has a temperature sensor,
+ * the temperature in 0.01 °C. Keep in sync with decode.py */
+static const sample_pack_field_t sample_fields[] = {
+    { .bits = 8, .is_signed = false },
+    { .bits = 16, .is_signed = true },
+};
+
+static const sample_pack_schema_t schema_counter = {
+    .id = 1, .fields = 1, .field = sample_fields,
+};
+
+static const sample_pack_schema_t schema_counter_temp = {
+    .id = 2, .fields = 2, .field = sample_fields,
+};
+
+/* Forward declaration of the event handlers */
 static void send(event_t *event);
+static void sample(event_t *event);
+static void confirm(event_t *event);
+static void lost(event_t *event);
 
 /* Event used to trigger the transmission */
 static event_t ev_tx = { .handler = send };
 
+/* Posts ev_tx once the next transmission is allowed */
+static event_timeout_t tx_timeout;
+
+/* Set by the main thread once the device joined, uplinks wait for it */
+static bool joined;
+
+/* Airtime spent in each sub-band */
+static lorawan_airtime_t airtime;
+static int tx_band;
+
+/* Picks data rate and size of each uplink from the margin of the link */
+static lorawan_policy_t policy;
+static uint8_t uplink_dr;
+static unsigned uplinks;
+static bool link_check;
+
+/* A press of the button is sent without waiting for a full uplink */
+static bool urgent;
+
+/* Event used to take a sample, posted periodically */
+static event_t ev_sample = { .handler = sample };
+static event_timeout_t sample_timeout;
+
+/* Presses of the button, the interrupt only records them */
+static irq_event_t button;
+
+/* Events used to report the result of an uplink, or its lack */
+static event_t ev_confirm = { .handler = confirm };
+static event_t ev_lost = { .handler = lost };
+static event_timeout_t lost_timeout;
+static volatile int uplink_status;
+
+/* Records waiting for an uplink, and the thread that receives the results */
+static uplink_journal_t journal;
+static kernel_pid_t main_pid;
+static msg_t main_msg_queue[MAIN_QUEUE_SIZE];
+
+/* Samples collected since they were last journaled */
+static sample_pack_t samples;
+static int16_t sample_values[SAMPLES_MAX * ARRAY_SIZE(sample_fields)];
+static saul_reg_t *temp_sensor;
+static int16_t temperature;
+
 /* LoRaWAN netif */
 static gnrc_netif_t *lorawan_netif;
 
@@ -67,25 +223,194 @@ char deveui_str[] = "AAAAAAAAAAAAAAAA";
 char appeui_str[] = "BBBBBBBBBBBBBBBB";
 char appkey_str[] = "CCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCC";
 
-/* Button callback */
-static void button_callback(void *arg)
+/* Returns a temperature in 0.01 °C */
+static int16_t centi_degrees(const phydat_t *data)
 {
-    (void) arg;    /* Not used */
-    puts("Button pressed");
-    counter++;
+    int32_t value = data->val[0];
+
+    for (int scale = data->scale; scale > -2; scale--) {
+        value *= 10;
+    }
+    for (int scale = data->scale; scale < -2; scale++) {
+        value /= 10;
+    }
+    return (int16_t)MAX(MIN(value, INT16_MAX), INT16_MIN);
+}
+
+/* Size of the records of samples, so that one fits into an uplink at any
+ * data rate */
+static size_t record_size(void)
+{
+    return MIN(CONFIG_UPLINK_JOURNAL_RECORD_MAX,
+               lorawan_airtime_max_payload(LORAWAN_DR_MIN) -
+               UPLINK_JOURNAL_FRAME);
+}
+
+/* Moves the collected samples to the journal, a record at a time. Unless
+ * @p all is set, samples that do not fill a record yet are kept, so that
+ * more are packed together */
+static void journal_samples(bool all)
+{
+    uint8_t buf[CONFIG_UPLINK_JOURNAL_RECORD_MAX];
+    size_t size = record_size();
+
+    while (samples.count &&
+           (all || sample_pack_fit(&samples, size) < samples.count)) {
+        size_t len = sample_pack_encode(&samples, buf, size);
+        if (!len) {
+            break;
+        }
+        if (uplink_journal_add(&journal, PRIO_SAMPLES, buf, len,
+                               ztimer_now(ZTIMER_MSEC)) == -ENOBUFS) {
+            puts("Journal full, dropped a record");
+        }
+    }
+}
+
+/* Journals the presses of the button since the last run */
+static void press(irq_event_t *ev, const irq_event_batch_t *batch, void *arg)
+{
+    (void) ev;
+    (void) arg;
+    int16_t values[1];
+    uint8_t buf[CONFIG_UPLINK_JOURNAL_RECORD_MAX];
+    sample_pack_t pack;
+
+    /* the counter is only changed here, in the event thread, a burst of
+     * presses costs one run */
+    printf("Button pressed %" PRIu32 " times, %" PRIu32 " bounces\n",
+           batch->count, batch->bounces);
+    counter += batch->count;
+    int16_t sample[] = { counter };
+
+    /* the counter is sent on its own, ahead of the samples */
+    sample_pack_init(&pack, &schema_counter, values, 1, 0);
+    sample_pack_add(&pack, sample);
+    size_t len = sample_pack_encode(&pack, buf, sizeof(buf));
+    int res = uplink_journal_add(&journal, PRIO_BUTTON, buf, len,
+                                 ztimer_now(ZTIMER_MSEC));
+    if (res == -ENOBUFS) {
+        puts("Journal full, dropped a record");
+    }
+    else if (res < 0) {
+        puts("Could not journal the presses");
+        return;
+    }
+    urgent = true;
+    event_post(EVENT_PRIO_MEDIUM, &ev_tx);
+}
+
+static void sample(event_t *event)
+{
+    (void) event;
+    phydat_t data;
+
+    /* a failed read repeats the last temperature */
+    if (temp_sensor && saul_reg_read(temp_sensor, &data) > 0) {
+        temperature = centi_degrees(&data);
+    }
+
+    int16_t values[] = { counter, temperature };
+    if (sample_pack_add(&samples, values) == -ENOBUFS) {
+        puts("Dropped the oldest sample");
+    }
+    journal_samples(false);
+
+    event_timeout_set(&sample_timeout, SAMPLE_PERIOD * MS_PER_SEC);
+}
+
+/* Schedules the next transmission at the earliest time allowed by the duty
+ * cycle, without blocking the event queue in the meantime */
+static void schedule(void)
+{
+    uint32_t wait = lorawan_airtime_wait(&airtime, tx_band,
+                                         ztimer_now(ZTIMER_MSEC));
+
+    if (wait < TRANSMISSION_INTERVAL) {
+        wait = TRANSMISSION_INTERVAL;
+    }
+    event_timeout_set(&tx_timeout, wait);
 }
 
 static void send(event_t *event)
 {
     (void) event;
     gnrc_pktsnip_t *pkt, *hdr;
+    uint32_t now = ztimer_now(ZTIMER_MSEC);
 
-    printf("Counter value is %i\n", counter);
+    /* a press before the join is sent once main posts ev_tx after it, the
+     * MAC would reject the frame */
+    if (!joined) {
+        return;
+    }
+
+    /* ev_tx may be posted while the sub-band is still off */
+    if (lorawan_airtime_wait(&airtime, tx_band, now)) {
+        schedule();
+        return;
+    }
+
+    /* the next uplink is built once the result of this one is known */
+    if (uplink_journal_inflight(&journal)) {
+        return;
+    }
+
+    /* the policy holds the data back until it fills an uplink or the oldest
+     * sample is overdue, and picks the data rate from the margin of the link */
+    uint32_t age;
+    size_t pending = uplink_journal_backlog(&journal, now, &age);
+    if (samples.count) {
+        pending += UPLINK_JOURNAL_FRAME +
+                   sample_pack_size(&samples, samples.count);
+        age = MAX(age, (samples.count - 1) * SAMPLE_PERIOD * MS_PER_SEC);
+    }
+    if (urgent) {
+        age = MAX_DELAY;
+    }
+    lorawan_policy_pick_t pick;
+    if (!lorawan_policy_pick(&policy, pending, age, now, &pick)) {
+        event_timeout_set(&tx_timeout,
+                          MIN(pick.wait, SAMPLE_PERIOD * MS_PER_SEC));
+        return;
+    }
+    urgent = false;
+
+    /* records that could not be sent before go out together with the new
+     * samples, as many as the policy allows */
+    journal_samples(true);
+    size_t max = pick.len;
 
     uint8_t port = CONFIG_LORAMAC_DEFAULT_TX_PORT; /* Default: 2 */
 
-    /* [TASK 3: Allocate a packet snip for the counter data] */
-    /* pkt = ... */
+    /* The records are copied right into the packet snip */
+    pkt = gnrc_pktbuf_add(NULL, NULL, max, GNRC_NETTYPE_UNDEF);
+    if (!pkt) {
+        puts("Packet buffer full");
+        event_timeout_set(&tx_timeout, SAMPLE_PERIOD * MS_PER_SEC);
+        return;
+    }
+    size_t len = uplink_journal_take(&journal, pkt->data, max, now);
+    if (!len) {
+        gnrc_pktbuf_release(pkt);
+        event_timeout_set(&tx_timeout, SAMPLE_PERIOD * MS_PER_SEC);
+        return;
+    }
+    gnrc_pktbuf_realloc_data(pkt, len);
+    printf("Counter value is %i, sending %u bytes, %u records pending\n",
+           counter, (unsigned)len, uplink_journal_pending(&journal));
+
+    /* the interface reports the result of the uplink to the main thread */
+    pkt->err_sub = main_pid;
+
+    uplink_dr = pick.dr;
+    gnrc_netapi_set(lorawan_netif->pid, NETOPT_LORAWAN_DR, 0, &uplink_dr,
+                    sizeof(uplink_dr));
+    link_check = (++uplinks % LINK_CHECK_INTERVAL) == 0;
+    if (link_check) {
+        netopt_enable_t en = NETOPT_ENABLE;
+        gnrc_netapi_set(lorawan_netif->pid, NETOPT_LINK_CHECK, 0, &en,
+                        sizeof(en));
+    }
 
     /* [TASK 3: Build GNRC Netif Header snip and prepend to packet] */
     /* hdr = gnrc_netif_hdr_build(...); */
@@ -94,11 +419,81 @@ static void send(event_t *event)
     /* [TASK 3: Send packet using GNRC NetAPI] */
 
     puts("Successfully sent packet");
+    event_timeout_set(&lost_timeout, UPLINK_TIMEOUT);
+
+    /* the sub-band is off for a multiple of the time-on-air, schedule the
+     * transmission event again for when it is free */
+    uint32_t toa = lorawan_airtime_toa(uplink_dr, len);
+    lorawan_airtime_debit(&airtime, tx_band, toa, now);
+    lorawan_policy_sent(&policy, toa, now);
+    printf("DR%u, time-on-air %" PRIu32 " ms, next transmission in %" PRIu32
+           " ms\n", uplink_dr, (uint32_t)(toa / US_PER_MS),
+           lorawan_airtime_wait(&airtime, tx_band, now));
+    /* the frame counter is only written to flash every few uplinks */
+    session_update(lorawan_netif);
+
+    /* the next transmission is scheduled with the result of this one */
+}
 
-    /* Wait for some time (to comply with duty cycle) and schedule transmission
-     * event again */
-    ztimer_sleep(ZTIMER_MSEC, TRANSMISSION_INTERVAL);
-    event_post(EVENT_PRIO_MEDIUM, &ev_tx);
+/* Passes the answer to a link check to the policy */
+static void link_margin(void)
+{
+    uint8_t gateways = 0;
+    uint8_t margin = 0;
+
+    gnrc_netapi_get(lorawan_netif->pid, NETOPT_NUM_GATEWAYS, 0, &gateways,
+                    sizeof(gateways));
+    gnrc_netapi_get(lorawan_netif->pid, NETOPT_DEMOD_MARGIN, 0, &margin,
+                    sizeof(margin));
+    if (gateways) {
+        printf("Link margin %u dB at DR%u\n", margin, uplink_dr);
+        lorawan_policy_link(&policy, uplink_dr, margin);
+    }
+}
+
+/* Only a confirmed uplink the network did not acknowledge tells about the
+ * link, local errors (not joined, MAC busy, frame too long) do not */
+static bool delivery_failed(int status)
+{
+    return CONFIRMED_UPLINKS && status == -ETIMEDOUT;
+}
+
+static void confirm(event_t *event)
+{
+    (void) event;
+
+    /* a late result of an uplink that was considered lost */
+    if (!uplink_journal_inflight(&journal)) {
+        return;
+    }
+    event_timeout_clear(&lost_timeout);
+
+    if (uplink_status == GNRC_NETERR_SUCCESS) {
+        uplink_journal_ack(&journal);
+        lorawan_policy_result(&policy, true);
+        if (link_check) {
+            link_margin();
+        }
+    }
+    else {
+        printf("Uplink failed (%d), sending its records again\n",
+               uplink_status);
+        uplink_journal_nack(&journal);
+        if (delivery_failed(uplink_status)) {
+            lorawan_policy_result(&policy, false);
+        }
+    }
+    schedule();
+}
+
+static void lost(event_t *event)
+{
+    (void) event;
+
+    puts("No result of the uplink, sending its records again");
+    uplink_journal_nack(&journal);
+    lorawan_policy_result(&policy, false);
+    schedule();
 }
 
 /* Join the network */
@@ -128,12 +523,20 @@ static void _activate(gnrc_netif_t *netif)
     netopt_enable_t en = NETOPT_ENABLE;
     /* [TASK 2: Enable OTAA activation] */
 
-    en = NETOPT_DISABLE;
-    /* [TASK 2: Disable confirmed transmissions] */
+    en = CONFIRMED_UPLINKS ? NETOPT_ENABLE : NETOPT_DISABLE;
+    /* [TASK 2: Enable or disable confirmed transmissions] */
 
     uint8_t dr = LORAWAN_DATARATE;
     /* [TASK 2: Set Datarate] */
 
+    /* A session stored before a reboot spares the join */
+    uint8_t deveui[LORAMAC_DEVEUI_LEN];
+    fmt_hex_bytes(deveui, deveui_str);
+    if (session_restore(netif, deveui)) {
+        return;
+    }
+
+    uint32_t backoff = JOIN_BACKOFF_MIN;
     while(true) {
         en = NETOPT_ENABLE;
         /* [TASK 2: Use GNRC NetAPI to set the NETOPT_LINK netopt] */
@@ -148,8 +551,15 @@ static void _activate(gnrc_netif_t *netif)
             puts("Device joined");
             break;
         }
-        puts("Join failed. Retry");
+
+        uint32_t wait = random_uint32_range(backoff / 2, backoff + 1);
+        printf("Join failed. Retry in %" PRIu32 " s\n",
+               (uint32_t)(wait / MS_PER_SEC));
+        ztimer_sleep(ZTIMER_MSEC, wait);
+        backoff = MIN(backoff * 2, JOIN_BACKOFF_MAX);
     }
+
+    session_save(netif, deveui);
 }
 
 gnrc_netif_t *get_lorawan_netif(void)
@@ -168,11 +578,40 @@ int main(void)
 {
     puts("LoRaWAN Sensor application");
 
-   /* Setup button callback */
-    if (gpio_init_int(BTN0_PIN, BTN0_MODE, GPIO_FALLING, button_callback, NULL) < 0) {
+    /* the results of the uplinks are sent to this thread */
+    msg_init_queue(main_msg_queue, MAIN_QUEUE_SIZE);
+    main_pid = thread_getpid();
+    uplink_journal_init(&journal);
+
+    session_init();
+#ifdef MTD_0
+    /* records that do not fit into RAM go to flash, next to the session.
+     * Those left there by the last run are sent first, so this comes before
+     * the first record is added. */
+    if (uplink_journal_spill(&journal, MTD_0, JOURNAL_SECTOR,
+                             JOURNAL_SECTORS, ztimer_now(ZTIMER_MSEC)) < 0) {
+        puts("Could not spill the journal to flash");
+    }
+    else if (uplink_journal_pending(&journal)) {
+        printf("Journal: %u records from the last run\n",
+               uplink_journal_pending(&journal));
+    }
+#endif
+
+    /* Setup button callback, it only records the press */
+    irq_event_init(&button, EVENT_PRIO_MEDIUM, ZTIMER_MSEC, BUTTON_DEBOUNCE,
+                   press, NULL);
+#ifdef BTN0_PIN
+    if (gpio_init_int(BTN0_PIN, BTN0_MODE, GPIO_FALLING, irq_event_isr, &button) < 0) {
         puts("[FAILED] init BTN0!");
         return 1;
     }
+#endif
+
+#if IS_USED(MODULE_NETDEV_LORA_SIM)
+    /* the simulated radio of native is not set up by auto_init */
+    netdev_lora_sim_auto_init();
+#endif
 
     /* Try to get a LoRaWAN interface */
     if(!(lorawan_netif = get_lorawan_netif())) {
@@ -180,9 +619,42 @@ int main(void)
         return 1;
     }
 
+    lorawan_airtime_init(&airtime, ztimer_now(ZTIMER_MSEC));
+    lorawan_policy_params_t params = {
+        .dr_min = LORAWAN_DR_MIN,
+        .dr_max = LORAWAN_DR_MAX,
+        .dr_start = LORAWAN_DATARATE,
+        .max_delay = MAX_DELAY,
+        .budget = AIRTIME_BUDGET,
+    };
+    lorawan_policy_init(&policy, &params, ztimer_now(ZTIMER_MSEC));
+    tx_band = lorawan_airtime_band(TX_FREQUENCY);
+    event_timeout_ztimer_init(&tx_timeout, ZTIMER_MSEC, EVENT_PRIO_MEDIUM,
+                              &ev_tx);
+
+    /* the counter is sampled with the temperature, if there is a sensor */
+    temp_sensor = saul_reg_find_type(SAUL_SENSE_TEMP);
+    sample_pack_init(&samples, temp_sensor ? &schema_counter_temp
+                                           : &schema_counter,
+                     sample_values, SAMPLES_MAX, SAMPLE_PERIOD);
+    event_timeout_ztimer_init(&sample_timeout, ZTIMER_MSEC, EVENT_PRIO_MEDIUM,
+                              &ev_sample);
+    event_post(EVENT_PRIO_MEDIUM, &ev_sample);
+
+    event_timeout_ztimer_init(&lost_timeout, ZTIMER_MSEC, EVENT_PRIO_MEDIUM,
+                              &ev_lost);
+
     _activate(lorawan_netif);
+    joined = true;
 
     event_post(EVENT_PRIO_MEDIUM, &ev_tx);
 
-    return 0;
+    while (1) {
+        msg_t msg;
+        msg_receive(&msg);
+        if (msg.type == GNRC_NETERR_MSG_TYPE) {
+            uplink_status = (int)msg.content.value;
+            event_post(EVENT_PRIO_MEDIUM, &ev_confirm);
+        }
+    }
 }
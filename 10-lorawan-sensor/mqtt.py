@@ -1,5 +1,10 @@
+import base64
+import json
+
 import paho.mqtt.client as mqtt
 
+from decode import samples
+
 # Condifugure as needed
 USERNAME="your-application-id@ttn"
 API_KEY="your-application-API-key"
@@ -22,6 +27,16 @@ def on_connect(client, userdata, flags, rc):
 def on_message(client, userdata, msg):
     print(msg.topic+" "+str(msg.payload))
 
+    # Uplinks carry records of samples packed by the application, see
+    # decode.py
+    try:
+        uplink = json.loads(msg.payload)["uplink_message"]
+        decoded = samples(base64.b64decode(uplink["frm_payload"]))
+    except (KeyError, ValueError):
+        return
+    for age, sample in decoded:
+        print(f"  -{age:5d} s", sample)
+
 client = mqtt.Client()
 client.on_connect = on_connect
 client.on_message = on_message
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @brief       Persistence of the LoRaWAN session of the sensor application
+ *
+ * The session is stored in the first sectors of MTD_0. On the `native` board
+ * this is a file.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lorawan_session.h"
+#include "mtd.h"
+#include "net/gnrc/netapi.h"
+#include "session.h"
+
+static lorawan_session_store_t _store;
+static bool _ready;
+
+/*
+ * GNRC LoRaWAN has no netopt for the frame counters and the RX1 delay, they
+ * are taken from the MAC directly. Its state belongs to the netif thread, so
+ * it is only accessed while holding the netif. A read right after an uplink
+ * was handed to the netif may still see the frame counter before it. That
+ * only delays the next reservation of uplink frame counters by one uplink,
+ * the restored session still continues after the reserved ones.
+ */
+static void _get_fcnt(gnrc_netif_t *netif, uint32_t *up, uint32_t *down)
+{
+    gnrc_netif_acquire(netif);
+    *up = netif->lorawan.mac.mcps.fcnt;
+    *down = netif->lorawan.mac.mcps.fcnt_down;
+    gnrc_netif_release(netif);
+}
+
+static void _set_fcnt(gnrc_netif_t *netif, uint32_t up, uint32_t down)
+{
+    gnrc_netif_acquire(netif);
+    netif->lorawan.mac.mcps.fcnt = up;
+    netif->lorawan.mac.mcps.fcnt_down = down;
+    gnrc_netif_release(netif);
+}
+
+/* The receive windows of the join-accept, an ABP activation leaves them at
+ * the defaults of the region */
+static void _get_rx(gnrc_netif_t *netif, uint8_t *rx1_delay,
+                    uint8_t *dl_settings)
+{
+    gnrc_netif_acquire(netif);
+    *rx1_delay = netif->lorawan.mac.rx_delay;
+    *dl_settings = netif->lorawan.mac.dl_settings;
+    gnrc_netif_release(netif);
+}
+
+static void _set_rx(gnrc_netif_t *netif, uint8_t rx1_delay,
+                    uint8_t dl_settings)
+{
+    gnrc_netif_acquire(netif);
+    netif->lorawan.mac.rx_delay = rx1_delay;
+    netif->lorawan.mac.dl_settings = dl_settings;
+    gnrc_netif_release(netif);
+}
+
+void session_init(void)
+{
+#ifdef MTD_0
+    if (mtd_init(MTD_0) < 0 ||
+        lorawan_session_init(&_store, MTD_0, SESSION_SECTOR,
+                             SESSION_SECTORS) < 0) {
+        puts("Could not open the session storage");
+        return;
+    }
+    _ready = true;
+#else
+    puts("No flash to store the session, joining at every start");
+#endif
+}
+
+bool session_restore(gnrc_netif_t *netif, const uint8_t *deveui)
+{
+    lorawan_session_t session;
+
+    if (!_ready || lorawan_session_load(&_store, &session) < 0) {
+        return false;
+    }
+    if (memcmp(session.deveui, deveui, sizeof(session.deveui))) {
+        puts("Stored session is of another DevEUI");
+        return false;
+    }
+
+    /* the session is activated by personalization (ABP) */
+    netopt_enable_t en = NETOPT_DISABLE;
+    gnrc_netapi_set(netif->pid, NETOPT_OTAA, 0, &en, sizeof(en));
+    gnrc_netapi_set(netif->pid, NETOPT_ADDRESS, 0, session.devaddr,
+                    sizeof(session.devaddr));
+    gnrc_netapi_set(netif->pid, NETOPT_LORAWAN_NWKSKEY, 0, session.nwkskey,
+                    sizeof(session.nwkskey));
+    gnrc_netapi_set(netif->pid, NETOPT_LORAWAN_APPSKEY, 0, session.appskey,
+                    sizeof(session.appskey));
+
+    en = NETOPT_ENABLE;
+    if (gnrc_netapi_set(netif->pid, NETOPT_LINK, 0, &en, sizeof(en)) < 0) {
+        puts("Could not activate the stored session");
+        return false;
+    }
+    _set_fcnt(netif, session.fcnt_up, session.fcnt_down);
+    _set_rx(netif, session.rx1_delay, session.dl_settings);
+
+    printf("Restored session, uplink frame counter %" PRIu32 ", RX1 delay %u "
+           "s\n", session.fcnt_up, session.rx1_delay);
+    return true;
+}
+
+void session_save(gnrc_netif_t *netif, const uint8_t *deveui)
+{
+    lorawan_session_t session = { 0 };
+
+    if (!_ready) {
+        return;
+    }
+
+    memcpy(session.deveui, deveui, sizeof(session.deveui));
+    if (gnrc_netapi_get(netif->pid, NETOPT_ADDRESS, 0, session.devaddr,
+                        sizeof(session.devaddr)) < 0 ||
+        gnrc_netapi_get(netif->pid, NETOPT_LORAWAN_NWKSKEY, 0,
+                        session.nwkskey, sizeof(session.nwkskey)) < 0 ||
+        gnrc_netapi_get(netif->pid, NETOPT_LORAWAN_APPSKEY, 0,
+                        session.appskey, sizeof(session.appskey)) < 0) {
+        puts("Could not read the session");
+        return;
+    }
+    _get_fcnt(netif, &session.fcnt_up, &session.fcnt_down);
+    _get_rx(netif, &session.rx1_delay, &session.dl_settings);
+
+    if (lorawan_session_save(&_store, &session) < 0) {
+        puts("Could not store the session");
+    }
+}
+
+void session_update(gnrc_netif_t *netif)
+{
+    uint32_t up, down;
+
+    if (!_ready) {
+        return;
+    }
+
+    _get_fcnt(netif, &up, &down);
+    if (lorawan_session_update(&_store, up, down) < 0) {
+        puts("Could not store the frame counters");
+    }
+}
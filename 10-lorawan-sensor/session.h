@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @brief       Persistence of the LoRaWAN session of the sensor application
+ */
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "net/gnrc/netif.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Sectors of MTD_0 used for the session
+ * @{
+ */
+#ifndef SESSION_SECTOR
+#define SESSION_SECTOR      (0U)
+#endif
+#ifndef SESSION_SECTORS
+#define SESSION_SECTORS     (2U)
+#endif
+/** @} */
+
+/**
+ * @brief   Opens the flash region of the session, if the board has one
+ */
+void session_init(void);
+
+/**
+ * @brief   Activates the stored session of a DevEUI by ABP, without a join
+ *
+ * @return  true if a session was restored
+ */
+bool session_restore(gnrc_netif_t *netif, const uint8_t *deveui);
+
+/**
+ * @brief   Stores the session of a DevEUI after a join
+ */
+void session_save(gnrc_netif_t *netif, const uint8_t *deveui);
+
+/**
+ * @brief   Stores the frame counters when the reserved values are used up,
+ *          call after each uplink
+ */
+void session_update(gnrc_netif_t *netif);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SESSION_H */
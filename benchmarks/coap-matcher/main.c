@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @brief       Benchmark of CoAP resource lookup strategies
+ *
+ * Compares the linear matching done by the default gcoap request matcher with
+ * the hash index of the coap_index module, for growing resource tables.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "coap_index.h"
+#include "kernel_defines.h"
+#include "random.h"
+#include "time_units.h"
+#include "ztimer.h"
+
+#define MAX_RESOURCES   (1000U)
+#define LOOKUPS         (20000U)
+
+static char _paths[MAX_RESOURCES][sizeof("/res/0000")];
+static coap_resource_t _resources[MAX_RESOURCES];
+static uint16_t _slots[COAP_INDEX_SLOTS(MAX_RESOURCES)];
+static uint16_t _queries[LOOKUPS];
+
+static const unsigned _sizes[] = { 2, 5, 10, 20, 50, 100, 200, 500, 1000 };
+
+/* prevents the compiler from dropping the lookups */
+static volatile uintptr_t _sink;
+
+/* same matching as the default gcoap request matcher */
+static const coap_resource_t *_linear_find(size_t len, const char *path,
+                                           coap_method_flags_t method_flag)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (coap_match_path(&_resources[i], (const uint8_t *)path) == 0 &&
+            (_resources[i].methods & method_flag)) {
+            return &_resources[i];
+        }
+    }
+    return NULL;
+}
+
+static uint32_t _bench_linear(size_t len)
+{
+    uint32_t start = ztimer_now(ZTIMER_USEC);
+
+    for (unsigned i = 0; i < LOOKUPS; i++) {
+        _sink = (uintptr_t)_linear_find(len, _paths[_queries[i]], COAP_GET);
+    }
+    return ztimer_now(ZTIMER_USEC) - start;
+}
+
+static uint32_t _bench_index(const coap_index_t *idx)
+{
+    uint32_t start = ztimer_now(ZTIMER_USEC);
+
+    for (unsigned i = 0; i < LOOKUPS; i++) {
+        const coap_resource_t *resource = NULL;
+        const char *path = _paths[_queries[i]];
+        coap_index_find(idx, path, sizeof(_paths[0]) - 1, COAP_GET, &resource);
+        _sink = (uintptr_t)resource;
+    }
+    return ztimer_now(ZTIMER_USEC) - start;
+}
+
+int main(void)
+{
+    puts("CoAP resource lookup benchmark");
+
+    /* paths are generated in ASCII order, as gcoap expects them */
+    for (unsigned i = 0; i < MAX_RESOURCES; i++) {
+        snprintf(_paths[i], sizeof(_paths[i]), "/res/%04u", i);
+        _resources[i].path = _paths[i];
+        _resources[i].methods = COAP_GET;
+    }
+
+    printf("%9s %14s %14s %8s\n", "resources", "linear ns/op", "index ns/op",
+           "speedup");
+
+    for (unsigned s = 0; s < ARRAY_SIZE(_sizes); s++) {
+        size_t len = _sizes[s];
+        coap_index_t idx;
+
+        if (coap_index_init(&idx, _resources, len, _slots,
+                            COAP_INDEX_SLOTS(len)) < 0) {
+            printf("could not index %u resources\n", (unsigned)len);
+            return 1;
+        }
+
+        /* same random sequence of existing paths for both strategies */
+        for (unsigned i = 0; i < LOOKUPS; i++) {
+            _queries[i] = random_uint32_range(0, len);
+        }
+
+        uint32_t linear = _bench_linear(len);
+        uint32_t index = _bench_index(&idx);
+
+        /* speedup with one decimal */
+        uint32_t speedup = index ? (10 * linear) / index : 0;
+
+        printf("%9u %14" PRIu32 " %14" PRIu32 " %5" PRIu32 ".%" PRIu32 "x\n",
+               (unsigned)len,
+               (uint32_t)((uint64_t)linear * NS_PER_US / LOOKUPS),
+               (uint32_t)((uint64_t)index * NS_PER_US / LOOKUPS),
+               speedup / 10, speedup % 10);
+    }
+
+    return 0;
+}
@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @brief       Benchmark of deadline misses of event queues
+ *
+ * Jobs of a mix of short, time-critical events and a long one, as in
+ * 10-lorawan-sensor, are released by timers and run on a FIFO event queue,
+ * on two event queues of fixed priority, or on an EDF queue. Each job has a
+ * deadline relative to its release, the benchmark counts the jobs that
+ * finished after it.
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "event.h"
+#include "event_edf.h"
+#include "irq.h"
+#include "kernel_defines.h"
+#include "random.h"
+#include "thread.h"
+#include "time_units.h"
+#include "ztimer.h"
+
+/* duration of each round, in ms */
+#define RUN_TIME        (5U * MS_PER_SEC)
+
+/* jobs of a class that can be pending at once, further ones are dropped */
+#define JOBS            (8U)
+
+/* priority of the queue threads, and of the high priority queue */
+#define QUEUE_PRIO      (THREAD_PRIORITY_MAIN - 1)
+#define HIGH_PRIO       (THREAD_PRIORITY_MAIN - 2)
+
+#define SEED            (1)
+
+typedef enum {
+    FIFO,           /**< all jobs on one event queue */
+    PRIO,           /**< time-critical jobs on a queue of higher priority */
+    EDF,            /**< all jobs on an EDF queue */
+} _strategy_t;
+
+static const char *_strategy_names[] = { "fifo", "prio", "edf" };
+
+typedef struct {
+    const char *name;
+    uint32_t period;    /**< time between releases, the mean if sporadic,
+                             in us */
+    bool sporadic;      /**< released at random times */
+    uint32_t cost;      /**< run time of the handler, in us, 0 for the long
+                             job of the round */
+    uint32_t deadline;  /**< relative to the release, in us */
+    bool high;          /**< on the high priority queue with PRIO */
+} _class_t;
+
+/* the mix of 10-lorawan-sensor: button presses, samples, downlinks and the
+ * uplink, whose run time grows from round to round */
+static const _class_t _classes[] = {
+    { "button", 50000, true, 200, 5000, true },
+    { "sample", 10000, false, 1000, 10000, true },
+    { "downlink", 500000, true, 2000, 50000, false },
+    { "send", 250000, false, 0, 250000, false },
+};
+
+#define CLASSES         ARRAY_SIZE(_classes)
+
+static_assert(CONFIG_EVENT_EDF_QUEUE_SIZE >= CLASSES * JOBS,
+              "the EDF queue must hold all jobs");
+
+/* run time of the long job in the rounds, in us */
+static const uint32_t _send_costs[] = { 5000, 20000, 50000 };
+
+typedef struct {
+    event_t event;              /**< for the FIFO queues */
+    event_edf_t edf;            /**< for the EDF queue */
+    const _class_t *cls;
+    uint32_t release;           /**< time of the release, in us */
+    volatile bool busy;         /**< released and not done yet */
+} _job_t;
+
+typedef struct {
+    uint32_t released;
+    uint32_t missed;            /**< done after the deadline or dropped */
+    uint32_t dropped;
+    uint32_t late_max;          /**< in us */
+} _class_stats_t;
+
+static _job_t _jobs[CLASSES][JOBS];
+static _class_stats_t _stats[CLASSES];
+static ztimer_t _timers[CLASSES];
+static uint32_t _send_cost;
+static _strategy_t _strategy;
+static volatile bool _running;
+
+static event_queue_t _queue;
+static event_queue_t _queue_high;
+static event_edf_queue_t _edf;
+
+static char _queue_stack[THREAD_STACKSIZE_DEFAULT];
+static char _high_stack[THREAD_STACKSIZE_DEFAULT];
+static char _edf_stack[THREAD_STACKSIZE_DEFAULT];
+
+static void _run(_job_t *job)
+{
+    unsigned idx = job->cls - _classes;
+    uint32_t cost = job->cls->cost ? job->cls->cost : _send_cost;
+    uint32_t start = ztimer_now(ZTIMER_USEC);
+
+    /* a busy handler, preemptible by higher priority threads */
+    while (ztimer_now(ZTIMER_USEC) - start < cost) {}
+
+    uint32_t took = ztimer_now(ZTIMER_USEC) - job->release;
+    if (took > job->cls->deadline) {
+        _stats[idx].missed++;
+        _stats[idx].late_max = MAX(_stats[idx].late_max,
+                                   took - job->cls->deadline);
+    }
+    job->busy = false;
+}
+
+static void _event_handler(event_t *event)
+{
+    _run(container_of(event, _job_t, event));
+}
+
+static void _edf_handler(event_edf_t *event)
+{
+    _run(container_of(event, _job_t, edf));
+}
+
+static void _release(const _class_t *cls)
+{
+    unsigned idx = cls - _classes;
+    _job_t *job = NULL;
+
+    for (unsigned i = 0; i < JOBS; i++) {
+        if (!_jobs[idx][i].busy) {
+            job = &_jobs[idx][i];
+            break;
+        }
+    }
+
+    _stats[idx].released++;
+    if (!job) {
+        _stats[idx].missed++;
+        _stats[idx].dropped++;
+        return;
+    }
+
+    job->busy = true;
+    job->release = ztimer_now(ZTIMER_USEC);
+    switch (_strategy) {
+    case FIFO:
+        event_post(&_queue, &job->event);
+        break;
+    case PRIO:
+        event_post(cls->high ? &_queue_high : &_queue, &job->event);
+        break;
+    case EDF:
+        if (event_edf_post(&_edf, &job->edf, cls->deadline) < 0) {
+            job->busy = false;
+            _stats[idx].missed++;
+            _stats[idx].dropped++;
+        }
+        break;
+    }
+}
+
+/* Releases the jobs of a class, runs in interrupt context */
+static void _timer_cb(void *arg)
+{
+    const _class_t *cls = arg;
+
+    if (!_running) {
+        return;
+    }
+    _release(cls);
+
+    uint32_t wait = cls->sporadic ? random_uint32_range(0, 2 * cls->period)
+                                  : cls->period;
+    ztimer_set(ZTIMER_USEC, &_timers[cls - _classes], wait);
+}
+
+static void *_queue_thread(void *arg)
+{
+    event_queue_t *queue = arg;
+
+    event_queue_init(queue);
+    event_loop(queue);
+    return NULL;
+}
+
+static void *_edf_thread(void *arg)
+{
+    (void)arg;
+    event_edf_loop(&_edf);
+}
+
+static void _round(_strategy_t strategy, uint32_t send_cost)
+{
+    memset(_stats, 0, sizeof(_stats));
+    _strategy = strategy;
+    _send_cost = send_cost;
+    random_init(SEED);
+
+    _running = true;
+    for (unsigned i = 0; i < CLASSES; i++) {
+        ztimer_set(ZTIMER_USEC, &_timers[i], _classes[i].period / 2);
+    }
+    ztimer_sleep(ZTIMER_MSEC, RUN_TIME);
+    _running = false;
+    for (unsigned i = 0; i < CLASSES; i++) {
+        ztimer_remove(ZTIMER_USEC, &_timers[i]);
+    }
+
+    /* let the queues run the jobs already released */
+    ztimer_sleep(ZTIMER_MSEC, 500);
+
+    uint32_t late_max = 0;
+    printf("%7" PRIu32 " %-5s", (uint32_t)(send_cost / US_PER_MS),
+           _strategy_names[strategy]);
+    for (unsigned i = 0; i < CLASSES; i++) {
+        uint32_t permille = _stats[i].missed * 1000 /
+                            MAX(_stats[i].released, 1);
+        printf(" %5" PRIu32 ".%" PRIu32 "%%", permille / 10, permille % 10);
+        late_max = MAX(late_max, _stats[i].late_max);
+    }
+    uint32_t dropped = 0;
+    for (unsigned i = 0; i < CLASSES; i++) {
+        dropped += _stats[i].dropped;
+    }
+    printf(" %8" PRIu32 " %11" PRIu32 "\n", dropped,
+           (uint32_t)(late_max / US_PER_MS));
+}
+
+int main(void)
+{
+    puts("Event queue deadline benchmark");
+    printf("%" PRIu32 " ms per round\n", (uint32_t)RUN_TIME);
+    for (unsigned i = 0; i < CLASSES; i++) {
+        const _class_t *cls = &_classes[i];
+        printf("%-8s every %6" PRIu32 " us%s, runs %6" PRIu32 " us, "
+               "deadline %6" PRIu32 " us\n", cls->name, cls->period,
+               cls->sporadic ? " on average" : "", cls->cost, cls->deadline);
+    }
+
+    for (unsigned i = 0; i < CLASSES; i++) {
+        for (unsigned j = 0; j < JOBS; j++) {
+            _jobs[i][j] = (_job_t){
+                .event = { .handler = _event_handler },
+                .edf = { .handler = _edf_handler, .name = _classes[i].name },
+                .cls = &_classes[i],
+            };
+        }
+        _timers[i] = (ztimer_t){
+            .callback = _timer_cb, .arg = (void *)&_classes[i],
+        };
+    }
+
+    event_edf_queue_init(&_edf, ZTIMER_USEC, "bench");
+    thread_create(_queue_stack, sizeof(_queue_stack), QUEUE_PRIO,
+                  THREAD_CREATE_STACKTEST, _queue_thread, &_queue, "queue");
+    thread_create(_high_stack, sizeof(_high_stack), HIGH_PRIO,
+                  THREAD_CREATE_STACKTEST, _queue_thread, &_queue_high,
+                  "queue_high");
+    thread_create(_edf_stack, sizeof(_edf_stack), QUEUE_PRIO,
+                  THREAD_CREATE_STACKTEST, _edf_thread, NULL, "edf");
+
+    printf("\n%7s %-5s", "send ms", "queue");
+    for (unsigned i = 0; i < CLASSES; i++) {
+        printf(" %8s", _classes[i].name);
+    }
+    printf(" %8s %11s\n", "dropped", "late max ms");
+
+    for (unsigned c = 0; c < ARRAY_SIZE(_send_costs); c++) {
+        for (unsigned s = 0; s < ARRAY_SIZE(_strategy_names); s++) {
+            _round(s, _send_costs[c]);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,366 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @brief       Benchmark of the paths from an interrupt to a thread
+ *
+ * A timer interrupt fires at rising rates and hands each interrupt to a
+ * handler thread by one of the mechanisms of 07-events. The handler measures
+ * the time from the interrupt to its run, and counts interrupts that were
+ * coalesced into one run or lost.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "event.h"
+#include "event/thread.h"
+#include "irq.h"
+#include "irq_event.h"
+#include "kernel_defines.h"
+#include "msg.h"
+#include "mutex.h"
+#include "thread.h"
+#include "thread_flags.h"
+#include "time_units.h"
+#include "ztimer.h"
+
+/* duration of each round, in ms */
+#define RUN_TIME        (1U * MS_PER_SEC)
+
+/* time the handler works on each run, in us */
+#ifndef HANDLER_COST
+#define HANDLER_COST    (10U)
+#endif
+
+/* all handler threads run at the priority of the highest event thread */
+#ifdef CONFIG_EVENT_THREAD_HIGHEST_PRIO
+#define HANDLER_PRIO    (CONFIG_EVENT_THREAD_HIGHEST_PRIO)
+#else
+#define HANDLER_PRIO    (EVENT_THREAD_HIGHEST_PRIO)
+#endif
+
+/* messages the handler thread can queue */
+#define MSG_QUEUE_SIZE  (16U)
+
+/* latencies up to this many us are counted in a histogram of 1 us buckets */
+#define HIST_SIZE       (1024U)
+
+#define FLAG_IRQ        (1U << 0)
+
+/* interrupt rates of the rounds, in Hz */
+static const uint32_t _rates[] = { 1000, 2000, 5000, 10000, 20000, 50000 };
+
+typedef struct {
+    const char *name;
+    void (*fire)(uint32_t now);     /**< hands an interrupt on, in the ISR */
+} _path_t;
+
+typedef struct {
+    uint32_t fired;                 /**< interrupts */
+    uint32_t runs;                  /**< runs of the handler */
+    uint32_t coalesced;             /**< interrupts merged into another run */
+    uint32_t lost;                  /**< interrupts that could not be handed
+                                         on */
+    uint32_t max;                   /**< largest latency, in us */
+    uint64_t sum;                   /**< sum of the latencies, in us */
+    uint32_t hist[HIST_SIZE + 1];   /**< latencies, the last bucket holds the
+                                         larger ones */
+} _stats_t;
+
+static _stats_t _stats;
+
+/* interrupts not seen by the handler yet and the time of the first of them,
+ * for the paths that coalesce */
+static volatile uint32_t _pending;
+static volatile uint32_t _first;
+
+static ztimer_t _timer;
+static uint32_t _period;
+static uint32_t _next;
+static volatile bool _running;
+static const _path_t *_path;
+
+static char _queue_stack[THREAD_STACKSIZE_DEFAULT];
+static char _msg_stack[THREAD_STACKSIZE_DEFAULT];
+static char _flags_stack[THREAD_STACKSIZE_DEFAULT];
+static char _mutex_stack[THREAD_STACKSIZE_DEFAULT];
+
+static event_queue_t _queue;
+static kernel_pid_t _msg_pid;
+static thread_t *_flags_thread;
+static mutex_t _mutex = MUTEX_INIT_LOCKED;
+
+static void _work(void)
+{
+    uint32_t start = ztimer_now(ZTIMER_USEC);
+
+    while (ztimer_now(ZTIMER_USEC) - start < HANDLER_COST) {}
+}
+
+static void _record(uint32_t latency, uint32_t count)
+{
+    _stats.runs++;
+    _stats.coalesced += count - 1;
+    _stats.max = MAX(_stats.max, latency);
+    _stats.sum += latency;
+    _stats.hist[MIN(latency, HIST_SIZE)]++;
+}
+
+/* Handles the interrupts pending on a coalescing path, the latency is that
+ * of the first one */
+static void _handle_pending(void)
+{
+    uint32_t now = ztimer_now(ZTIMER_USEC);
+
+    unsigned state = irq_disable();
+    uint32_t count = _pending;
+    uint32_t first = _first;
+    _pending = 0;
+    irq_restore(state);
+
+    /* a post that raced with the previous run */
+    if (!count) {
+        return;
+    }
+    _record(now - first, count);
+    _work();
+}
+
+static void _mark_pending(uint32_t now)
+{
+    if (!_pending++) {
+        _first = now;
+    }
+}
+
+/* event_post to the highest event thread, and to a queue of our own */
+static void _event_handler(event_t *event)
+{
+    (void)event;
+    _handle_pending();
+}
+
+static event_t _event_highest = { .handler = _event_handler };
+static event_t _event_own = { .handler = _event_handler };
+
+static void _fire_highest(uint32_t now)
+{
+    _mark_pending(now);
+    event_post(EVENT_PRIO_HIGHEST, &_event_highest);
+}
+
+static void _fire_queue(uint32_t now)
+{
+    _mark_pending(now);
+    event_post(&_queue, &_event_own);
+}
+
+static void *_queue_thread(void *arg)
+{
+    (void)arg;
+    event_queue_init(&_queue);
+    event_loop(&_queue);
+    return NULL;
+}
+
+/* msg_send_int, each message carries the time of its interrupt */
+static void _fire_msg(uint32_t now)
+{
+    msg_t msg = { .content.value = now };
+
+    if (msg_send_int(&msg, _msg_pid) != 1) {
+        _stats.lost++;
+    }
+}
+
+static void *_msg_thread(void *arg)
+{
+    (void)arg;
+    msg_t queue[MSG_QUEUE_SIZE];
+    msg_t msg;
+
+    msg_init_queue(queue, MSG_QUEUE_SIZE);
+    while (1) {
+        msg_receive(&msg);
+        _record(ztimer_now(ZTIMER_USEC) - msg.content.value, 1);
+        _work();
+    }
+    return NULL;
+}
+
+/* thread_flags_set */
+static void _fire_flags(uint32_t now)
+{
+    _mark_pending(now);
+    thread_flags_set(_flags_thread, FLAG_IRQ);
+}
+
+static void *_flags_thread_fn(void *arg)
+{
+    (void)arg;
+    while (1) {
+        thread_flags_wait_any(FLAG_IRQ);
+        _handle_pending();
+    }
+    return NULL;
+}
+
+/* mutex_unlock of a mutex the handler waits for */
+static void _fire_mutex(uint32_t now)
+{
+    _mark_pending(now);
+    mutex_unlock(&_mutex);
+}
+
+static void *_mutex_thread(void *arg)
+{
+    (void)arg;
+    while (1) {
+        mutex_lock(&_mutex);
+        _handle_pending();
+    }
+    return NULL;
+}
+
+/* irq_event, the handler runs on the highest event thread */
+static irq_event_t _irq_event;
+
+static void _batch_handler(irq_event_t *ev, const irq_event_batch_t *batch,
+                           void *arg)
+{
+    (void)ev;
+    (void)arg;
+    _record(ztimer_now(ZTIMER_USEC) - batch->time[0], batch->count);
+    _work();
+}
+
+static void _fire_irq_event(uint32_t now)
+{
+    (void)now;
+    irq_event_isr(&_irq_event);
+}
+
+static const _path_t _paths[] = {
+    { "event_post HIGHEST", _fire_highest },
+    { "event queue thread", _fire_queue },
+    { "msg_send_int", _fire_msg },
+    { "thread_flags_set", _fire_flags },
+    { "mutex_unlock", _fire_mutex },
+    { "irq_event", _fire_irq_event },
+};
+
+/* The interrupt source, runs in interrupt context */
+static void _timer_cb(void *arg)
+{
+    (void)arg;
+    uint32_t now = ztimer_now(ZTIMER_USEC);
+
+    if (!_running) {
+        return;
+    }
+    _stats.fired++;
+    _path->fire(now);
+
+    /* keep the rate, fire at once if the timer fell behind */
+    _next += _period;
+    int32_t wait = (int32_t)(_next - now);
+    if (wait <= 0) {
+        _next = now;
+        wait = 0;
+    }
+    ztimer_set(ZTIMER_USEC, &_timer, wait);
+}
+
+/* Returns the latency below which a share of the runs were, in per mille */
+static uint32_t _percentile(unsigned permille)
+{
+    uint32_t target = ((uint64_t)_stats.runs * permille + 999) / 1000;
+    uint32_t count = 0;
+
+    for (unsigned i = 0; i <= HIST_SIZE; i++) {
+        count += _stats.hist[i];
+        if (count >= target) {
+            return (i < HIST_SIZE) ? i : _stats.max;
+        }
+    }
+    return _stats.max;
+}
+
+static uint32_t _round(const _path_t *path, uint32_t rate)
+{
+    memset(&_stats, 0, sizeof(_stats));
+    _pending = 0;
+    _path = path;
+    _period = US_PER_SEC / rate;
+
+    uint32_t start = ztimer_now(ZTIMER_USEC);
+    _next = start;
+    _running = true;
+    ztimer_set(ZTIMER_USEC, &_timer, _period);
+    ztimer_sleep(ZTIMER_MSEC, RUN_TIME);
+    _running = false;
+    ztimer_remove(ZTIMER_USEC, &_timer);
+    uint32_t elapsed = ztimer_now(ZTIMER_USEC) - start;
+
+    /* let the handler drain what was handed on */
+    ztimer_sleep(ZTIMER_MSEC, 100);
+
+    uint32_t fired_rate = (uint64_t)_stats.fired * US_PER_SEC / elapsed;
+    uint32_t run_rate = (uint64_t)_stats.runs * US_PER_SEC / elapsed;
+    printf("%-18s %7" PRIu32 " %7" PRIu32 " %7" PRIu32 " %9" PRIu32
+           " %9" PRIu32 " %7" PRIu32 " %7" PRIu32 " %7" PRIu32 " %7" PRIu32
+           "\n",
+           path->name, rate, fired_rate, run_rate, _stats.coalesced,
+           _stats.lost, (uint32_t)(_stats.sum / MAX(_stats.runs, 1)),
+           _percentile(500), _percentile(990), _stats.max);
+    return run_rate;
+}
+
+int main(void)
+{
+    puts("IRQ dispatch benchmark");
+    printf("%" PRIu32 " ms per round, %u us of work per handler run\n",
+           (uint32_t)RUN_TIME, HANDLER_COST);
+
+    thread_create(_queue_stack, sizeof(_queue_stack), HANDLER_PRIO,
+                  THREAD_CREATE_STACKTEST, _queue_thread, NULL, "queue");
+    _msg_pid = thread_create(_msg_stack, sizeof(_msg_stack), HANDLER_PRIO,
+                             THREAD_CREATE_STACKTEST, _msg_thread, NULL,
+                             "msg");
+    kernel_pid_t pid = thread_create(_flags_stack, sizeof(_flags_stack),
+                                     HANDLER_PRIO, THREAD_CREATE_STACKTEST,
+                                     _flags_thread_fn, NULL, "flags");
+    _flags_thread = thread_get(pid);
+    thread_create(_mutex_stack, sizeof(_mutex_stack), HANDLER_PRIO,
+                  THREAD_CREATE_STACKTEST, _mutex_thread, NULL, "mutex");
+
+    irq_event_init(&_irq_event, EVENT_PRIO_HIGHEST, ZTIMER_USEC, 0,
+                   _batch_handler, NULL);
+    _timer.callback = _timer_cb;
+
+    printf("%-18s %7s %7s %7s %9s %9s %7s %7s %7s %7s\n", "path", "rate",
+           "irq/s", "runs/s", "coalesced", "lost", "mean us", "p50 us",
+           "p99 us", "max us");
+
+    uint32_t ceiling[ARRAY_SIZE(_paths)] = { 0 };
+    for (unsigned p = 0; p < ARRAY_SIZE(_paths); p++) {
+        for (unsigned r = 0; r < ARRAY_SIZE(_rates); r++) {
+            ceiling[p] = MAX(ceiling[p], _round(&_paths[p], _rates[r]));
+        }
+    }
+
+    puts("\nmost handler runs per second");
+    for (unsigned p = 0; p < ARRAY_SIZE(_paths); p++) {
+        printf("%-18s %7" PRIu32 "\n", _paths[p].name, ceiling[p]);
+    }
+
+    return 0;
+}
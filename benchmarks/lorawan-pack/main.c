@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @brief       Benchmark of batched, bit-packed LoRaWAN payloads
+ *
+ * Sends a synthetic trace of counter and temperature samples at each EU868
+ * data rate, once with one raw sample per uplink and once packed into batches
+ * that fill the largest payload of the data rate, and reports how many
+ * samples each byte and each second of airtime carry.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "kernel_defines.h"
+#include "lorawan_airtime.h"
+#include "random.h"
+#include "sample_pack.h"
+
+#define SAMPLES         (2000U)
+
+/* DR6 and DR7 are only available on some channels */
+#define DRS             (6U)
+
+/* a raw sample: the counter byte and the temperature as int16 */
+#define RAW_SIZE        (3U)
+
+static const sample_pack_field_t _fields[] = {
+    { .bits = 8, .is_signed = false },
+    { .bits = 16, .is_signed = true },
+};
+
+static const sample_pack_schema_t _schema = {
+    .id = 2,
+    .fields = ARRAY_SIZE(_fields),
+    .field = _fields,
+};
+
+static const sample_pack_schema_t *const _schemas[] = { &_schema };
+
+static int16_t _trace[SAMPLES][ARRAY_SIZE(_fields)];
+static int16_t _values[SAMPLES * ARRAY_SIZE(_fields)];
+static int16_t _decoded[SAMPLES * ARRAY_SIZE(_fields)];
+static uint8_t _payload[UINT8_MAX];
+
+/* a counter of button presses and a room temperature in 0.01 °C */
+static void _generate(void)
+{
+    int16_t counter = 0;
+    int16_t temp = 2150;
+
+    random_init(1);
+    for (unsigned i = 0; i < SAMPLES; i++) {
+        if (random_uint32_range(0, 10) == 0) {
+            counter = (counter + 1) & 0xff;
+        }
+        temp += (int16_t)random_uint32_range(0, 5) - 2;
+        _trace[i][0] = counter;
+        _trace[i][1] = temp;
+    }
+}
+
+static void _run(uint8_t dr)
+{
+    size_t max = lorawan_airtime_max_payload(dr);
+    sample_pack_t pack;
+    unsigned uplinks = 0;
+    unsigned errors = 0;
+    unsigned done = 0;
+    uint64_t bytes = 0;
+    uint64_t toa = 0;
+
+    sample_pack_init(&pack, &_schema, _values, SAMPLES, 60);
+    for (unsigned i = 0; i < SAMPLES; i++) {
+        sample_pack_add(&pack, _trace[i]);
+    }
+
+    size_t len;
+    while ((len = sample_pack_encode(&pack, _payload, max)) > 0) {
+        sample_pack_info_t info;
+        int count = sample_pack_decode(_payload, len, _schemas,
+                                       ARRAY_SIZE(_schemas), &info, _decoded,
+                                       ARRAY_SIZE(_decoded));
+        if (count <= 0 || memcmp(_decoded, _trace[done],
+                                 count * sizeof(_trace[0]))) {
+            errors++;
+        }
+        done += MAX(count, 0);
+        uplinks++;
+        bytes += len + LORAWAN_AIRTIME_OVERHEAD;
+        toa += lorawan_airtime_toa(dr, len);
+    }
+
+    /* one uplink per raw sample */
+    uint64_t raw_toa = (uint64_t)SAMPLES * lorawan_airtime_toa(dr, RAW_SIZE);
+    uint64_t raw_bytes = (uint64_t)SAMPLES * (RAW_SIZE + LORAWAN_AIRTIME_OVERHEAD);
+
+    /* samples per byte on air and per second of airtime, in hundredths */
+    uint32_t raw_b = SAMPLES * 100 / raw_bytes;
+    uint32_t pack_b = SAMPLES * 100 / MAX(bytes, 1);
+    uint32_t raw_s = SAMPLES * 100000000ULL / MAX(raw_toa, 1);
+    uint32_t pack_s = SAMPLES * 100000000ULL / MAX(toa, 1);
+
+    printf("DR%u %4u %7u %4" PRIu32 ".%02" PRIu32 " %4" PRIu32 ".%02" PRIu32
+           " %6" PRIu32 ".%02" PRIu32 " %6" PRIu32 ".%02" PRIu32 " %8" PRIu32
+           " %6u\n", dr, (unsigned)max, SAMPLES / MAX(uplinks, 1),
+           raw_b / 100, raw_b % 100, pack_b / 100, pack_b % 100,
+           raw_s / 100, raw_s % 100, pack_s / 100, pack_s % 100,
+           (uint32_t)(toa / 1000), errors + (done != SAMPLES));
+}
+
+int main(void)
+{
+    puts("LoRaWAN payload packing benchmark");
+    printf("%u samples of counter and temperature, %u raw bytes each\n",
+           SAMPLES, RAW_SIZE);
+
+    _generate();
+
+    printf("%3s %4s %7s %7s %7s %9s %9s %8s %6s\n", "", "max", "smpl/up",
+           "raw/B", "pack/B", "raw/s", "pack/s", "toa ms", "errors");
+    for (uint8_t dr = 0; dr < DRS; dr++) {
+        _run(dr);
+    }
+
+    return 0;
+}
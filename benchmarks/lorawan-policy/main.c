@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @brief       Benchmark of the LoRaWAN data rate and batch policy
+ *
+ * Simulates a day of a node that produces a few bytes every minute and sends
+ * them over links of different quality, with a fixed data rate and with the
+ * data rate picked by the policy, and reports the airtime spent per delivered
+ * byte.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "kernel_defines.h"
+#include "lorawan_airtime.h"
+#include "lorawan_policy.h"
+#include "random.h"
+
+#define DAY             (24UL * 60UL * 60UL * 1000UL)
+#define PERIOD          (60UL * 1000UL)     /* ms between two samples */
+#define SAMPLE_SIZE     (3U)                /* bytes of a sample */
+#define MAX_DELAY       (15UL * 60UL * 1000UL)
+
+/* off-time per time-on-air of the default EU868 sub-band */
+#define DUTY_DIVISOR    (100U)
+
+/* delivered uplinks between two reports of the margin, as if every few
+ * uplinks carried a LinkCheckReq */
+#define LINK_CHECK      (8U)
+
+/* a link: mean SNR and how far it drifts, in 0.1 dB */
+static const struct {
+    const char *name;
+    int16_t snr;
+    int16_t drift;
+} _links[] = {
+    { "near", 50, 20 },
+    { "medium", -90, 30 },
+    { "far", -170, 20 },
+    { "fading", -110, 80 },
+};
+
+/* the strategies: a fixed data rate or the policy over DR0 to DR5, with and
+ * without a daily airtime budget of 30 s as in the fair-use policy of TTN */
+static const struct {
+    const char *name;
+    uint8_t dr_min;
+    uint8_t dr_max;
+    uint32_t budget;
+} _strategies[] = {
+    { "DR5", 5, 5, 0 },
+    { "DR0", 0, 0, 0 },
+    { "policy", 0, 5, 0 },
+    { "budget", 0, 5, 30000 },
+};
+
+static void _run(unsigned link, unsigned strategy)
+{
+    lorawan_policy_params_t params = {
+        .dr_min = _strategies[strategy].dr_min,
+        .dr_max = _strategies[strategy].dr_max,
+        .dr_start = _strategies[strategy].dr_max,
+        .max_delay = MAX_DELAY,
+        .budget = _strategies[strategy].budget,
+    };
+    lorawan_policy_t policy;
+    int snr = _links[link].snr;
+    uint32_t ready = 0;
+    uint32_t produced = 0;
+    uint32_t delivered = 0;
+    uint32_t uplinks = 0;
+    uint32_t lost = 0;
+    uint32_t checks = 0;
+    uint64_t toa = 0;
+    size_t pending = 0;
+
+    /* every strategy sees the same link */
+    random_init(link + 1);
+    lorawan_policy_init(&policy, &params, 0);
+
+    for (uint32_t now = PERIOD; now < DAY; now += PERIOD) {
+        pending += SAMPLE_SIZE;
+        produced += SAMPLE_SIZE;
+
+        /* the SNR drifts around the mean of the link */
+        snr += (int)random_uint32_range(0, 11) - 5;
+        snr = MAX(MIN(snr, _links[link].snr + _links[link].drift),
+                  _links[link].snr - _links[link].drift);
+
+        lorawan_policy_pick_t pick;
+        uint32_t age = (pending / SAMPLE_SIZE - 1) * PERIOD;
+        if (now < ready ||
+            !lorawan_policy_pick(&policy, pending, age, now, &pick)) {
+            continue;
+        }
+
+        /* fast fading of +-3 dB on each uplink */
+        int rx = snr + (int)random_uint32_range(0, 61) - 30;
+        bool ok = rx >= lorawan_policy_floor(pick.dr);
+
+        uplinks++;
+        toa += pick.toa;
+        ready = now + DIV_ROUND_UP(pick.toa, 1000) * DUTY_DIVISOR;
+        lorawan_policy_sent(&policy, pick.toa, now);
+        lorawan_policy_result(&policy, ok);
+        if (!ok) {
+            lost++;
+            continue;
+        }
+        pending -= pick.len;
+        delivered += pick.len;
+        if (++checks % LINK_CHECK == 0) {
+            lorawan_policy_link(&policy, pick.dr,
+                                (rx - lorawan_policy_floor(pick.dr)) / 10);
+        }
+    }
+
+    printf("%-7s %-7s %5" PRIu32 ".%" PRIu32 " %7" PRIu32 " %5" PRIu32
+           " %9" PRIu32, _links[link].name, _strategies[strategy].name,
+           delivered * 100 / produced, delivered * 1000 / produced % 10,
+           uplinks, lost, (uint32_t)(toa / 1000));
+    if (delivered) {
+        printf(" %8" PRIu32 "\n", (uint32_t)(toa / delivered));
+    }
+    else {
+        printf(" %8s\n", "-");
+    }
+}
+
+int main(void)
+{
+    puts("LoRaWAN data rate and batch policy benchmark");
+    printf("a day of %u bytes per minute, at most %lu min of delay\n",
+           SAMPLE_SIZE, MAX_DELAY / 60000);
+
+    printf("%-7s %-7s %7s %7s %5s %9s %8s\n", "link", "rate", "deliv%",
+           "uplinks", "lost", "toa ms", "us/B");
+    for (unsigned link = 0; link < ARRAY_SIZE(_links); link++) {
+        for (unsigned s = 0; s < ARRAY_SIZE(_strategies); s++) {
+            _run(link, s);
+        }
+    }
+
+    return 0;
+}
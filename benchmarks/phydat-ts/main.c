@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @brief       Benchmark of the phydat time series store
+ *
+ * Stores synthetic sensor traces and reports how much smaller they get than
+ * raw samples, and how fast samples are appended and read back. The traces
+ * stand in for recorded ones, of which the repository keeps none.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "kernel_defines.h"
+#include "phydat_ts.h"
+#include "random.h"
+#include "time_units.h"
+#include "ztimer.h"
+
+#define SAMPLES         (2000U)
+
+/* enough blocks to keep every trace in RAM */
+#define BLOCKS          (64U)
+
+/* times each trace is encoded and decoded for the throughput */
+#define ROUNDS          (20U)
+
+/* interval between two samples, in ms */
+#define PERIOD          (1000U)
+
+/* size of a raw sample: a time stamp and a phydat_t */
+#define RAW_SIZE        (sizeof(uint32_t) + sizeof(phydat_t))
+
+typedef void (*_trace_gen_t)(unsigned i, phydat_t *data);
+
+typedef struct {
+    const char *name;
+    _trace_gen_t gen;
+    uint8_t dims;
+    bool jitter;            /**< time stamps deviate from the period */
+} _trace_t;
+
+static phydat_ts_block_t _blocks[BLOCKS];
+static phydat_ts_t _ts;
+
+static uint32_t _times[SAMPLES];
+static phydat_t _data[SAMPLES];
+
+static int16_t _rand_step(int16_t max)
+{
+    return (int16_t)random_uint32_range(0, 2 * max + 1) - max;
+}
+
+/* room temperature in 0.01 °C, drifting slowly */
+static void _gen_temp(unsigned i, phydat_t *data)
+{
+    static int16_t temp;
+
+    if (i == 0) {
+        temp = 2150;
+    }
+    temp += _rand_step(2);
+    *data = (phydat_t){ .val = { temp }, .unit = UNIT_TEMP_C, .scale = -2 };
+}
+
+/* acceleration of a device at rest in mg, with sensor noise */
+static void _gen_accel(unsigned i, phydat_t *data)
+{
+    (void)i;
+    *data = (phydat_t){
+        .val = { _rand_step(20), 15 + _rand_step(20), 1000 + _rand_step(20) },
+        .unit = UNIT_G_FORCE,
+        .scale = -3,
+    };
+}
+
+/* relative humidity in %, changing in steps now and then */
+static void _gen_humidity(unsigned i, phydat_t *data)
+{
+    static int16_t hum;
+
+    if (i == 0) {
+        hum = 45;
+    }
+    if (random_uint32_range(0, 50) == 0) {
+        hum += _rand_step(3);
+    }
+    *data = (phydat_t){ .val = { hum }, .unit = UNIT_PERCENT, .scale = 0 };
+}
+
+static const _trace_t _traces[] = {
+    { "temperature", _gen_temp, 1, false },
+    { "temp jitter", _gen_temp, 1, true },
+    { "acceleration", _gen_accel, 3, false },
+    { "humidity", _gen_humidity, 1, false },
+};
+
+static void _generate(const _trace_t *trace)
+{
+    uint32_t time = 0;
+
+    random_init(1);
+    for (unsigned i = 0; i < SAMPLES; i++) {
+        /* a sampler that is late by a few ms now and then */
+        time += PERIOD;
+        _times[i] = time + (trace->jitter ? random_uint32_range(0, 5) : 0);
+        trace->gen(i, &_data[i]);
+    }
+}
+
+static void _encode(const _trace_t *trace)
+{
+    phydat_ts_init(&_ts, _blocks, ARRAY_SIZE(_blocks));
+    for (unsigned i = 0; i < SAMPLES; i++) {
+        phydat_ts_append(&_ts, _times[i], &_data[i], trace->dims);
+    }
+}
+
+/* returns the number of samples read back that differ from the trace */
+static unsigned _decode(const _trace_t *trace)
+{
+    phydat_ts_iter_t it;
+    phydat_t data;
+    uint32_t time;
+    unsigned errors = 0;
+    unsigned i = 0;
+
+    phydat_ts_iter_init(&_ts, &it, _times[0], _times[SAMPLES - 1]);
+    while (phydat_ts_iter_next(&it, &time, &data) > 0) {
+        if (i >= SAMPLES || time != _times[i] ||
+            memcmp(data.val, _data[i].val, trace->dims * sizeof(data.val[0]))) {
+            errors++;
+        }
+        i++;
+    }
+    return errors + (SAMPLES - MIN(i, SAMPLES));
+}
+
+static void _run(const _trace_t *trace)
+{
+    phydat_ts_usage_t usage;
+    unsigned errors = 0;
+
+    _generate(trace);
+
+    uint32_t start = ztimer_now(ZTIMER_USEC);
+    for (unsigned r = 0; r < ROUNDS; r++) {
+        _encode(trace);
+    }
+    uint32_t encode = ztimer_now(ZTIMER_USEC) - start;
+
+    start = ztimer_now(ZTIMER_USEC);
+    for (unsigned r = 0; r < ROUNDS; r++) {
+        errors = _decode(trace);
+    }
+    uint32_t decode = ztimer_now(ZTIMER_USEC) - start;
+
+    phydat_ts_usage(&_ts, &usage);
+    uint32_t raw = SAMPLES * RAW_SIZE;
+
+    /* sizes in hundredths of a byte, throughput in samples per ms */
+    uint32_t per_sample = usage.bytes * 100 / SAMPLES;
+    uint32_t ratio = raw * 100 / MAX(usage.bytes, 1);
+
+    printf("%-12s %4u %7" PRIu32 " %7" PRIu32 " %4" PRIu32 ".%02" PRIu32
+           " %4" PRIu32 ".%02" PRIu32 " %10" PRIu32 " %10" PRIu32 " %6u\n",
+           trace->name, trace->dims, raw, usage.bytes,
+           per_sample / 100, per_sample % 100, ratio / 100, ratio % 100,
+           (uint32_t)((uint64_t)SAMPLES * ROUNDS * US_PER_MS / MAX(encode, 1)),
+           (uint32_t)((uint64_t)SAMPLES * ROUNDS * US_PER_MS / MAX(decode, 1)),
+           errors);
+}
+
+int main(void)
+{
+    puts("phydat time series benchmark");
+    printf("%u samples per trace, %u byte blocks, %u byte raw samples\n",
+           SAMPLES, CONFIG_PHYDAT_TS_BLOCK_SIZE, (unsigned)RAW_SIZE);
+
+    printf("%-12s %4s %7s %7s %7s %7s %10s %10s %6s\n", "trace", "dims",
+           "raw B", "ts B", "B/smpl", "ratio", "enc /ms", "dec /ms",
+           "errors");
+    for (unsigned i = 0; i < ARRAY_SIZE(_traces); i++) {
+        _run(&_traces[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @brief       Benchmark of stackless tasks against threads
+ *
+ * Reports the RAM a stackless task of the ptask module and a thread take,
+ * and the time it takes to hand a token from one task to the next in a ring
+ * of tasks, or of threads.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "event.h"
+#include "kernel_defines.h"
+#include "mutex.h"
+#include "ptask.h"
+#include "thread.h"
+#include "thread_flags.h"
+#include "ztimer.h"
+
+/* times the token goes from one task to the next in a round */
+#define HOPS            (100000U)
+
+/* the largest rings */
+#define THREADS         (8U)
+#define TASKS           (64U)
+
+/* priority of the ring threads and of the thread of the task queue, above
+ * main, which only starts a round and waits for its end */
+#define RING_PRIO       (THREAD_PRIORITY_MAIN - 1)
+
+#define RING_FLAG       (0x0001U)
+
+typedef struct {
+    ptask_t task;
+    ptask_event_t token;    /**< posted by the task before in the ring */
+    unsigned idx;
+} _ring_task_t;
+
+static const unsigned _ring_lens[] = { 2, 8, 64 };
+
+static char _stacks[THREADS][THREAD_STACKSIZE_DEFAULT];
+static thread_t *_threads[THREADS];
+static char _queue_stack[THREAD_STACKSIZE_DEFAULT];
+static event_queue_t _queue;
+static _ring_task_t _tasks[TASKS];
+
+static unsigned _ring_len;
+static uint32_t _hops;
+static mutex_t _done = MUTEX_INIT_LOCKED;
+
+static void *_ring_thread(void *arg)
+{
+    unsigned idx = (uintptr_t)arg;
+
+    while (1) {
+        thread_flags_wait_any(RING_FLAG);
+        if (++_hops == HOPS) {
+            mutex_unlock(&_done);
+            continue;
+        }
+        thread_flags_set(_threads[(idx + 1) % _ring_len], RING_FLAG);
+    }
+
+    return NULL;
+}
+
+static int _ring_task(ptask_t *task)
+{
+    _ring_task_t *ring = container_of(task, _ring_task_t, task);
+
+    PTASK_BEGIN(task);
+    while (1) {
+        PTASK_AWAIT_EVENT(task, &ring->token);
+        if (++_hops == HOPS) {
+            mutex_unlock(&_done);
+            continue;
+        }
+        ptask_event_post(&_tasks[(ring->idx + 1) % _ring_len].token);
+    }
+    PTASK_END(task);
+}
+
+static void *_queue_thread(void *arg)
+{
+    (void)arg;
+
+    event_queue_init(&_queue);
+    event_loop(&_queue);
+    return NULL;
+}
+
+static void _round(const char *kind, unsigned len, bool threads)
+{
+    _ring_len = len;
+    _hops = 0;
+
+    uint32_t start = ztimer_now(ZTIMER_USEC);
+    if (threads) {
+        thread_flags_set(_threads[0], RING_FLAG);
+    }
+    else {
+        ptask_event_post(&_tasks[0].token);
+    }
+    mutex_lock(&_done);
+    uint32_t took = ztimer_now(ZTIMER_USEC) - start;
+
+    printf("%-6s %5u %8u %9" PRIu32 "\n", kind, len, HOPS,
+           (uint32_t)((uint64_t)took * 1000 / HOPS));
+}
+
+int main(void)
+{
+    puts("Stackless task benchmark");
+
+    for (unsigned i = 0; i < THREADS; i++) {
+        kernel_pid_t pid = thread_create(_stacks[i], sizeof(_stacks[i]),
+                                         RING_PRIO, THREAD_CREATE_STACKTEST,
+                                         _ring_thread, (void *)(uintptr_t)i,
+                                         "ring");
+        _threads[i] = thread_get(pid);
+    }
+    thread_create(_queue_stack, sizeof(_queue_stack), RING_PRIO,
+                  THREAD_CREATE_STACKTEST, _queue_thread, NULL, "ptask");
+    for (unsigned i = 0; i < TASKS; i++) {
+        _tasks[i].idx = i;
+        ptask_start(&_tasks[i].task, &_queue, _ring_task);
+    }
+
+    /* a thread keeps its thread_t on its stack, the tasks of a queue share
+     * the thread of the queue, which is paid for once */
+    printf("\n%-6s %9s %7s %7s\n", "kind", "control B", "stack B", "total B");
+    printf("%-6s %9u %7u %7u\n", "ptask", (unsigned)sizeof(_ring_task_t), 0U,
+           (unsigned)sizeof(_ring_task_t));
+    printf("%-6s %9u %7u %7u\n", "thread", (unsigned)sizeof(thread_t),
+           (unsigned)(sizeof(_stacks[0]) - sizeof(thread_t)),
+           (unsigned)sizeof(_stacks[0]));
+    printf("queue thread of the tasks, once: %u B\n",
+           (unsigned)sizeof(_queue_stack));
+
+    printf("\n%-6s %5s %8s %9s\n", "kind", "tasks", "hops", "ns/hop");
+    for (unsigned i = 0; i < ARRAY_SIZE(_ring_lens); i++) {
+        if (_ring_lens[i] <= THREADS) {
+            _round("thread", _ring_lens[i], true);
+        }
+        _round("ptask", _ring_lens[i], false);
+    }
+
+    return 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @brief       Benchmark of the SAUL sampler
+ *
+ * Samples a growing number of simulated SAUL devices and reports how far the
+ * intervals between two reads of a device deviate from its period (jitter),
+ * and how much CPU time the sampler spends reading.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "kernel_defines.h"
+#include "saul_reg.h"
+#include "saul_sampler.h"
+#include "time_units.h"
+#include "ztimer.h"
+
+#define MAX_DEVICES     (32U)
+
+/* duration of each round, in ms */
+#define RUN_TIME        (5U * MS_PER_SEC)
+
+/* time a simulated read takes, e.g. for an I2C transfer, in us */
+#define READ_COST       (100U)
+
+/* how often the reader drains the ring buffer, in ms */
+#define DRAIN_PERIOD    (100U)
+
+/* periods assigned to the devices in turn, in ms */
+static const uint32_t _periods[] = { 100, 200, 250, 500 };
+
+static const unsigned _counts[] = { 1, 2, 4, 8, 16, 32 };
+
+/* simulated device, measures the intervals between its reads */
+typedef struct {
+    uint32_t period;        /**< expected interval, in us */
+    uint32_t last;          /**< time of the last read, in us */
+    uint32_t reads;         /**< reads in this round */
+    uint32_t jitter_max;    /**< largest deviation from the period */
+    uint64_t jitter_sum;    /**< sum of the deviations */
+} _sim_dev_t;
+
+static _sim_dev_t _sim[MAX_DEVICES];
+static saul_reg_t _reg[MAX_DEVICES];
+static char _names[MAX_DEVICES][sizeof("sim00")];
+
+static int _sim_read(const void *dev, phydat_t *res)
+{
+    _sim_dev_t *sim = (_sim_dev_t *)dev;
+    uint32_t now = ztimer_now(ZTIMER_USEC);
+
+    if (sim->reads++) {
+        uint32_t interval = now - sim->last;
+        uint32_t jitter = (interval > sim->period) ? interval - sim->period
+                                                   : sim->period - interval;
+        sim->jitter_max = MAX(sim->jitter_max, jitter);
+        sim->jitter_sum += jitter;
+    }
+    sim->last = now;
+
+    /* busy wait for the duration of a real read */
+    while (ztimer_now(ZTIMER_USEC) - now < READ_COST) {}
+
+    res->val[0] = sim->reads;
+    res->unit = UNIT_NONE;
+    res->scale = 0;
+    return 1;
+}
+
+static const saul_driver_t _sim_driver = {
+    .read = _sim_read,
+    .write = saul_write_notsup,
+    .type = SAUL_SENSE_TEMP,
+};
+
+/* Reads all new samples, returns the number of samples that were lost */
+static unsigned _drain(saul_sampler_cursor_t *cursor, unsigned *read)
+{
+    saul_sampler_sample_t sample;
+    unsigned lost = 0;
+    int res;
+
+    while ((res = saul_sampler_read(cursor, &sample)) != 0) {
+        (*read)++;
+        if (res == -EOVERFLOW) {
+            lost++;
+        }
+    }
+    return lost;
+}
+
+static void _round(unsigned count)
+{
+    saul_sampler_cursor_t cursor;
+    int idx[MAX_DEVICES];
+    unsigned read = 0;
+    unsigned lost = 0;
+
+    for (unsigned i = 0; i < count; i++) {
+        _sim[i] = (_sim_dev_t){
+            .period = _periods[i % ARRAY_SIZE(_periods)] * US_PER_MS,
+        };
+    }
+
+    saul_sampler_cursor_init(&cursor);
+    saul_sampler_stats_reset();
+
+    uint32_t start = ztimer_now(ZTIMER_USEC);
+    for (unsigned i = 0; i < count; i++) {
+        idx[i] = saul_sampler_add(&_reg[i], _periods[i % ARRAY_SIZE(_periods)]);
+    }
+
+    /* a reader at lower priority, it never holds up the sampler */
+    while (ztimer_now(ZTIMER_USEC) - start < RUN_TIME * US_PER_MS) {
+        ztimer_sleep(ZTIMER_MSEC, DRAIN_PERIOD);
+        lost += _drain(&cursor, &read);
+    }
+
+    for (unsigned i = 0; i < count; i++) {
+        saul_sampler_remove(idx[i]);
+    }
+    uint32_t elapsed = ztimer_now(ZTIMER_USEC) - start;
+    lost += _drain(&cursor, &read);
+
+    saul_sampler_stats_t stats;
+    saul_sampler_stats(&stats);
+
+    uint32_t jitter_max = 0;
+    uint64_t jitter_sum = 0;
+    uint32_t intervals = 0;
+    for (unsigned i = 0; i < count; i++) {
+        jitter_max = MAX(jitter_max, _sim[i].jitter_max);
+        jitter_sum += _sim[i].jitter_sum;
+        intervals += _sim[i].reads ? _sim[i].reads - 1 : 0;
+    }
+
+    /* CPU load in per mille of the elapsed time */
+    uint32_t load = (uint64_t)stats.busy * 1000 / elapsed;
+
+    printf("%7u %7" PRIu32 " %7" PRIu32 " %9" PRIu32 ".%02" PRIu32
+           " %10" PRIu32 " %10" PRIu32 " %4" PRIu32 ".%" PRIu32 "%% %6u\n",
+           count, stats.reads, stats.wakeups,
+           stats.reads / MAX(stats.wakeups, 1),
+           (stats.reads * 100 / MAX(stats.wakeups, 1)) % 100,
+           (uint32_t)(jitter_sum / MAX(intervals, 1)), jitter_max,
+           load / 10, load % 10, lost);
+}
+
+int main(void)
+{
+    puts("SAUL sampler benchmark");
+    printf("%" PRIu32 " ms per round, %u us per read, group window %u ms\n",
+           (uint32_t)RUN_TIME, READ_COST, CONFIG_SAUL_SAMPLER_GROUP_WINDOW);
+
+    for (unsigned i = 0; i < MAX_DEVICES; i++) {
+        snprintf(_names[i], sizeof(_names[i]), "sim%02u", i);
+        _reg[i] = (saul_reg_t){
+            .dev = &_sim[i],
+            .name = _names[i],
+            .driver = &_sim_driver,
+        };
+    }
+
+    saul_sampler_init();
+
+    printf("%7s %7s %7s %12s %10s %10s %7s %6s\n", "devices", "reads",
+           "wakeups", "reads/wakeup", "jitter us", "max us", "cpu", "lost");
+    for (unsigned i = 0; i < ARRAY_SIZE(_counts); i++) {
+        _round(_counts[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     coap_cocoa
+ * @{
+ *
+ * @file
+ * @brief       CoCoA RTO estimator implementation
+ *
+ * @}
+ */
+
+#include "coap_cocoa.h"
+
+/* variation multipliers of the strong and weak RTO */
+#define K_STRONG        (4U)
+#define K_WEAK          (1U)
+
+/* thresholds of the variable backoff factor and the RTO aging */
+#define RTO_SMALL       (1000U)
+#define RTO_LARGE       (3000U)
+
+static uint32_t _clamp(uint32_t rto)
+{
+    return (rto > CONFIG_COAP_COCOA_RTO_MAX) ? CONFIG_COAP_COCOA_RTO_MAX : rto;
+}
+
+/* RFC 6298 update with alpha = 1/8 and beta = 1/4, returns the RTO of the
+ * estimator */
+static uint32_t _estimate(coap_cocoa_estimator_t *est, uint32_t rtt, unsigned k)
+{
+    if (est->samples++ == 0) {
+        est->srtt = rtt;
+        est->rttvar = rtt / 2;
+    }
+    else {
+        uint32_t diff = (est->srtt > rtt) ? est->srtt - rtt : rtt - est->srtt;
+        est->rttvar = est->rttvar - est->rttvar / 4 + diff / 4;
+        est->srtt = est->srtt - est->srtt / 8 + rtt / 8;
+    }
+    return est->srtt + k * est->rttvar;
+}
+
+void coap_cocoa_init(coap_cocoa_t *cocoa, uint32_t now)
+{
+    *cocoa = (coap_cocoa_t){
+        .rto = CONFIG_COAP_COCOA_RTO_INIT,
+        .updated_at = now,
+    };
+}
+
+/* Returns the RTO after aging, the current one if it does not age yet */
+static uint32_t _aged(const coap_cocoa_t *cocoa, uint32_t now)
+{
+    uint32_t idle = now - cocoa->updated_at;
+
+    /* small RTOs double after 16 RTOs without update, large ones move
+     * towards the initial RTO after 4 */
+    if (cocoa->rto < RTO_SMALL && idle > 16 * cocoa->rto) {
+        return cocoa->rto * 2;
+    }
+    if (cocoa->rto > RTO_LARGE && idle > 4 * cocoa->rto) {
+        return (cocoa->rto + CONFIG_COAP_COCOA_RTO_INIT) / 2;
+    }
+    return cocoa->rto;
+}
+
+uint32_t coap_cocoa_rto(coap_cocoa_t *cocoa, uint32_t now)
+{
+    uint32_t rto = _aged(cocoa, now);
+
+    if (rto != cocoa->rto) {
+        cocoa->rto = rto;
+        cocoa->updated_at = now;
+    }
+    return rto;
+}
+
+uint32_t coap_cocoa_rto_peek(const coap_cocoa_t *cocoa, uint32_t now)
+{
+    return _aged(cocoa, now);
+}
+
+uint32_t coap_cocoa_backoff(uint32_t timeout)
+{
+    if (timeout < RTO_SMALL) {
+        return _clamp(timeout * 3);
+    }
+    if (timeout <= RTO_LARGE) {
+        return _clamp(timeout * 2);
+    }
+    return _clamp(timeout + timeout / 2);
+}
+
+void coap_cocoa_sample(coap_cocoa_t *cocoa, uint32_t rtt,
+                       unsigned transmissions, uint32_t now)
+{
+    if (transmissions == 1) {
+        uint32_t rto = _estimate(&cocoa->strong, rtt, K_STRONG);
+        cocoa->rto = _clamp(rto / 2 + cocoa->rto / 2);
+    }
+    else if (transmissions <= 3) {
+        /* ambiguous samples are trusted less */
+        uint32_t rto = _estimate(&cocoa->weak, rtt, K_WEAK);
+        cocoa->rto = _clamp(rto / 4 + cocoa->rto - cocoa->rto / 4);
+    }
+    else {
+        return;
+    }
+    cocoa->updated_at = now;
+}
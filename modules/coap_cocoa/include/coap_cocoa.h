@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    coap_cocoa CoCoA retransmission timeouts
+ * @brief       Adaptive retransmission timeouts for confirmable CoAP messages
+ *
+ * Implements the RTO estimation of CoCoA (draft-ietf-core-cocoa). Each
+ * destination keeps two estimators in the style of RFC 6298: a strong one fed
+ * by exchanges that needed no retransmission, and a weak one fed by exchanges
+ * answered after the second or third transmission, measured from the first
+ * one. Both update an overall RTO, which also ages towards the default when
+ * no samples arrive, and which selects the backoff factor used between
+ * retransmissions.
+ *
+ * All times are in milliseconds.
+ * @{
+ *
+ * @file
+ * @brief       CoCoA RTO estimator definitions
+ */
+
+#ifndef COAP_COCOA_H
+#define COAP_COCOA_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   RTO used before the first sample, in ms
+ */
+#ifndef CONFIG_COAP_COCOA_RTO_INIT
+#define CONFIG_COAP_COCOA_RTO_INIT      (2000U)
+#endif
+
+/**
+ * @brief   Upper bound of the RTO, in ms
+ */
+#ifndef CONFIG_COAP_COCOA_RTO_MAX
+#define CONFIG_COAP_COCOA_RTO_MAX       (32000U)
+#endif
+
+/**
+ * @brief   State of one RFC 6298 style estimator
+ */
+typedef struct {
+    uint32_t srtt;          /**< smoothed round trip time */
+    uint32_t rttvar;        /**< round trip time variation */
+    uint16_t samples;       /**< number of samples taken */
+} coap_cocoa_estimator_t;
+
+/**
+ * @brief   RTO state of one destination
+ */
+typedef struct {
+    coap_cocoa_estimator_t strong;  /**< samples without retransmission */
+    coap_cocoa_estimator_t weak;    /**< samples after retransmissions */
+    uint32_t rto;                   /**< overall RTO */
+    uint32_t updated_at;            /**< time of the last RTO update */
+} coap_cocoa_t;
+
+/**
+ * @brief   Initializes the RTO state of a destination
+ *
+ * @param[out] cocoa    state to initialize
+ * @param[in]  now      current time
+ */
+void coap_cocoa_init(coap_cocoa_t *cocoa, uint32_t now);
+
+/**
+ * @brief   Returns the current RTO, after applying aging
+ *
+ * @param[in,out] cocoa     RTO state
+ * @param[in]     now       current time
+ *
+ * @return  RTO for the first transmission, without dithering
+ */
+uint32_t coap_cocoa_rto(coap_cocoa_t *cocoa, uint32_t now);
+
+/**
+ * @brief   Returns the RTO that @ref coap_cocoa_rto would return, without
+ *          applying the aging to @p cocoa
+ *
+ * @param[in] cocoa     RTO state
+ * @param[in] now       current time
+ *
+ * @return  RTO for the first transmission, without dithering
+ */
+uint32_t coap_cocoa_rto_peek(const coap_cocoa_t *cocoa, uint32_t now);
+
+/**
+ * @brief   Returns the timeout that follows @p timeout after a retransmission
+ *
+ * The variable backoff factor is 3 for timeouts below 1 s, 2 up to 3 s and
+ * 1.5 above.
+ */
+uint32_t coap_cocoa_backoff(uint32_t timeout);
+
+/**
+ * @brief   Feeds a round trip time sample
+ *
+ * @param[in,out] cocoa         RTO state
+ * @param[in]     rtt           time from the first transmission to the
+ *                              response
+ * @param[in]     transmissions number of transmissions of the request, only
+ *                              samples from up to three are used
+ * @param[in]     now           current time
+ */
+void coap_cocoa_sample(coap_cocoa_t *cocoa, uint32_t rtt,
+                       unsigned transmissions, uint32_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COAP_COCOA_H */
+/** @} */
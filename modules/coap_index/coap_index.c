@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     coap_index
+ * @{
+ *
+ * @file
+ * @brief       CoAP resource index implementation
+ *
+ * @}
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "container.h"
+#include "coap_index.h"
+
+#define ENABLE_DEBUG 0
+#include "debug.h"
+
+/* 32-bit FNV-1a */
+static uint32_t _hash(const char *path, size_t len)
+{
+    uint32_t hash = 2166136261U;
+
+    while (len--) {
+        hash = (hash ^ (uint8_t)*path++) * 16777619U;
+    }
+    return hash;
+}
+
+static bool _is_subtree(const coap_resource_t *resource)
+{
+    return resource->methods & COAP_MATCH_SUBTREE;
+}
+
+int coap_index_init(coap_index_t *idx, const coap_resource_t *resources,
+                    size_t resources_len, uint16_t *slots, size_t slots_len)
+{
+    if (slots_len <= resources_len || resources_len >= COAP_INDEX_EMPTY) {
+        return -ENOMEM;
+    }
+
+    idx->resources = resources;
+    idx->resources_len = resources_len;
+    idx->slots = slots;
+    idx->slots_len = slots_len;
+    idx->subtree_len = 0;
+
+    for (size_t i = 0; i < slots_len; i++) {
+        slots[i] = COAP_INDEX_EMPTY;
+    }
+
+    for (size_t i = 0; i < resources_len; i++) {
+        if (_is_subtree(&resources[i])) {
+            idx->subtree_len++;
+            continue;
+        }
+
+        /* linear probing, there is always a free slot left */
+        const char *path = resources[i].path;
+        size_t slot = _hash(path, strlen(path)) % slots_len;
+        while (slots[slot] != COAP_INDEX_EMPTY) {
+            slot = (slot + 1) % slots_len;
+        }
+        slots[slot] = i;
+    }
+
+    DEBUG("coap_index: %u resources, %u subtrees\n",
+          (unsigned)resources_len, (unsigned)idx->subtree_len);
+    return 0;
+}
+
+int coap_index_find(const coap_index_t *idx, const char *path, size_t path_len,
+                    coap_method_flags_t method_flag,
+                    const coap_resource_t **resource)
+{
+    int ret = COAP_INDEX_NO_PATH;
+    size_t slot = _hash(path, path_len) % idx->slots_len;
+
+    /* resources with the same path but different methods share a probe
+     * sequence, so keep going after a method mismatch */
+    for (; idx->slots[slot] != COAP_INDEX_EMPTY;
+         slot = (slot + 1) % idx->slots_len) {
+        const coap_resource_t *candidate = &idx->resources[idx->slots[slot]];
+
+        if (strncmp(candidate->path, path, path_len) ||
+            candidate->path[path_len] != '\0') {
+            continue;
+        }
+        if (candidate->methods & method_flag) {
+            *resource = candidate;
+            return COAP_INDEX_FOUND;
+        }
+        ret = COAP_INDEX_WRONG_METHOD;
+    }
+
+    if (ret != COAP_INDEX_NO_PATH || !idx->subtree_len) {
+        return ret;
+    }
+
+    /* subtree resources match on a prefix, which the hash can not express */
+    for (size_t i = 0; i < idx->resources_len; i++) {
+        const coap_resource_t *candidate = &idx->resources[i];
+        size_t len = strlen(candidate->path);
+
+        if (!_is_subtree(candidate) || len > path_len ||
+            strncmp(candidate->path, path, len)) {
+            continue;
+        }
+        if (candidate->methods & method_flag) {
+            *resource = candidate;
+            return COAP_INDEX_FOUND;
+        }
+        ret = COAP_INDEX_WRONG_METHOD;
+    }
+    return ret;
+}
+
+#if IS_USED(MODULE_GCOAP)
+int coap_index_request_matcher(gcoap_listener_t *listener,
+                               const coap_resource_t **resource,
+                               coap_pkt_t *pdu)
+{
+    coap_index_listener_t *indexed = container_of(listener,
+                                                  coap_index_listener_t,
+                                                  listener);
+    uint8_t uri[CONFIG_NANOCOAP_URI_MAX];
+
+    /* the length includes the terminating zero byte */
+    ssize_t uri_len = coap_get_uri_path(pdu, uri);
+    if (uri_len <= 0) {
+        return GCOAP_RESOURCE_NO_PATH;
+    }
+
+    coap_method_flags_t method_flag = coap_method2flag(coap_get_code_detail(pdu));
+    switch (coap_index_find(&indexed->index, (char *)uri, uri_len - 1,
+                            method_flag, resource)) {
+    case COAP_INDEX_FOUND:
+        return GCOAP_RESOURCE_FOUND;
+    case COAP_INDEX_WRONG_METHOD:
+        return GCOAP_RESOURCE_WRONG_METHOD;
+    default:
+        return GCOAP_RESOURCE_NO_PATH;
+    }
+}
+#endif
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    coap_index CoAP resource index
+ * @brief       Hash index for large CoAP resource tables
+ *
+ * gcoap matches the path of a request against each resource of a listener,
+ * one after another. For listeners with hundreds of resources this linear
+ * search dominates the request handling time. This module builds a hash index
+ * over the resource paths once during startup and provides a request matcher
+ * that uses it, so lookups take constant time on average.
+ *
+ * Resources flagged with @ref COAP_MATCH_SUBTREE can not be hashed, they are
+ * checked one after another when no exact match was found.
+ *
+ * Usage with gcoap:
+ * ```c
+ * static const coap_resource_t _resources[] = { ... };
+ * static uint16_t _slots[COAP_INDEX_SLOTS(ARRAY_SIZE(_resources))];
+ * static coap_index_listener_t _listener = {
+ *     .listener = {
+ *         _resources, ARRAY_SIZE(_resources), GCOAP_SOCKET_TYPE_UDP,
+ *         NULL, NULL, coap_index_request_matcher
+ *     },
+ * };
+ *
+ * coap_index_init(&_listener.index, _resources, ARRAY_SIZE(_resources),
+ *                 _slots, ARRAY_SIZE(_slots));
+ * gcoap_register_listener(&_listener.listener);
+ * ```
+ * @{
+ *
+ * @file
+ * @brief       CoAP resource index definitions
+ */
+
+#ifndef COAP_INDEX_H
+#define COAP_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "net/nanocoap.h"
+#if IS_USED(MODULE_GCOAP)
+#include "net/gcoap.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Recommended number of hash slots for @p n resources
+ *
+ * Keeps the load factor of the table at 50 %.
+ */
+#define COAP_INDEX_SLOTS(n)     (2 * (n) + 1)
+
+/**
+ * @brief   Marks an unused hash slot
+ */
+#define COAP_INDEX_EMPTY        (UINT16_MAX)
+
+/**
+ * @brief   Results of @ref coap_index_find
+ */
+enum {
+    COAP_INDEX_FOUND,           /**< resource found */
+    COAP_INDEX_WRONG_METHOD,    /**< path exists, but not for the method */
+    COAP_INDEX_NO_PATH,         /**< path does not exist */
+};
+
+/**
+ * @brief   Hash index over a resource table
+ */
+typedef struct {
+    const coap_resource_t *resources;   /**< indexed resources */
+    size_t resources_len;               /**< number of resources */
+    uint16_t *slots;                    /**< resource index per hash slot */
+    size_t slots_len;                   /**< number of hash slots */
+    size_t subtree_len;                 /**< resources matching a subtree */
+} coap_index_t;
+
+#if IS_USED(MODULE_GCOAP) || DOXYGEN
+/**
+ * @brief   gcoap listener that matches requests using an index
+ */
+typedef struct {
+    gcoap_listener_t listener;  /**< listener, request_matcher must be
+                                     @ref coap_index_request_matcher */
+    coap_index_t index;         /**< index over the listener resources */
+} coap_index_listener_t;
+#endif
+
+/**
+ * @brief   Builds the index over a resource table
+ *
+ * @param[out] idx              index to initialize
+ * @param[in]  resources        resources to index, must outlive the index
+ * @param[in]  resources_len    number of resources
+ * @param[in]  slots            storage for the hash slots
+ * @param[in]  slots_len        number of hash slots, should be
+ *                              @ref COAP_INDEX_SLOTS(resources_len)
+ *
+ * @return  0 on success
+ * @return  -ENOMEM if @p slots_len is not larger than @p resources_len
+ */
+int coap_index_init(coap_index_t *idx, const coap_resource_t *resources,
+                    size_t resources_len, uint16_t *slots, size_t slots_len);
+
+/**
+ * @brief   Looks up the resource for a path and method
+ *
+ * @param[in]  idx          index to search
+ * @param[in]  path         request path, starting with '/'
+ * @param[in]  path_len     length of @p path
+ * @param[in]  method_flag  method of the request, see @ref coap_method2flag
+ * @param[out] resource     matching resource
+ *
+ * @return  COAP_INDEX_FOUND if a resource was found
+ * @return  COAP_INDEX_WRONG_METHOD if the path exists but does not accept
+ *          the method
+ * @return  COAP_INDEX_NO_PATH if the path does not exist
+ */
+int coap_index_find(const coap_index_t *idx, const char *path, size_t path_len,
+                    coap_method_flags_t method_flag,
+                    const coap_resource_t **resource);
+
+#if IS_USED(MODULE_GCOAP) || DOXYGEN
+/**
+ * @brief   Request matcher for a @ref coap_index_listener_t
+ *
+ * Use as `request_matcher` of the listener embedded in a
+ * @ref coap_index_listener_t.
+ */
+int coap_index_request_matcher(gcoap_listener_t *listener,
+                               const coap_resource_t **resource,
+                               coap_pkt_t *pdu);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COAP_INDEX_H */
+/** @} */
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     coap_pdu_pool
+ * @{
+ *
+ * @file
+ * @brief       CoAP PDU buffer pool implementation
+ *
+ * @}
+ */
+
+#include <assert.h>
+
+#include "bitarithm.h"
+#include "irq.h"
+
+#include "coap_pdu_pool.h"
+
+static_assert(CONFIG_COAP_PDU_POOL_SIZE <= 32,
+              "the pool keeps the free buffers in a 32 bit mask");
+
+/* keeps the buffers word aligned, nanocoap accesses the header in place */
+typedef union {
+    uint8_t buf[CONFIG_COAP_PDU_POOL_BUF_SIZE];
+    uint32_t align;
+} _pdu_buf_t;
+
+static _pdu_buf_t _bufs[CONFIG_COAP_PDU_POOL_SIZE];
+
+/* bit i is set while buffer i is acquired */
+static uint32_t _used;
+static unsigned _high_water;
+static unsigned _exhausted;
+
+uint8_t *coap_pdu_pool_acquire(void)
+{
+    unsigned state = irq_disable();
+    uint32_t free = ~_used & (UINT32_MAX >> (32 - CONFIG_COAP_PDU_POOL_SIZE));
+
+    if (!free) {
+        _exhausted++;
+        irq_restore(state);
+        return NULL;
+    }
+
+    unsigned idx = bitarithm_lsb(free);
+    _used |= 1UL << idx;
+    unsigned in_use = bitarithm_bits_set(_used);
+    if (in_use > _high_water) {
+        _high_water = in_use;
+    }
+    irq_restore(state);
+
+    return _bufs[idx].buf;
+}
+
+void coap_pdu_pool_release(uint8_t *buf)
+{
+    if (!buf) {
+        return;
+    }
+
+    unsigned idx = (_pdu_buf_t *)buf - _bufs;
+    assert(idx < CONFIG_COAP_PDU_POOL_SIZE && (_used & (1UL << idx)));
+
+    unsigned state = irq_disable();
+    _used &= ~(1UL << idx);
+    irq_restore(state);
+}
+
+void coap_pdu_pool_stats(coap_pdu_pool_stats_t *stats)
+{
+    unsigned state = irq_disable();
+    stats->in_use = bitarithm_bits_set(_used);
+    stats->high_water = _high_water;
+    stats->exhausted = _exhausted;
+    irq_restore(state);
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    coap_pdu_pool CoAP PDU buffer pool
+ * @brief       Fixed number of statically allocated CoAP PDU buffers
+ *
+ * Requests are built directly in a buffer taken from the pool instead of a
+ * buffer on the stack of the sending thread. The buffer is kept for as long
+ * as the request needs it, e.g. until its response handler ran, and is then
+ * returned to the pool. The pool records how many buffers were in use at most,
+ * which tells how far @ref CONFIG_COAP_PDU_POOL_SIZE can be reduced.
+ *
+ * Buffers can be acquired and released from any thread.
+ * @{
+ *
+ * @file
+ * @brief       CoAP PDU buffer pool definitions
+ */
+
+#ifndef COAP_PDU_POOL_H
+#define COAP_PDU_POOL_H
+
+#include <stdint.h>
+
+#include "kernel_defines.h"
+#if IS_USED(MODULE_GCOAP)
+#include "net/gcoap.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Number of buffers in the pool, at most 32
+ */
+#ifndef CONFIG_COAP_PDU_POOL_SIZE
+#define CONFIG_COAP_PDU_POOL_SIZE       (4U)
+#endif
+
+/**
+ * @brief   Size of each buffer, by default the PDU buffer size of gcoap
+ */
+#ifndef CONFIG_COAP_PDU_POOL_BUF_SIZE
+#if IS_USED(MODULE_GCOAP)
+#define CONFIG_COAP_PDU_POOL_BUF_SIZE   (CONFIG_GCOAP_PDU_BUF_SIZE)
+#else
+#define CONFIG_COAP_PDU_POOL_BUF_SIZE   (128U)
+#endif
+#endif
+
+/**
+ * @brief   Usage statistics of the pool
+ */
+typedef struct {
+    unsigned in_use;        /**< buffers currently acquired */
+    unsigned high_water;    /**< most buffers acquired at the same time */
+    unsigned exhausted;     /**< acquisitions that found no free buffer */
+} coap_pdu_pool_stats_t;
+
+/**
+ * @brief   Takes a buffer of @ref CONFIG_COAP_PDU_POOL_BUF_SIZE bytes from
+ *          the pool
+ *
+ * @return  the buffer
+ * @return  NULL if all buffers are in use
+ */
+uint8_t *coap_pdu_pool_acquire(void);
+
+/**
+ * @brief   Returns a buffer to the pool
+ *
+ * @param[in] buf   buffer returned by @ref coap_pdu_pool_acquire, NULL is
+ *                  ignored
+ */
+void coap_pdu_pool_release(uint8_t *buf);
+
+/**
+ * @brief   Reads the usage statistics of the pool
+ *
+ * @param[out] stats    statistics
+ */
+void coap_pdu_pool_stats(coap_pdu_pool_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COAP_PDU_POOL_H */
+/** @} */
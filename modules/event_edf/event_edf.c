@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     event_edf
+ * @{
+ *
+ * @file
+ * @brief       Earliest-deadline-first event queue implementation
+ *
+ * @}
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "irq.h"
+#include "kernel_defines.h"
+#include "thread_flags.h"
+
+#include "event_edf.h"
+
+#if IS_USED(MODULE_SHELL)
+#include "shell.h"
+#endif
+
+/* all queues, for the shell command */
+static event_edf_queue_t *_queues;
+
+static bool _before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+static void _place(event_edf_queue_t *queue, event_edf_t *event, unsigned i)
+{
+    queue->heap[i] = event;
+    event->pos = i + 1;
+}
+
+static void _sift_up(event_edf_queue_t *queue, unsigned i)
+{
+    event_edf_t *event = queue->heap[i];
+
+    while (i > 0) {
+        unsigned parent = (i - 1) / 2;
+        if (!_before(event->deadline, queue->heap[parent]->deadline)) {
+            break;
+        }
+        _place(queue, queue->heap[parent], i);
+        i = parent;
+    }
+    _place(queue, event, i);
+}
+
+static void _sift_down(event_edf_queue_t *queue, unsigned i)
+{
+    event_edf_t *event = queue->heap[i];
+
+    while (1) {
+        unsigned child = 2 * i + 1;
+        if (child >= queue->len) {
+            break;
+        }
+        if (child + 1 < queue->len &&
+            _before(queue->heap[child + 1]->deadline,
+                    queue->heap[child]->deadline)) {
+            child++;
+        }
+        if (!_before(queue->heap[child]->deadline, event->deadline)) {
+            break;
+        }
+        _place(queue, queue->heap[child], i);
+        i = child;
+    }
+    _place(queue, event, i);
+}
+
+/* Removes the event at position i, with interrupts disabled */
+static void _remove(event_edf_queue_t *queue, unsigned i)
+{
+    queue->heap[i]->pos = 0;
+    queue->len--;
+    if (i == queue->len) {
+        return;
+    }
+
+    /* the last event takes the place, it may belong above or below it */
+    _place(queue, queue->heap[queue->len], i);
+    if (i > 0 && _before(queue->heap[i]->deadline,
+                         queue->heap[(i - 1) / 2]->deadline)) {
+        _sift_up(queue, i);
+    }
+    else {
+        _sift_down(queue, i);
+    }
+}
+
+static void _account(event_edf_stats_t *stats, uint32_t start, uint32_t end,
+                     uint32_t deadline)
+{
+    stats->runs++;
+    stats->run_max = MAX(stats->run_max, end - start);
+    if (_before(deadline, end)) {
+        stats->missed++;
+        stats->late_max = MAX(stats->late_max, end - deadline);
+    }
+}
+
+void event_edf_queue_init(event_edf_queue_t *queue, ztimer_clock_t *clock,
+                          const char *name)
+{
+    memset(queue, 0, sizeof(*queue));
+    queue->clock = clock;
+    queue->name = name;
+
+    unsigned state = irq_disable();
+    queue->next = _queues;
+    _queues = queue;
+    irq_restore(state);
+}
+
+int event_edf_post(event_edf_queue_t *queue, event_edf_t *event,
+                   uint32_t deadline)
+{
+    unsigned state = irq_disable();
+    deadline += ztimer_now(queue->clock);
+
+    if (event->pos) {
+        if (_before(deadline, event->deadline)) {
+            event->deadline = deadline;
+            _sift_up(queue, event->pos - 1);
+        }
+        irq_restore(state);
+        return 0;
+    }
+    if (queue->len == CONFIG_EVENT_EDF_QUEUE_SIZE) {
+        queue->dropped++;
+        irq_restore(state);
+        return -ENOBUFS;
+    }
+
+    event->deadline = deadline;
+    _place(queue, event, queue->len++);
+    _sift_up(queue, queue->len - 1);
+    queue->len_max = MAX(queue->len_max, queue->len);
+    thread_t *waiter = queue->waiter;
+    irq_restore(state);
+
+    if (waiter) {
+        thread_flags_set(waiter, CONFIG_EVENT_EDF_THREAD_FLAG);
+    }
+    return 0;
+}
+
+void event_edf_cancel(event_edf_queue_t *queue, event_edf_t *event)
+{
+    unsigned state = irq_disable();
+    if (event->pos) {
+        _remove(queue, event->pos - 1);
+    }
+    irq_restore(state);
+}
+
+void event_edf_loop(event_edf_queue_t *queue)
+{
+    unsigned state = irq_disable();
+    queue->waiter = thread_get_active();
+    irq_restore(state);
+
+    while (1) {
+        state = irq_disable();
+        if (!queue->len) {
+            irq_restore(state);
+            thread_flags_wait_any(CONFIG_EVENT_EDF_THREAD_FLAG);
+            continue;
+        }
+        event_edf_t *event = queue->heap[0];
+        uint32_t deadline = event->deadline;
+        _remove(queue, 0);
+        irq_restore(state);
+
+        if (!event->queue) {
+            event->queue = queue;
+            event->next = queue->events;
+            queue->events = event;
+        }
+
+        uint32_t start = ztimer_now(queue->clock);
+        event->handler(event);
+        uint32_t end = ztimer_now(queue->clock);
+
+        _account(&event->stats, start, end, deadline);
+        _account(&queue->stats, start, end, deadline);
+    }
+}
+
+void event_edf_stats_reset(event_edf_queue_t *queue)
+{
+    memset(&queue->stats, 0, sizeof(queue->stats));
+    queue->dropped = 0;
+    queue->len_max = queue->len;
+    for (event_edf_t *event = queue->events; event; event = event->next) {
+        memset(&event->stats, 0, sizeof(event->stats));
+    }
+}
+
+#if IS_USED(MODULE_SHELL)
+static void _print(const char *name, const event_edf_stats_t *stats)
+{
+    printf("  %-12s %8" PRIu32 " %8" PRIu32 " %10" PRIu32 " %10" PRIu32 "\n",
+           name ? name : "?", stats->runs, stats->missed, stats->late_max,
+           stats->run_max);
+}
+
+static int _edf_cmd(int argc, char **argv)
+{
+    bool reset = (argc > 1) && !strcmp(argv[1], "reset");
+
+    if (argc > 1 && !reset) {
+        printf("usage: %s [reset]\n", argv[0]);
+        return 1;
+    }
+
+    for (event_edf_queue_t *queue = _queues; queue; queue = queue->next) {
+        if (reset) {
+            event_edf_stats_reset(queue);
+            continue;
+        }
+        printf("%s: pending %u, most %u, dropped %" PRIu32 "\n",
+               queue->name, queue->len, queue->len_max, queue->dropped);
+        printf("  %-12s %8s %8s %10s %10s\n", "event", "runs", "missed",
+               "late max", "run max");
+        _print("(all)", &queue->stats);
+        for (event_edf_t *event = queue->events; event; event = event->next) {
+            _print(event->name, &event->stats);
+        }
+    }
+    return 0;
+}
+
+SHELL_COMMAND(edf, "Show deadline misses of the EDF event queues", _edf_cmd);
+#endif
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    event_edf Earliest-deadline-first event queue
+ * @brief       Event queue that runs the event with the earliest deadline
+ *              first
+ *
+ * The event queues of RIOT run events in the order they were posted. On a
+ * queue shared by a long handler and short, time-critical ones, the short ones
+ * wait behind the long one. Here each posted event carries a deadline, the
+ * time by which its handler should have finished, and the thread of the queue
+ * always runs the pending event with the earliest deadline. The pending events
+ * are kept in a binary heap, posting and taking one costs O(log n).
+ *
+ * A handler is not interrupted by an event with an earlier deadline, the
+ * thread runs one handler after the other. Long handlers still delay the
+ * others, but only those with later deadlines once they are pending.
+ *
+ * For each event and each queue the number of runs and of missed deadlines
+ * are counted. With the `shell` module, the `edf` command prints them.
+ *
+ * ```
+ * static event_edf_queue_t queue;
+ * static event_edf_t ev_read = { .handler = _read, .name = "read" };
+ *
+ * event_edf_queue_init(&queue, ZTIMER_MSEC, "app");
+ * event_edf_post(&queue, &ev_read, 5);    // should be done within 5 ms
+ * event_edf_loop(&queue);                 // in the thread of the queue
+ * ```
+ * @{
+ *
+ * @file
+ * @brief       Earliest-deadline-first event queue definitions
+ */
+
+#ifndef EVENT_EDF_H
+#define EVENT_EDF_H
+
+#include <stdint.h>
+
+#include "compiler_hints.h"
+#include "thread.h"
+#include "ztimer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Events a queue can hold pending
+ */
+#ifndef CONFIG_EVENT_EDF_QUEUE_SIZE
+#define CONFIG_EVENT_EDF_QUEUE_SIZE     (16U)
+#endif
+
+/**
+ * @brief   Thread flag that wakes up the thread of a queue
+ */
+#ifndef CONFIG_EVENT_EDF_THREAD_FLAG
+#define CONFIG_EVENT_EDF_THREAD_FLAG    (0x0002U)
+#endif
+
+typedef struct event_edf event_edf_t;
+typedef struct event_edf_queue event_edf_queue_t;
+
+/**
+ * @brief   Handler of an event
+ *
+ * @param[in] event     the event
+ */
+typedef void (*event_edf_handler_t)(event_edf_t *event);
+
+/**
+ * @brief   Statistics of an event or a queue
+ *
+ * Times are in ticks of the clock of the queue.
+ */
+typedef struct {
+    uint32_t runs;                  /**< handler runs */
+    uint32_t missed;                /**< runs that ended after the deadline */
+    uint32_t late_max;              /**< longest time past the deadline */
+    uint32_t run_max;               /**< longest run of the handler */
+} event_edf_stats_t;
+
+/**
+ * @brief   An event
+ */
+struct event_edf {
+    event_edf_handler_t handler;    /**< handler */
+    const char *name;               /**< name shown by the `edf` command, may
+                                         be NULL */
+    uint32_t deadline;              /**< deadline while pending */
+    uint16_t pos;                   /**< position in the heap plus one, 0 if
+                                         not pending */
+    event_edf_stats_t stats;        /**< statistics */
+    event_edf_t *next;              /**< next event of the queue that ran */
+    event_edf_queue_t *queue;       /**< queue the event ran on, NULL before
+                                         its first run */
+};
+
+/**
+ * @brief   A queue
+ */
+struct event_edf_queue {
+    event_edf_t *heap[CONFIG_EVENT_EDF_QUEUE_SIZE]; /**< pending events */
+    uint16_t len;                   /**< number of pending events */
+    uint16_t len_max;               /**< most pending events */
+    uint32_t dropped;               /**< posts that found the queue full */
+    ztimer_clock_t *clock;          /**< clock of the deadlines */
+    thread_t *waiter;               /**< thread of the queue, NULL until it
+                                         runs @ref event_edf_loop */
+    const char *name;               /**< name shown by the `edf` command */
+    event_edf_stats_t stats;        /**< statistics of all events */
+    event_edf_t *events;            /**< events that ran on the queue */
+    event_edf_queue_t *next;        /**< next queue */
+};
+
+/**
+ * @brief   Initializes a queue
+ *
+ * Events may be posted before a thread runs the queue.
+ *
+ * @param[out] queue    queue
+ * @param[in]  clock    clock of the deadlines, e.g. ZTIMER_MSEC
+ * @param[in]  name     name shown by the `edf` command
+ */
+void event_edf_queue_init(event_edf_queue_t *queue, ztimer_clock_t *clock,
+                          const char *name);
+
+/**
+ * @brief   Posts an event, may be called from interrupts
+ *
+ * An event that is still pending keeps the earlier of its deadlines.
+ *
+ * @param[in,out] queue     queue
+ * @param[in,out] event     event
+ * @param[in]     deadline  time from now by which the handler should have
+ *                          finished, in ticks of the clock of @p queue
+ *
+ * @return  0 on success
+ * @return  -ENOBUFS if the queue is full
+ */
+int event_edf_post(event_edf_queue_t *queue, event_edf_t *event,
+                   uint32_t deadline);
+
+/**
+ * @brief   Removes a pending event
+ *
+ * @param[in,out] queue     queue
+ * @param[in,out] event     event, may not be pending
+ */
+void event_edf_cancel(event_edf_queue_t *queue, event_edf_t *event);
+
+/**
+ * @brief   Runs the events of a queue, never returns
+ *
+ * Only one thread may run a queue.
+ *
+ * @param[in,out] queue     queue
+ */
+NORETURN void event_edf_loop(event_edf_queue_t *queue);
+
+/**
+ * @brief   Resets the statistics of a queue and its events
+ *
+ * @param[in,out] queue     queue
+ */
+void event_edf_stats_reset(event_edf_queue_t *queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EVENT_EDF_H */
+/** @} */
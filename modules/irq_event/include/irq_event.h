@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    irq_event Coalescing interrupt events
+ * @brief       Hands bursts of interrupts to a thread as one event
+ *
+ * An interrupt that posts an event for each edge floods the queue when the
+ * line bounces or is noisy. Here the interrupt only stores the time of each
+ * edge in a ring and posts a single event. An event that is still queued is
+ * not posted again, so the handler runs once for all edges that came in
+ * meanwhile, and gets their number and times as a batch.
+ *
+ * Edges that follow an accepted edge within the debounce time are counted as
+ * bounces and dropped. The ring is written by the interrupt and read by the
+ * handler without locks. If the handler falls behind and the ring is full,
+ * edges are still counted, only their time is lost.
+ *
+ * @ref irq_event_isr has the signature of a GPIO callback:
+ *
+ * ```
+ * static irq_event_t button;
+ *
+ * irq_event_init(&button, EVENT_PRIO_MEDIUM, ZTIMER_MSEC, 50, _press, NULL);
+ * gpio_init_int(BTN0_PIN, BTN0_MODE, GPIO_FALLING, irq_event_isr, &button);
+ * ```
+ * @{
+ *
+ * @file
+ * @brief       Coalescing interrupt event definitions
+ */
+
+#ifndef IRQ_EVENT_H
+#define IRQ_EVENT_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "event.h"
+#include "ztimer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Edges whose time is kept until the handler runs, a power of two
+ */
+#ifndef CONFIG_IRQ_EVENT_RING_SIZE
+#define CONFIG_IRQ_EVENT_RING_SIZE      (8U)
+#endif
+
+/**
+ * @brief   Edges handed to the handler in one run
+ */
+typedef struct {
+    uint32_t count;                 /**< accepted edges, including those
+                                         without a time */
+    uint32_t bounces;               /**< edges dropped by the debounce */
+    unsigned stamps;                /**< number of times in @ref time */
+    uint32_t time[CONFIG_IRQ_EVENT_RING_SIZE]; /**< times of the edges,
+                                                    oldest first, of the
+                                                    first ones if more came
+                                                    than fit */
+} irq_event_batch_t;
+
+typedef struct irq_event irq_event_t;
+
+/**
+ * @brief   Handler of a batch of edges, runs in the thread of the queue
+ *
+ * @param[in] ev        interrupt event
+ * @param[in] batch     edges since the last run
+ * @param[in] arg       argument given to @ref irq_event_init
+ */
+typedef void (*irq_event_cb_t)(irq_event_t *ev, const irq_event_batch_t *batch,
+                               void *arg);
+
+/**
+ * @brief   Interrupt event
+ *
+ * The counters only grow, the handler keeps what it has seen of them.
+ */
+struct irq_event {
+    event_t super;                  /**< event posted to the queue */
+    event_queue_t *queue;           /**< queue of the handler */
+    ztimer_clock_t *clock;          /**< clock of the times */
+    uint32_t debounce;              /**< debounce time in ticks of @ref clock */
+    irq_event_cb_t cb;              /**< handler */
+    void *arg;                      /**< argument of the handler */
+    uint32_t last;                  /**< time of the last accepted edge */
+    uint32_t time[CONFIG_IRQ_EVENT_RING_SIZE]; /**< ring of times */
+    atomic_uint_least32_t head;     /**< times ever stored, written by the
+                                         interrupt */
+    atomic_uint_least32_t tail;     /**< times ever read, written by the
+                                         handler */
+    atomic_uint_least32_t missed;   /**< edges without time, ring was full */
+    atomic_uint_least32_t bounces;  /**< edges dropped by the debounce */
+    uint32_t seen_missed;           /**< @ref missed already handled */
+    uint32_t seen_bounces;          /**< @ref bounces already handled */
+    uint32_t runs;                  /**< runs of the handler */
+};
+
+/**
+ * @brief   Initializes an interrupt event
+ *
+ * @param[out] ev       interrupt event
+ * @param[in]  queue    queue the handler runs on
+ * @param[in]  clock    clock of the times, e.g. ZTIMER_MSEC
+ * @param[in]  debounce edges closer than this to the last accepted one are
+ *                      bounces, in ticks of @p clock, 0 to accept all
+ * @param[in]  cb       handler
+ * @param[in]  arg      argument of the handler
+ */
+void irq_event_init(irq_event_t *ev, event_queue_t *queue,
+                    ztimer_clock_t *clock, uint32_t debounce,
+                    irq_event_cb_t cb, void *arg);
+
+/**
+ * @brief   Records an edge, call it from the interrupt
+ *
+ * Only one interrupt may record edges of an event.
+ *
+ * @param[in] arg   the interrupt event
+ */
+void irq_event_isr(void *arg);
+
+/**
+ * @brief   Stops handling edges
+ *
+ * Disable the interrupt first. Edges not handled yet are dropped.
+ *
+ * @param[in,out] ev    interrupt event
+ */
+void irq_event_stop(irq_event_t *ev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IRQ_EVENT_H */
+/** @} */
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     irq_event
+ * @{
+ *
+ * @file
+ * @brief       Coalescing interrupt event implementation
+ *
+ * @}
+ */
+
+#include <assert.h>
+
+#include "kernel_defines.h"
+
+#include "irq_event.h"
+
+static_assert((CONFIG_IRQ_EVENT_RING_SIZE &
+               (CONFIG_IRQ_EVENT_RING_SIZE - 1)) == 0,
+              "the ring size must be a power of two");
+
+#define RING_MASK       (CONFIG_IRQ_EVENT_RING_SIZE - 1)
+
+static void _handle(event_t *event)
+{
+    irq_event_t *ev = container_of(event, irq_event_t, super);
+    irq_event_batch_t batch = { 0 };
+
+    /* the ring never holds more times than a batch */
+    uint32_t head = atomic_load_explicit(&ev->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&ev->tail, memory_order_relaxed);
+    while (tail != head) {
+        batch.time[batch.stamps++] = ev->time[tail++ & RING_MASK];
+    }
+    atomic_store_explicit(&ev->tail, tail, memory_order_release);
+
+    uint32_t missed = atomic_load_explicit(&ev->missed, memory_order_relaxed);
+    uint32_t bounces = atomic_load_explicit(&ev->bounces,
+                                            memory_order_relaxed);
+    batch.count = batch.stamps + (missed - ev->seen_missed);
+    batch.bounces = bounces - ev->seen_bounces;
+    ev->seen_missed = missed;
+    ev->seen_bounces = bounces;
+
+    /* the event was posted again while the last run took the edges */
+    if (!batch.count) {
+        return;
+    }
+    ev->runs++;
+    ev->cb(ev, &batch, ev->arg);
+}
+
+void irq_event_init(irq_event_t *ev, event_queue_t *queue,
+                    ztimer_clock_t *clock, uint32_t debounce,
+                    irq_event_cb_t cb, void *arg)
+{
+    *ev = (irq_event_t){
+        .super = { .handler = _handle },
+        .queue = queue,
+        .clock = clock,
+        .debounce = debounce,
+        .cb = cb,
+        .arg = arg,
+    };
+    /* the first edge is never a bounce */
+    ev->last = ztimer_now(clock) - debounce;
+}
+
+void irq_event_isr(void *arg)
+{
+    irq_event_t *ev = arg;
+    uint32_t now = ztimer_now(ev->clock);
+
+    if (now - ev->last < ev->debounce) {
+        atomic_fetch_add_explicit(&ev->bounces, 1, memory_order_relaxed);
+        return;
+    }
+    ev->last = now;
+
+    uint32_t head = atomic_load_explicit(&ev->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ev->tail, memory_order_acquire);
+    if (head - tail < CONFIG_IRQ_EVENT_RING_SIZE) {
+        /* the handler only reads the slot once head covers it */
+        ev->time[head & RING_MASK] = now;
+        atomic_store_explicit(&ev->head, head + 1, memory_order_release);
+    }
+    else {
+        atomic_fetch_add_explicit(&ev->missed, 1, memory_order_relaxed);
+    }
+
+    /* does nothing if the event is still queued */
+    event_post(ev->queue, &ev->super);
+}
+
+void irq_event_stop(irq_event_t *ev)
+{
+    event_cancel(ev->queue, &ev->super);
+    atomic_store_explicit(&ev->tail,
+                          atomic_load_explicit(&ev->head,
+                                               memory_order_relaxed),
+                          memory_order_relaxed);
+    ev->seen_missed = atomic_load_explicit(&ev->missed, memory_order_relaxed);
+    ev->seen_bounces = atomic_load_explicit(&ev->bounces,
+                                            memory_order_relaxed);
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    lorawan_airtime LoRaWAN airtime accounting
+ * @brief       Time-on-air of EU868 uplinks and duty-cycle ledger
+ *
+ * Computes how long an uplink of a given payload size occupies the channel at
+ * each EU868 data rate, and keeps track of the duty cycle of each sub-band of
+ * the band. After a transmission of time-on-air T, a sub-band with a duty
+ * cycle of 1 % is off until T * 100 has passed since the start of the
+ * transmission, as the LoRaWAN regional parameters demand.
+ *
+ * Time stamps are in ms, e.g. from `ZTIMER_MSEC`, and may wrap around.
+ * @{
+ *
+ * @file
+ * @brief       LoRaWAN airtime accounting definitions
+ */
+
+#ifndef LORAWAN_AIRTIME_H
+#define LORAWAN_AIRTIME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Bytes a LoRaWAN frame adds to the application payload: MHDR,
+ *          DevAddr, FCtrl, FCnt, FPort and MIC, without FOpts
+ */
+#define LORAWAN_AIRTIME_OVERHEAD    (13U)
+
+/**
+ * @brief   Number of EU868 data rates, DR0 to DR7
+ */
+#define LORAWAN_AIRTIME_DRS         (8U)
+
+/**
+ * @brief   Number of EU868 sub-bands
+ */
+#define LORAWAN_AIRTIME_BANDS       (6U)
+
+/**
+ * @brief   Duty-cycle state of a sub-band
+ */
+typedef struct {
+    uint32_t ready;             /**< time at which the sub-band is free */
+    uint32_t airtime;           /**< time-on-air spent, in ms */
+    uint32_t count;             /**< number of transmissions */
+} lorawan_airtime_band_t;
+
+/**
+ * @brief   Duty-cycle ledger of all sub-bands
+ */
+typedef struct {
+    lorawan_airtime_band_t band[LORAWAN_AIRTIME_BANDS]; /**< sub-bands */
+} lorawan_airtime_t;
+
+/**
+ * @brief   Returns the time-on-air of an uplink
+ *
+ * @param[in] dr    EU868 data rate
+ * @param[in] len   application payload, the frame overhead is added
+ *
+ * @return  time-on-air in us, 0 for an unknown data rate
+ */
+uint32_t lorawan_airtime_toa(uint8_t dr, size_t len);
+
+/**
+ * @brief   Returns the time-on-air of a LoRa frame
+ *
+ * @param[in] sf    spreading factor, 6 to 12
+ * @param[in] bw    bandwidth in kHz
+ * @param[in] len   PHY payload, the whole LoRaWAN frame
+ *
+ * @return  time-on-air in us, 0 for invalid parameters
+ */
+uint32_t lorawan_airtime_lora(uint8_t sf, uint16_t bw, size_t len);
+
+/**
+ * @brief   Returns the largest application payload at a data rate
+ *
+ * @param[in] dr    EU868 data rate
+ *
+ * @return  payload size in bytes, 0 for an unknown data rate
+ */
+size_t lorawan_airtime_max_payload(uint8_t dr);
+
+/**
+ * @brief   Returns the sub-band of a frequency
+ *
+ * @param[in] freq  frequency in Hz
+ *
+ * @return  index of the sub-band
+ * @return  -ENOENT if the frequency is outside the EU868 sub-bands
+ */
+int lorawan_airtime_band(uint32_t freq);
+
+/**
+ * @brief   Returns the duty cycle of a sub-band
+ *
+ * @param[in] band  index of the sub-band
+ *
+ * @return  time the sub-band is off per unit of time-on-air, e.g. 100 for 1 %
+ */
+unsigned lorawan_airtime_divisor(unsigned band);
+
+/**
+ * @brief   Initializes a ledger, all sub-bands are free
+ *
+ * @param[out] ledger   ledger
+ * @param[in]  now      current time
+ */
+void lorawan_airtime_init(lorawan_airtime_t *ledger, uint32_t now);
+
+/**
+ * @brief   Returns how long to wait before a sub-band may be used
+ *
+ * @param[in] ledger    ledger
+ * @param[in] band      index of the sub-band
+ * @param[in] now       current time
+ *
+ * @return  time to wait in ms, 0 if the sub-band is free
+ */
+uint32_t lorawan_airtime_wait(const lorawan_airtime_t *ledger, unsigned band,
+                              uint32_t now);
+
+/**
+ * @brief   Records a transmission
+ *
+ * @param[in,out] ledger    ledger
+ * @param[in]     band      index of the sub-band
+ * @param[in]     toa       time-on-air in us, see @ref lorawan_airtime_toa
+ * @param[in]     now       start of the transmission
+ */
+void lorawan_airtime_debit(lorawan_airtime_t *ledger, unsigned band,
+                           uint32_t toa, uint32_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LORAWAN_AIRTIME_H */
+/** @} */
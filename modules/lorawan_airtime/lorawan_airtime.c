@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     lorawan_airtime
+ * @{
+ *
+ * @file
+ * @brief       LoRaWAN airtime accounting implementation
+ *
+ * @}
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "kernel_defines.h"
+#include "lorawan_airtime.h"
+#include "time_units.h"
+
+/* LoRa modulation as used by LoRaWAN: 8 preamble symbols, explicit header,
+ * CRC on and coding rate 4/5 */
+#define PREAMBLE        (8U)
+#define CODING_RATE     (1U)
+
+/* FSK at 50 kbit/s: 5 bytes of preamble, 3 bytes of sync word, the length
+ * byte and 2 bytes of CRC around the payload, 160 us per byte */
+#define FSK_OVERHEAD    (11U)
+#define FSK_BYTE_US     (160U)
+
+/* spreading factor and bandwidth in kHz, a spreading factor of 0 is FSK */
+static const struct {
+    uint8_t sf;
+    uint16_t bw;
+    uint8_t max_payload;
+} _drs[LORAWAN_AIRTIME_DRS] = {
+    { 12, 125, 51 },
+    { 11, 125, 51 },
+    { 10, 125, 51 },
+    {  9, 125, 115 },
+    {  8, 125, 222 },
+    {  7, 125, 222 },
+    {  7, 250, 222 },
+    {  0, 0, 222 },
+};
+
+/* EU868 sub-bands: first and last frequency in kHz, off-time per time-on-air */
+static const struct {
+    uint32_t min;
+    uint32_t max;
+    uint16_t divisor;
+} _bands[LORAWAN_AIRTIME_BANDS] = {
+    { 863000, 865000, 1000 },
+    { 865000, 868000, 100 },
+    { 868000, 868600, 100 },
+    { 868700, 869200, 1000 },
+    { 869400, 869650, 10 },
+    { 869700, 870000, 100 },
+};
+
+uint32_t lorawan_airtime_lora(uint8_t sf, uint16_t bw, size_t len)
+{
+    if (sf < 6 || sf > 12 || !bw) {
+        return 0;
+    }
+
+    /* symbols of the payload as given in the SX127x datasheet, with low data
+     * rate optimization for symbols longer than 16 ms */
+    unsigned de = (sf >= 11 && bw == 125);
+    int32_t bits = 8 * (int32_t)len - 4 * (int32_t)sf + 28 + 16;
+    uint32_t symbols = 8;
+    if (bits > 0) {
+        symbols += DIV_ROUND_UP((uint32_t)bits, 4 * (sf - 2 * de)) *
+                   (CODING_RATE + 4);
+    }
+
+    /* a symbol takes 2^SF / BW, the preamble 4.25 symbols more than given */
+    uint32_t symbol = ((uint32_t)US_PER_MS << sf) / bw;
+    return symbol * (4 * PREAMBLE + 17) / 4 + symbol * symbols;
+}
+
+uint32_t lorawan_airtime_toa(uint8_t dr, size_t len)
+{
+    size_t pl = len + LORAWAN_AIRTIME_OVERHEAD;
+
+    if (dr >= ARRAY_SIZE(_drs)) {
+        return 0;
+    }
+    if (_drs[dr].sf == 0) {
+        return (pl + FSK_OVERHEAD) * FSK_BYTE_US;
+    }
+    return lorawan_airtime_lora(_drs[dr].sf, _drs[dr].bw, pl);
+}
+
+size_t lorawan_airtime_max_payload(uint8_t dr)
+{
+    return (dr < ARRAY_SIZE(_drs)) ? _drs[dr].max_payload : 0;
+}
+
+int lorawan_airtime_band(uint32_t freq)
+{
+    uint32_t khz = freq / 1000;
+
+    for (unsigned i = 0; i < ARRAY_SIZE(_bands); i++) {
+        if (khz >= _bands[i].min && khz <= _bands[i].max) {
+            return i;
+        }
+    }
+    return -ENOENT;
+}
+
+unsigned lorawan_airtime_divisor(unsigned band)
+{
+    return (band < ARRAY_SIZE(_bands)) ? _bands[band].divisor : 0;
+}
+
+void lorawan_airtime_init(lorawan_airtime_t *ledger, uint32_t now)
+{
+    memset(ledger, 0, sizeof(*ledger));
+    for (unsigned i = 0; i < ARRAY_SIZE(ledger->band); i++) {
+        ledger->band[i].ready = now;
+    }
+}
+
+uint32_t lorawan_airtime_wait(const lorawan_airtime_t *ledger, unsigned band,
+                              uint32_t now)
+{
+    int32_t wait = ledger->band[band].ready - now;
+
+    return (wait > 0) ? (uint32_t)wait : 0;
+}
+
+void lorawan_airtime_debit(lorawan_airtime_t *ledger, unsigned band,
+                           uint32_t toa, uint32_t now)
+{
+    lorawan_airtime_band_t *b = &ledger->band[band];
+    uint32_t toa_ms = DIV_ROUND_UP(toa, US_PER_MS);
+    uint32_t ready = now + toa_ms * _bands[band].divisor;
+
+    /* a transmission while the sub-band was off extends the off-time */
+    if ((int32_t)(ready - b->ready) > 0) {
+        b->ready = ready;
+    }
+    b->airtime += toa_ms;
+    b->count++;
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    lorawan_dispatch LoRaWAN downlink dispatcher
+ * @brief       Passes downlinks to handlers by their FPort
+ *
+ * The dispatcher registers for the downlinks of GNRC LoRaWAN, which need the
+ * port in the netif header (`CONFIG_GNRC_NETIF_LORAWAN_NETIF_HDR`). It does
+ * not need a thread of its own: the interface thread hands each downlink over
+ * in a netreg callback, which only queues it and posts an event. The handlers
+ * run in the thread of the event queue.
+ *
+ * The handlers are given in a table, usually a static array:
+ *
+ * ```
+ * static lorawan_dispatch_port_t _ports[] = {
+ *     { .port = 2, .cb = _print },
+ *     { .port = 10, .cb = _led, .arg = &led },
+ * };
+ * ```
+ *
+ * A handler gets the payload snip of the downlink in the packet buffer, it is
+ * not copied. The dispatcher releases the packet once the handler returned.
+ *
+ * For each port the dispatcher counts the downlinks and their bytes, and
+ * keeps the time they waited in the queue and the time the handler took.
+ * @{
+ *
+ * @file
+ * @brief       LoRaWAN downlink dispatcher definitions
+ */
+
+#ifndef LORAWAN_DISPATCH_H
+#define LORAWAN_DISPATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "event.h"
+#include "mutex.h"
+#include "net/gnrc/netreg.h"
+#include "net/gnrc/pkt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Downlinks queued for the handlers, further ones are dropped
+ */
+#ifndef CONFIG_LORAWAN_DISPATCH_QUEUE_SIZE
+#define CONFIG_LORAWAN_DISPATCH_QUEUE_SIZE  (4U)
+#endif
+
+/**
+ * @brief   Highest FPort of application data
+ */
+#define LORAWAN_DISPATCH_PORT_MAX           (223U)
+
+/**
+ * @brief   Handler of the downlinks of a port
+ *
+ * @param[in] payload   payload of the downlink, only valid until the handler
+ *                      returns
+ * @param[in] port      FPort of the downlink
+ * @param[in] arg       argument of the port
+ */
+typedef void (*lorawan_dispatch_cb_t)(const gnrc_pktsnip_t *payload,
+                                      uint8_t port, void *arg);
+
+/**
+ * @brief   Statistics of a port
+ *
+ * Times are in µs.
+ */
+typedef struct {
+    uint32_t count;                     /**< downlinks handled */
+    uint32_t bytes;                     /**< bytes of their payloads */
+    uint32_t wait_max;                  /**< longest time in the queue */
+    uint32_t run_max;                   /**< longest run of the handler */
+    uint64_t run_total;                 /**< sum of the runs of the handler */
+} lorawan_dispatch_stats_t;
+
+/**
+ * @brief   A port and its handler
+ */
+typedef struct {
+    uint8_t port;                       /**< FPort, 1 to
+                                             @ref LORAWAN_DISPATCH_PORT_MAX */
+    lorawan_dispatch_cb_t cb;           /**< handler */
+    void *arg;                          /**< argument of the handler */
+    lorawan_dispatch_stats_t stats;     /**< statistics */
+} lorawan_dispatch_port_t;
+
+/**
+ * @brief   A queued downlink
+ */
+typedef struct {
+    gnrc_pktsnip_t *pkt;                /**< packet */
+    uint32_t time;                      /**< time it was queued, in µs */
+} lorawan_dispatch_entry_t;
+
+/**
+ * @brief   A dispatcher
+ */
+typedef struct {
+    event_t event;                      /**< posted to handle the queue */
+    event_queue_t *queue;               /**< event queue of the handlers */
+    gnrc_netreg_entry_cbd_t cbd;        /**< netreg callback */
+    gnrc_netreg_entry_t entry;          /**< netreg entry */
+    lorawan_dispatch_port_t *ports;     /**< ports and their handlers */
+    size_t num;                         /**< number of ports */
+    mutex_t lock;                       /**< protects the queue */
+    lorawan_dispatch_entry_t entries[CONFIG_LORAWAN_DISPATCH_QUEUE_SIZE];
+                                        /**< queued downlinks */
+    unsigned first;                     /**< oldest queued downlink */
+    unsigned used;                      /**< queued downlinks */
+    uint32_t unknown;                   /**< downlinks to ports without
+                                             handler or without port */
+    uint32_t dropped;                   /**< downlinks dropped, the queue
+                                             was full */
+} lorawan_dispatch_t;
+
+/**
+ * @brief   Starts passing the downlinks to the handlers
+ *
+ * @param[out] disp     dispatcher
+ * @param[in]  queue    event queue the handlers run on
+ * @param[in]  ports    ports and their handlers, must stay valid
+ * @param[in]  num      number of @p ports
+ *
+ * @return  0 on success
+ * @return  -EINVAL if a port is out of range or given twice
+ */
+int lorawan_dispatch_init(lorawan_dispatch_t *disp, event_queue_t *queue,
+                          lorawan_dispatch_port_t *ports, size_t num);
+
+/**
+ * @brief   Stops passing the downlinks to the handlers
+ *
+ * Downlinks still queued are handled.
+ *
+ * @param[in,out] disp  dispatcher
+ */
+void lorawan_dispatch_stop(lorawan_dispatch_t *disp);
+
+/**
+ * @brief   Returns the port entry of an FPort
+ *
+ * @param[in] disp      dispatcher
+ * @param[in] port      FPort
+ *
+ * @return  the entry, NULL if the port has no handler
+ */
+lorawan_dispatch_port_t *lorawan_dispatch_find(const lorawan_dispatch_t *disp,
+                                               uint8_t port);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LORAWAN_DISPATCH_H */
+/** @} */
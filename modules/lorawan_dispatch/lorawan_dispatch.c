@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     lorawan_dispatch
+ * @{
+ *
+ * @file
+ * @brief       LoRaWAN downlink dispatcher implementation
+ *
+ * @}
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+
+#include "kernel_defines.h"
+#include "lorawan_dispatch.h"
+#include "net/gnrc/netapi.h"
+#include "net/gnrc/netif/hdr.h"
+#include "net/gnrc/pktbuf.h"
+#include "ztimer.h"
+
+/* Returns the FPort of a downlink, -1 if it has none */
+static int _port(gnrc_pktsnip_t *pkt)
+{
+    gnrc_pktsnip_t *snip = gnrc_pktsnip_search_type(pkt,
+                                                          GNRC_NETTYPE_NETIF);
+
+    if (!snip) {
+        return -1;
+    }
+    const gnrc_netif_hdr_t *hdr = snip->data;
+    if (hdr->dst_l2addr_len != 1) {
+        return -1;
+    }
+    return gnrc_netif_hdr_get_dst_addr(hdr)[0];
+}
+
+static bool _pop(lorawan_dispatch_t *disp, lorawan_dispatch_entry_t *entry)
+{
+    bool res = false;
+
+    mutex_lock(&disp->lock);
+    if (disp->used) {
+        *entry = disp->entries[disp->first];
+        disp->first = (disp->first + 1) % ARRAY_SIZE(disp->entries);
+        disp->used--;
+        res = true;
+    }
+    mutex_unlock(&disp->lock);
+    return res;
+}
+
+/* Runs in the thread of the event queue */
+static void _handle(event_t *event)
+{
+    lorawan_dispatch_t *disp = container_of(event, lorawan_dispatch_t, event);
+    lorawan_dispatch_entry_t entry;
+
+    while (_pop(disp, &entry)) {
+        int port = _port(entry.pkt);
+        lorawan_dispatch_port_t *p = port < 0 ? NULL
+                                   : lorawan_dispatch_find(disp, port);
+        if (!p) {
+            disp->unknown++;
+            gnrc_pktbuf_release(entry.pkt);
+            continue;
+        }
+
+        /* the payload is the first snip, the netif header follows it */
+        uint32_t start = ztimer_now(ZTIMER_USEC);
+        p->cb(entry.pkt, p->port, p->arg);
+        uint32_t run = ztimer_now(ZTIMER_USEC) - start;
+
+        p->stats.count++;
+        p->stats.bytes += entry.pkt->size;
+        p->stats.wait_max = MAX(p->stats.wait_max, start - entry.time);
+        p->stats.run_max = MAX(p->stats.run_max, run);
+        p->stats.run_total += run;
+        gnrc_pktbuf_release(entry.pkt);
+    }
+}
+
+/* Runs in the thread of the interface, only queues the downlink */
+static void _receive(uint16_t cmd, gnrc_pktsnip_t *pkt, void *ctx)
+{
+    lorawan_dispatch_t *disp = ctx;
+
+    if (cmd != GNRC_NETAPI_MSG_TYPE_RCV) {
+        gnrc_pktbuf_release(pkt);
+        return;
+    }
+
+    mutex_lock(&disp->lock);
+    if (disp->used == ARRAY_SIZE(disp->entries)) {
+        disp->dropped++;
+        mutex_unlock(&disp->lock);
+        gnrc_pktbuf_release(pkt);
+        return;
+    }
+    unsigned idx = (disp->first + disp->used++) % ARRAY_SIZE(disp->entries);
+    disp->entries[idx] = (lorawan_dispatch_entry_t){
+        .pkt = pkt,
+        .time = ztimer_now(ZTIMER_USEC),
+    };
+    mutex_unlock(&disp->lock);
+
+    event_post(disp->queue, &disp->event);
+}
+
+int lorawan_dispatch_init(lorawan_dispatch_t *disp, event_queue_t *queue,
+                          lorawan_dispatch_port_t *ports, size_t num)
+{
+    for (size_t i = 0; i < num; i++) {
+        if (ports[i].port < 1 || ports[i].port > LORAWAN_DISPATCH_PORT_MAX) {
+            return -EINVAL;
+        }
+        for (size_t j = 0; j < i; j++) {
+            if (ports[j].port == ports[i].port) {
+                return -EINVAL;
+            }
+        }
+    }
+
+    *disp = (lorawan_dispatch_t){
+        .event = { .handler = _handle },
+        .queue = queue,
+        .cbd = { .cb = _receive, .ctx = disp },
+        .ports = ports,
+        .num = num,
+        .lock = MUTEX_INIT,
+    };
+    gnrc_netreg_entry_init_cb(&disp->entry, GNRC_NETREG_DEMUX_CTX_ALL,
+                              &disp->cbd);
+    gnrc_netreg_register(GNRC_NETTYPE_UNDEF, &disp->entry);
+    return 0;
+}
+
+void lorawan_dispatch_stop(lorawan_dispatch_t *disp)
+{
+    gnrc_netreg_unregister(GNRC_NETTYPE_UNDEF, &disp->entry);
+}
+
+lorawan_dispatch_port_t *lorawan_dispatch_find(const lorawan_dispatch_t *disp,
+                                               uint8_t port)
+{
+    /* there are few ports, a linear search is the fastest */
+    for (size_t i = 0; i < disp->num; i++) {
+        if (disp->ports[i].port == port) {
+            return &disp->ports[i];
+        }
+    }
+    return NULL;
+}
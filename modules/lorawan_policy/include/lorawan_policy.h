@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    lorawan_policy LoRaWAN data rate and batch policy
+ * @brief       Picks data rate and size of each uplink for little airtime
+ *
+ * The airtime spent per delivered byte falls with the data rate, a step of
+ * the spreading factor roughly halves it, and with the size of the uplink,
+ * which spreads the 13 bytes of frame overhead. A data rate too high for the
+ * link loses the uplink, though, and the airtime spent on it.
+ *
+ * The policy therefore uses the highest data rate that the link supports with
+ * a safety margin. The link is known from the demodulation margin the network
+ * reports, e.g. in a LinkCheckAns, for the data rate of an uplink: the signal
+ * to noise ratio of the link is the margin above the demodulation floor of
+ * that data rate, and the margin at any other data rate follows from its
+ * floor. Until the first report the policy uses a start data rate. Repeated
+ * failed uplinks step the data rate down, until the next report.
+ *
+ * When the network controls the data rate (ADR), the policy uses the data
+ * rate it commanded and only picks the batch size.
+ *
+ * Uplinks are held back until they are full, unless the oldest pending byte
+ * would wait longer than a maximum delay. An optional airtime budget per
+ * window, e.g. the daily fair-use airtime of a network, is spent with care:
+ * when an uplink does not fit into the rest of the budget, the policy tries a
+ * higher data rate the link still supports, then a smaller uplink, and
+ * otherwise holds the data until the next window.
+ *
+ * Only the LoRa data rates DR0 to DR6 are picked. Time stamps are in ms and
+ * may wrap around.
+ * @{
+ *
+ * @file
+ * @brief       LoRaWAN data rate and batch policy definitions
+ */
+
+#ifndef LORAWAN_POLICY_H
+#define LORAWAN_POLICY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Margin in dB above the demodulation floor the policy keeps for
+ *          fading and interference
+ *
+ * Deeper fades are covered by the steps down after failed uplinks.
+ */
+#ifndef CONFIG_LORAWAN_POLICY_MARGIN
+#define CONFIG_LORAWAN_POLICY_MARGIN        (5)
+#endif
+
+/**
+ * @brief   Consecutive failed uplinks that step the data rate down
+ */
+#ifndef CONFIG_LORAWAN_POLICY_FAIL_LIMIT
+#define CONFIG_LORAWAN_POLICY_FAIL_LIMIT    (2U)
+#endif
+
+/**
+ * @brief   Window of the airtime budget in ms, a day by default
+ */
+#ifndef CONFIG_LORAWAN_POLICY_WINDOW
+#define CONFIG_LORAWAN_POLICY_WINDOW        (24UL * 60UL * 60UL * 1000UL)
+#endif
+
+/**
+ * @brief   Highest data rate the policy picks, DR7 is FSK
+ */
+#define LORAWAN_POLICY_DR_MAX               (6)
+
+/**
+ * @brief   Parameters of a policy
+ */
+typedef struct {
+    uint8_t dr_min;             /**< lowest data rate to use */
+    uint8_t dr_max;             /**< highest data rate to use */
+    uint8_t dr_start;           /**< data rate while the link is unknown */
+    uint32_t max_delay;         /**< longest a byte is held back to fill an
+                                     uplink, in ms */
+    uint32_t budget;            /**< airtime per window in ms, 0 for none */
+} lorawan_policy_params_t;
+
+/**
+ * @brief   State of a policy
+ */
+typedef struct {
+    lorawan_policy_params_t params; /**< parameters */
+    int16_t snr;                /**< SNR of the link in 0.1 dB */
+    bool snr_valid;             /**< a margin was reported */
+    int8_t adr;                 /**< data rate commanded by the network, -1
+                                     if the policy picks it */
+    uint8_t backoff;            /**< data rates stepped down after failures */
+    uint8_t failures;           /**< consecutive failed uplinks */
+    uint32_t window;            /**< start of the budget window */
+    uint32_t spent;             /**< airtime spent in the window, in us */
+} lorawan_policy_t;
+
+/**
+ * @brief   An uplink as picked by the policy
+ */
+typedef struct {
+    uint8_t dr;                 /**< data rate */
+    size_t len;                 /**< application payload, in bytes */
+    uint32_t toa;               /**< time-on-air in us */
+    uint32_t wait;              /**< time to hold the data back, in ms, if
+                                     no uplink was picked */
+} lorawan_policy_pick_t;
+
+/**
+ * @brief   Initializes a policy
+ *
+ * @param[out] policy   policy
+ * @param[in]  params   parameters, data rates above
+ *                      @ref LORAWAN_POLICY_DR_MAX are lowered to it
+ * @param[in]  now      current time, starts the budget window
+ */
+void lorawan_policy_init(lorawan_policy_t *policy,
+                         const lorawan_policy_params_t *params, uint32_t now);
+
+/**
+ * @brief   Reports the demodulation margin of an uplink
+ *
+ * Resets the steps down after failures.
+ *
+ * @param[in,out] policy    policy
+ * @param[in]     dr        data rate of the uplink
+ * @param[in]     margin    margin above the demodulation floor in dB, as in
+ *                          a LinkCheckAns
+ */
+void lorawan_policy_link(lorawan_policy_t *policy, uint8_t dr, int margin);
+
+/**
+ * @brief   Sets the data rate commanded by the network (ADR)
+ *
+ * @param[in,out] policy    policy
+ * @param[in]     dr        data rate, -1 to let the policy pick it again
+ */
+void lorawan_policy_adr(lorawan_policy_t *policy, int dr);
+
+/**
+ * @brief   Reports whether an uplink was delivered
+ *
+ * @param[in,out] policy    policy
+ * @param[in]     delivered true if it was, e.g. acknowledged
+ */
+void lorawan_policy_result(lorawan_policy_t *policy, bool delivered);
+
+/**
+ * @brief   Records the airtime of an uplink in the budget
+ *
+ * @param[in,out] policy    policy
+ * @param[in]     toa       time-on-air in us
+ * @param[in]     now       current time
+ */
+void lorawan_policy_sent(lorawan_policy_t *policy, uint32_t toa, uint32_t now);
+
+/**
+ * @brief   Returns the data rate the link supports
+ *
+ * @param[in] policy    policy
+ *
+ * @return  data rate
+ */
+uint8_t lorawan_policy_dr(const lorawan_policy_t *policy);
+
+/**
+ * @brief   Returns the SNR a receiver needs to demodulate a data rate, as
+ *          assumed by the policy
+ *
+ * @param[in] dr        data rate, above @ref LORAWAN_POLICY_DR_MAX it is
+ *                      lowered to it
+ *
+ * @return  demodulation floor in 0.1 dB
+ */
+int lorawan_policy_floor(uint8_t dr);
+
+/**
+ * @brief   Picks the data rate and size of the next uplink
+ *
+ * @param[in,out] policy    policy
+ * @param[in]     pending   bytes waiting to be sent
+ * @param[in]     age       time the oldest of them waits, in ms
+ * @param[in]     now       current time
+ * @param[out]    pick      the uplink, or how long to hold the data back
+ *
+ * @return  true if an uplink of @p pick->len bytes at @p pick->dr should be
+ *          sent now
+ * @return  false if the data should be held back for @p pick->wait
+ */
+bool lorawan_policy_pick(lorawan_policy_t *policy, size_t pending,
+                         uint32_t age, uint32_t now,
+                         lorawan_policy_pick_t *pick);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LORAWAN_POLICY_H */
+/** @} */
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     lorawan_policy
+ * @{
+ *
+ * @file
+ * @brief       LoRaWAN data rate and batch policy implementation
+ *
+ * @}
+ */
+
+#include <string.h>
+
+#include "kernel_defines.h"
+#include "lorawan_airtime.h"
+#include "lorawan_policy.h"
+
+/* SNR in 0.1 dB a LoRa receiver needs to demodulate a data rate: 2.5 dB less
+ * per step of the spreading factor, 3 dB more at twice the bandwidth */
+static const int16_t _floor[LORAWAN_POLICY_DR_MAX + 1] = {
+    -200, -175, -150, -125, -100, -75, -45,
+};
+
+/* margin in 0.1 dB of the link at a data rate */
+static int _margin(const lorawan_policy_t *policy, uint8_t dr)
+{
+    return policy->snr - _floor[dr];
+}
+
+static uint8_t _clamp(const lorawan_policy_t *policy, int dr)
+{
+    return MAX(MIN(dr, policy->params.dr_max), policy->params.dr_min);
+}
+
+void lorawan_policy_init(lorawan_policy_t *policy,
+                         const lorawan_policy_params_t *params, uint32_t now)
+{
+    memset(policy, 0, sizeof(*policy));
+    policy->params = *params;
+    policy->params.dr_max = MIN(params->dr_max, LORAWAN_POLICY_DR_MAX);
+    policy->params.dr_min = MIN(params->dr_min, policy->params.dr_max);
+    policy->adr = -1;
+    policy->window = now;
+}
+
+void lorawan_policy_link(lorawan_policy_t *policy, uint8_t dr, int margin)
+{
+    dr = MIN(dr, LORAWAN_POLICY_DR_MAX);
+    policy->snr = _floor[dr] + margin * 10;
+    policy->snr_valid = true;
+    policy->backoff = 0;
+    policy->failures = 0;
+}
+
+void lorawan_policy_adr(lorawan_policy_t *policy, int dr)
+{
+    policy->adr = dr < 0 ? -1 : MIN(dr, LORAWAN_POLICY_DR_MAX);
+}
+
+void lorawan_policy_result(lorawan_policy_t *policy, bool delivered)
+{
+    if (delivered) {
+        policy->failures = 0;
+        return;
+    }
+    if (++policy->failures >= CONFIG_LORAWAN_POLICY_FAIL_LIMIT) {
+        policy->failures = 0;
+        policy->backoff = MIN(policy->backoff + 1, LORAWAN_POLICY_DR_MAX);
+    }
+}
+
+static void _window(lorawan_policy_t *policy, uint32_t now)
+{
+    if (now - policy->window >= CONFIG_LORAWAN_POLICY_WINDOW) {
+        policy->window = now;
+        policy->spent = 0;
+    }
+}
+
+void lorawan_policy_sent(lorawan_policy_t *policy, uint32_t toa, uint32_t now)
+{
+    _window(policy, now);
+    policy->spent += toa;
+}
+
+uint8_t lorawan_policy_dr(const lorawan_policy_t *policy)
+{
+    int dr;
+
+    if (policy->adr >= 0) {
+        return _clamp(policy, policy->adr);
+    }
+
+    if (!policy->snr_valid) {
+        dr = policy->params.dr_start;
+    }
+    else {
+        /* the highest data rate that keeps the margin */
+        dr = policy->params.dr_min;
+        for (int d = policy->params.dr_max; d > policy->params.dr_min; d--) {
+            if (_margin(policy, d) >= CONFIG_LORAWAN_POLICY_MARGIN * 10) {
+                dr = d;
+                break;
+            }
+        }
+    }
+    return _clamp(policy, dr - policy->backoff);
+}
+
+int lorawan_policy_floor(uint8_t dr)
+{
+    return _floor[MIN(dr, LORAWAN_POLICY_DR_MAX)];
+}
+
+static void _set(lorawan_policy_pick_t *pick, uint8_t dr, size_t len)
+{
+    pick->dr = dr;
+    pick->len = len;
+    pick->toa = lorawan_airtime_toa(dr, len);
+    pick->wait = 0;
+}
+
+/* Fits the uplink into the rest of the budget, returns false if it can not */
+static bool _budget(const lorawan_policy_t *policy, size_t pending,
+                    lorawan_policy_pick_t *pick)
+{
+    uint64_t budget = (uint64_t)policy->params.budget * 1000;
+    uint32_t left = budget > policy->spent ? budget - policy->spent : 0;
+
+    if (pick->toa <= left) {
+        return true;
+    }
+
+    /* a higher data rate the link still demodulates, without margin */
+    if (policy->adr < 0 && policy->snr_valid) {
+        for (uint8_t dr = pick->dr + 1; dr <= policy->params.dr_max; dr++) {
+            size_t len = MIN(pending, lorawan_airtime_max_payload(dr));
+            if (_margin(policy, dr) >= 0 &&
+                lorawan_airtime_toa(dr, len) <= left) {
+                _set(pick, dr, len);
+                return true;
+            }
+        }
+    }
+
+    /* a smaller uplink */
+    size_t len = pick->len;
+    while (len > 1 && lorawan_airtime_toa(pick->dr, len) > left) {
+        len--;
+    }
+    if (lorawan_airtime_toa(pick->dr, len) <= left) {
+        _set(pick, pick->dr, len);
+        return true;
+    }
+    return false;
+}
+
+bool lorawan_policy_pick(lorawan_policy_t *policy, size_t pending,
+                         uint32_t age, uint32_t now,
+                         lorawan_policy_pick_t *pick)
+{
+    uint8_t dr = lorawan_policy_dr(policy);
+    size_t max = lorawan_airtime_max_payload(dr);
+
+    _window(policy, now);
+    _set(pick, dr, MIN(pending, max));
+
+    if (!pending) {
+        pick->wait = policy->params.max_delay;
+        return false;
+    }
+
+    /* wait for a full uplink, unless the data is overdue */
+    if (pending < max && age < policy->params.max_delay) {
+        pick->wait = policy->params.max_delay - age;
+        return false;
+    }
+
+    if (policy->params.budget && !_budget(policy, pending, pick)) {
+        pick->wait = CONFIG_LORAWAN_POLICY_WINDOW - (now - policy->window);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    lorawan_session Persistent LoRaWAN session
+ * @brief       Keeps a LoRaWAN session in flash across reboots
+ *
+ * A node that restores its session after a reboot does not have to join
+ * again, which saves airtime and energy.
+ *
+ * The session is stored as a record of one page. Each update writes a new
+ * record to the next page of a region of at least two sectors, so that writes
+ * spread over the whole region. A sector is only erased when the writes wrap
+ * around to it, the newest record is then always in another sector. At start
+ * the region is scanned for the newest record with a valid checksum.
+ *
+ * The uplink frame counter changes with every uplink. Instead of writing each
+ * value, a record reserves @ref CONFIG_LORAWAN_SESSION_FCNT_STEP values ahead,
+ * and a new record is only written once they are used up. A restored session
+ * continues at the end of the reservation, so a frame counter is never sent
+ * twice even if the node lost power right before a write.
+ *
+ * On the `native` board the `mtd_native` device stores the region in a file.
+ * @{
+ *
+ * @file
+ * @brief       Persistent LoRaWAN session definitions
+ */
+
+#ifndef LORAWAN_SESSION_H
+#define LORAWAN_SESSION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mtd.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Uplink frame counter values reserved by one write
+ */
+#ifndef CONFIG_LORAWAN_SESSION_FCNT_STEP
+#define CONFIG_LORAWAN_SESSION_FCNT_STEP    (64U)
+#endif
+
+/**
+ * @brief   Length of a session key
+ */
+#define LORAWAN_SESSION_KEY_LEN             (16U)
+
+/**
+ * @brief   State of a LoRaWAN session
+ */
+typedef struct {
+    uint8_t deveui[8];                          /**< DevEUI of the session */
+    uint8_t devaddr[4];                         /**< DevAddr */
+    uint8_t nwkskey[LORAWAN_SESSION_KEY_LEN];   /**< network session key */
+    uint8_t appskey[LORAWAN_SESSION_KEY_LEN];   /**< application session
+                                                     key */
+    uint32_t fcnt_up;                           /**< uplink frame counter */
+    uint32_t fcnt_down;                         /**< downlink frame
+                                                     counter */
+    uint8_t rx1_delay;                          /**< RxDelay of the
+                                                     join-accept, in s */
+    uint8_t dl_settings;                        /**< DLSettings of the
+                                                     join-accept: RX1 data
+                                                     rate offset and RX2
+                                                     data rate */
+} lorawan_session_t;
+
+/**
+ * @brief   Flash region of the session
+ */
+typedef struct {
+    mtd_dev_t *mtd;                 /**< flash device */
+    uint32_t sector;                /**< first sector of the region */
+    uint32_t sectors;               /**< sectors of the region */
+    uint32_t next;                  /**< page of the next write, relative to
+                                         the region */
+    uint32_t seq;                   /**< sequence number of the newest
+                                         record */
+    uint32_t writes;                /**< records written since the start */
+    bool valid;                     /**< @ref session holds a session */
+    lorawan_session_t session;      /**< newest session, with the reserved
+                                         uplink frame counter */
+} lorawan_session_store_t;
+
+/**
+ * @brief   Opens a region and finds the newest session stored in it
+ *
+ * @param[out] store    store
+ * @param[in]  mtd      flash device
+ * @param[in]  sector   first sector of the region
+ * @param[in]  sectors  sectors of the region, at least 2
+ *
+ * @return  0 on success
+ * @return  -EINVAL if the region is too small or a page too short for a
+ *          record
+ */
+int lorawan_session_init(lorawan_session_store_t *store, mtd_dev_t *mtd,
+                         uint32_t sector, uint32_t sectors);
+
+/**
+ * @brief   Returns the stored session
+ *
+ * The uplink frame counter is the first value not reserved by the store, the
+ * session continues with it.
+ *
+ * @param[in]  store    store
+ * @param[out] session  session
+ *
+ * @return  0 on success
+ * @return  -ENOENT if no session is stored
+ */
+int lorawan_session_load(const lorawan_session_store_t *store,
+                         lorawan_session_t *session);
+
+/**
+ * @brief   Stores a session, e.g. after a join
+ *
+ * @param[in,out] store     store
+ * @param[in]     session   session
+ *
+ * @return  0 on success
+ * @return  negative errno value if writing failed
+ */
+int lorawan_session_save(lorawan_session_store_t *store,
+                         const lorawan_session_t *session);
+
+/**
+ * @brief   Updates the frame counters of the stored session
+ *
+ * Only writes once @p fcnt_up reaches the reserved values.
+ *
+ * @param[in,out] store     store
+ * @param[in]     fcnt_up   next uplink frame counter
+ * @param[in]     fcnt_down last downlink frame counter
+ *
+ * @return  1 if a record was written, 0 if not needed
+ * @return  -ENOENT if no session is stored
+ * @return  negative errno value if writing failed
+ */
+int lorawan_session_update(lorawan_session_store_t *store, uint32_t fcnt_up,
+                           uint32_t fcnt_down);
+
+/**
+ * @brief   Forgets the stored session, the next start joins again
+ *
+ * @param[in,out] store     store
+ *
+ * @return  0 on success
+ * @return  negative errno value if erasing failed
+ */
+int lorawan_session_clear(lorawan_session_store_t *store);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LORAWAN_SESSION_H */
+/** @} */
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     lorawan_session
+ * @{
+ *
+ * @file
+ * @brief       Persistent LoRaWAN session implementation
+ *
+ * @}
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "checksum/fletcher16.h"
+#include "lorawan_session.h"
+
+/* records of an older layout, without the receive windows or with the
+ * DevNonce, are not loaded */
+#define RECORD_MAGIC    (0x4c575333UL)  /* "LWS3" */
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    lorawan_session_t session;
+    uint16_t check;
+} _record_t;
+
+static uint16_t _check(const _record_t *rec)
+{
+    return fletcher16((const uint8_t *)rec, offsetof(_record_t, check));
+}
+
+static uint32_t _pages(const lorawan_session_store_t *store)
+{
+    return store->sectors * store->mtd->pages_per_sector;
+}
+
+static bool _read(const lorawan_session_store_t *store, uint32_t page,
+                  _record_t *rec)
+{
+    page += store->sector * store->mtd->pages_per_sector;
+    if (mtd_read_page(store->mtd, rec, page, 0, sizeof(*rec)) < 0) {
+        return false;
+    }
+    return rec->magic == RECORD_MAGIC && rec->check == _check(rec);
+}
+
+static int _write(lorawan_session_store_t *store,
+                  const lorawan_session_t *session)
+{
+    uint32_t pages_per_sector = store->mtd->pages_per_sector;
+    uint32_t page = store->next;
+    _record_t rec;
+    int res;
+
+    /* the next write wraps into a sector, the newest record is in the one
+     * before it */
+    store->next = (store->next + 1) % _pages(store);
+    if (page % pages_per_sector == 0) {
+        res = mtd_erase_sector(store->mtd,
+                               store->sector + page / pages_per_sector, 1);
+        if (res < 0) {
+            return res;
+        }
+    }
+
+    /* padding is part of the checksum */
+    memset(&rec, 0, sizeof(rec));
+    rec.magic = RECORD_MAGIC;
+    rec.seq = store->seq + 1;
+    rec.session = *session;
+    rec.check = _check(&rec);
+
+    res = mtd_write_page_raw(store->mtd, &rec,
+                             store->sector * pages_per_sector + page, 0,
+                             sizeof(rec));
+    if (res < 0) {
+        return res;
+    }
+
+    store->seq = rec.seq;
+    store->session = *session;
+    store->valid = true;
+    store->writes++;
+    return 0;
+}
+
+int lorawan_session_init(lorawan_session_store_t *store, mtd_dev_t *mtd,
+                         uint32_t sector, uint32_t sectors)
+{
+    if (sectors < 2 || sector + sectors > mtd->sector_count ||
+        mtd->page_size < sizeof(_record_t)) {
+        return -EINVAL;
+    }
+
+    memset(store, 0, sizeof(*store));
+    store->mtd = mtd;
+    store->sector = sector;
+    store->sectors = sectors;
+
+    for (uint32_t page = 0; page < _pages(store); page++) {
+        _record_t rec;
+        if (!_read(store, page, &rec)) {
+            continue;
+        }
+        if (!store->valid || (int32_t)(rec.seq - store->seq) > 0) {
+            store->valid = true;
+            store->seq = rec.seq;
+            store->session = rec.session;
+            store->next = (page + 1) % _pages(store);
+        }
+    }
+    return 0;
+}
+
+int lorawan_session_load(const lorawan_session_store_t *store,
+                         lorawan_session_t *session)
+{
+    if (!store->valid) {
+        return -ENOENT;
+    }
+    *session = store->session;
+    return 0;
+}
+
+int lorawan_session_save(lorawan_session_store_t *store,
+                         const lorawan_session_t *session)
+{
+    lorawan_session_t reserved = *session;
+
+    reserved.fcnt_up += CONFIG_LORAWAN_SESSION_FCNT_STEP;
+    return _write(store, &reserved);
+}
+
+int lorawan_session_update(lorawan_session_store_t *store, uint32_t fcnt_up,
+                           uint32_t fcnt_down)
+{
+    if (!store->valid) {
+        return -ENOENT;
+    }
+    if (fcnt_up < store->session.fcnt_up) {
+        return 0;
+    }
+
+    lorawan_session_t session = store->session;
+    session.fcnt_up = fcnt_up;
+    session.fcnt_down = fcnt_down;
+
+    int res = lorawan_session_save(store, &session);
+    return (res < 0) ? res : 1;
+}
+
+int lorawan_session_clear(lorawan_session_store_t *store)
+{
+    int res = mtd_erase_sector(store->mtd, store->sector, store->sectors);
+
+    store->valid = false;
+    store->next = 0;
+    return res;
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    netdev_lora_sim Simulated LoRa radio for the native board
+ * @brief       LoRa netdev that exchanges frames with a network server
+ *              emulator over UDP
+ *
+ * The radio stands in for a LoRa transceiver such as the SX1272 on the
+ * `native` board, so that GNRC LoRaWAN and the applications on top of it run
+ * without hardware. Each transmitted frame is sent as a UDP datagram to the
+ * network server emulator `lorawan_ns.py` of this module on the host, which
+ * plays gateway and network server. The radio stays busy for the time-on-air
+ * of the frame before it reports the end of the transmission.
+ *
+ * The emulator answers with downlinks right away. The radio keeps the last
+ * one until a receive window opens on its frequency and spreading factor, and
+ * delivers it after its time-on-air. A window without a matching downlink
+ * times out after its symbol timeout, as a real radio would. A new
+ * transmission discards a downlink that was not received.
+ *
+ * Datagrams in both directions start with a header, all fields big endian:
+ *
+ * | bytes | content                                                    |
+ * |-------|------------------------------------------------------------|
+ * | 1     | @ref NETDEV_LORA_SIM_UPLINK or @ref NETDEV_LORA_SIM_DOWNLINK |
+ * | 4     | frequency in Hz                                            |
+ * | 1     | spreading factor                                           |
+ * | 1     | bandwidth, 0: 125 kHz, 1: 250 kHz, 2: 500 kHz              |
+ * | 1     | SNR in dB, signed, of the downlink                         |
+ * | n     | the LoRaWAN frame (PHY payload)                            |
+ * @{
+ *
+ * @file
+ * @brief       Simulated LoRa radio definitions
+ */
+
+#ifndef NETDEV_LORA_SIM_H
+#define NETDEV_LORA_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "net/gnrc/netif.h"
+#include "net/netdev.h"
+#include "ztimer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   UDP port of the network server emulator on localhost
+ */
+#ifndef CONFIG_NETDEV_LORA_SIM_PORT
+#define CONFIG_NETDEV_LORA_SIM_PORT         (17000U)
+#endif
+
+/**
+ * @brief   Type of a datagram
+ * @{
+ */
+#define NETDEV_LORA_SIM_UPLINK              (1U)
+#define NETDEV_LORA_SIM_DOWNLINK            (2U)
+/** @} */
+
+/**
+ * @brief   Size of the datagram header
+ */
+#define NETDEV_LORA_SIM_HDR_LEN             (8U)
+
+/**
+ * @brief   Largest LoRa frame
+ */
+#define NETDEV_LORA_SIM_FRAME_MAX           (255U)
+
+/**
+ * @brief   Radio parameters of a frame or receive window
+ */
+typedef struct {
+    uint32_t freq;                      /**< frequency in Hz */
+    uint8_t sf;                         /**< spreading factor */
+    uint8_t bw;                         /**< bandwidth, LORA_BW_* */
+} netdev_lora_sim_phy_t;
+
+/**
+ * @brief   Simulated radio
+ */
+typedef struct {
+    netdev_t netdev;                    /**< netdev parent */
+    int sock;                           /**< UDP socket to the emulator */
+    netopt_state_t state;               /**< state of the radio */
+    netdev_lora_sim_phy_t phy;          /**< current configuration */
+    uint8_t cr;                         /**< coding rate */
+    bool iq_invert;                     /**< IQ inverted, for downlinks */
+    bool single;                        /**< receive windows end after
+                                             @ref symbols */
+    uint16_t symbols;                   /**< symbol timeout of a window */
+    ztimer_t timer;                     /**< end of a transmission, reception
+                                             or receive window */
+    volatile uint8_t pending;           /**< events for the netdev ISR */
+    netdev_lora_sim_phy_t rx_phy;       /**< parameters of the downlink */
+    int8_t rx_snr;                      /**< SNR of the downlink */
+    uint8_t rx_len;                     /**< length of the downlink, 0 if
+                                             none is kept */
+    bool rx_busy;                       /**< the downlink is being received */
+    uint8_t rx_buf[NETDEV_LORA_SIM_FRAME_MAX]; /**< the downlink */
+} netdev_lora_sim_t;
+
+/**
+ * @brief   Sets up a simulated radio
+ *
+ * @param[out] dev  radio
+ */
+void netdev_lora_sim_setup(netdev_lora_sim_t *dev);
+
+/**
+ * @brief   Creates a GNRC LoRaWAN interface on a simulated radio
+ *
+ * Call it early in `main`, before the interfaces are looked up.
+ *
+ * @return  the interface
+ */
+gnrc_netif_t *netdev_lora_sim_auto_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NETDEV_LORA_SIM_H */
+/** @} */
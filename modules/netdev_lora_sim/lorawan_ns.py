@@ -0,0 +1,521 @@
+#!/usr/bin/env python3
+"""Network server emulator for the simulated LoRa radio of the native board.
+
+Plays gateway and LoRaWAN 1.0 network server for nodes that use the
+netdev_lora_sim module: accepts OTAA joins, checks and decrypts uplinks,
+acknowledges confirmed uplinks, answers LinkCheckReq and sends queued
+downlinks. Each frame takes its time-on-air before it is received, and frames
+are lost at random or if the SNR of the link is below the demodulation floor
+of their spreading factor. Per device it records the delivered uplinks,
+bytes, airtime and latency, and prints them periodically and at exit.
+
+Usage: lorawan_ns.py [--appkey HEX]... [--snr DB] [--loss P]
+                     [--downlink PORT:HEX]... [--journal] [--csv FILE]
+
+The nodes only need one of the AppKeys, the defaults are the placeholders of
+the applications. With --journal the uplinks are split into the records of
+the uplink_journal module, and the age of each record is its latency.
+
+Only the standard library is needed.
+"""
+import argparse
+import heapq
+import math
+import os
+import random
+import select
+import signal
+import socket
+import struct
+import sys
+import time
+
+UPLINK = 1
+DOWNLINK = 2
+HDR = struct.Struct(">BIBBb")
+
+JOIN_REQUEST = 0
+JOIN_ACCEPT = 1
+UNCONFIRMED_UP = 2
+UNCONFIRMED_DOWN = 3
+CONFIRMED_UP = 4
+
+# Delay of the first receive window after an uplink, in s
+RX_DELAY = 1
+
+# Demodulation floor of each spreading factor, in dB
+SNR_FLOOR = {7: -7.5, 8: -10, 9: -12.5, 10: -15, 11: -17.5, 12: -20}
+
+# Length of the answers to the MAC commands an end device sends, by CID
+MAC_ANS_LEN = {0x02: 0, 0x03: 1, 0x04: 0, 0x05: 1, 0x06: 2, 0x07: 1,
+               0x08: 0, 0x09: 0, 0x0A: 1}
+
+
+# AES-128 as of FIPS-197, slow but enough for a few frames per second
+
+def _sbox():
+    sbox = [0] * 256
+    p = q = 1
+    while True:
+        # multiply p by 3, divide q by 3 in GF(2^8)
+        p = p ^ ((p << 1) & 0xFF) ^ (0x1B if p & 0x80 else 0)
+        q ^= q << 1
+        q ^= q << 2
+        q ^= q << 4
+        q &= 0xFF
+        if q & 0x80:
+            q ^= 0x09
+        x = q ^ (q << 1 | q >> 7) ^ (q << 2 | q >> 6) ^ \
+            (q << 3 | q >> 5) ^ (q << 4 | q >> 4)
+        sbox[p] = (x ^ 0x63) & 0xFF
+        if p == 1:
+            break
+    sbox[0] = 0x63
+    return sbox
+
+
+SBOX = _sbox()
+INV_SBOX = [SBOX.index(i) for i in range(256)]
+
+
+def _xtime(a):
+    return ((a << 1) ^ 0x1B) & 0xFF if a & 0x80 else a << 1
+
+
+def _mul(a, b):
+    r = 0
+    while b:
+        if b & 1:
+            r ^= a
+        a = _xtime(a)
+        b >>= 1
+    return r
+
+
+def _expand(key):
+    w = list(key)
+    rcon = 1
+    for i in range(16, 176, 4):
+        t = w[i - 4:i]
+        if i % 16 == 0:
+            t = [SBOX[b] for b in t[1:] + t[:1]]
+            t[0] ^= rcon
+            rcon = _xtime(rcon)
+        w += [a ^ b for a, b in zip(w[i - 16:i - 12], t)]
+    return [w[r * 16:r * 16 + 16] for r in range(11)]
+
+
+def _shift(s, sign):
+    return [s[(i + sign * 4 * (i % 4)) % 16] for i in range(16)]
+
+
+def _mix(s, m):
+    out = []
+    for c in range(4):
+        col = s[c * 4:c * 4 + 4]
+        for r in range(4):
+            out.append(_mul(col[0], m[(0 - r) % 4]) ^
+                       _mul(col[1], m[(1 - r) % 4]) ^
+                       _mul(col[2], m[(2 - r) % 4]) ^
+                       _mul(col[3], m[(3 - r) % 4]))
+    return out
+
+
+def aes_encrypt(key, block):
+    rk = _expand(key)
+    s = [a ^ b for a, b in zip(block, rk[0])]
+    for r in range(1, 11):
+        s = _shift([SBOX[b] for b in s], 1)
+        if r < 10:
+            s = _mix(s, (2, 3, 1, 1))
+        s = [a ^ b for a, b in zip(s, rk[r])]
+    return bytes(s)
+
+
+def aes_decrypt(key, block):
+    rk = _expand(key)
+    s = [a ^ b for a, b in zip(block, rk[10])]
+    for r in range(9, -1, -1):
+        s = [INV_SBOX[b] for b in _shift(s, -1)]
+        s = [a ^ b for a, b in zip(s, rk[r])]
+        if r > 0:
+            s = _mix(s, (14, 11, 13, 9))
+    return bytes(s)
+
+
+def cmac(key, msg):
+    """AES-CMAC as of RFC 4493"""
+    def dbl(b):
+        n = int.from_bytes(b, "big") << 1
+        if n >> 128:
+            n ^= 0x87
+        return (n & ((1 << 128) - 1)).to_bytes(16, "big")
+
+    k1 = dbl(aes_encrypt(key, bytes(16)))
+    k2 = dbl(k1)
+    blocks = [msg[i:i + 16] for i in range(0, len(msg), 16)] or [b""]
+    last = blocks[-1]
+    if len(last) == 16:
+        last = bytes(a ^ b for a, b in zip(last, k1))
+    else:
+        last = last + b"\x80" + bytes(15 - len(last))
+        last = bytes(a ^ b for a, b in zip(last, k2))
+    x = bytes(16)
+    for block in blocks[:-1] + [last]:
+        x = aes_encrypt(key, bytes(a ^ b for a, b in zip(x, block)))
+    return x
+
+
+def airtime(sf, bw, length):
+    """Returns the time-on-air of a LoRa frame in s, with 8 preamble symbols,
+    explicit header, CRC and coding rate 4/5"""
+    t_sym = (1 << sf) / (bw * 1000)
+    de = 1 if t_sym > 0.016 else 0
+    n = math.ceil((8 * length - 4 * sf + 28 + 16) / (4 * (sf - 2 * de)))
+    return (12.25 + 8 + max(n, 0) * 5) * t_sym
+
+
+def _block(first, direction, addr, fcnt, last):
+    return bytes([first, 0, 0, 0, 0, direction]) + \
+        struct.pack("<II", addr, fcnt) + bytes([0, last])
+
+
+def frm_crypt(key, direction, addr, fcnt, data):
+    out = bytearray()
+    for i in range(0, len(data), 16):
+        s = aes_encrypt(key, _block(0x01, direction, addr, fcnt, i // 16 + 1))
+        out += bytes(a ^ b for a, b in zip(data[i:i + 16], s))
+    return bytes(out)
+
+
+def frame_mic(key, direction, addr, fcnt, msg):
+    return cmac(key, _block(0x49, direction, addr, fcnt, len(msg)) + msg)[:4]
+
+
+class Device:
+    def __init__(self, deveui, addr):
+        self.deveui = deveui
+        self.devaddr = None
+        self.addr = addr
+        self.nwkskey = self.appskey = None
+        self.fcnt_up = None
+        self.fcnt_down = 0
+        self.downlinks = []
+        self.joins = 0
+        self.join_start = None
+        self.uplinks = 0
+        self.confirmed = 0
+        self.duplicates = 0
+        self.missed = 0
+        self.lost = 0
+        self.bytes = 0
+        self.airtime = 0.0
+        self.sent_down = 0
+        self.lost_down = 0
+        self.first = None
+        self.last = None
+        self.latency = []
+
+    def report(self):
+        span = (self.last - self.first) if self.uplinks > 1 else 0
+        rate = self.bytes / span * 60 if span else 0
+        line = (f"{self.deveui.hex()} joins {self.joins} uplinks "
+                f"{self.uplinks} (confirmed {self.confirmed}) lost "
+                f"{self.lost} missed fcnt {self.missed} dup "
+                f"{self.duplicates} bytes {self.bytes} ({rate:.1f} B/min) "
+                f"airtime {self.airtime:.2f} s downlinks {self.sent_down} "
+                f"lost {self.lost_down}")
+        if self.latency:
+            lat = sorted(self.latency)
+            line += (f" latency mean {sum(lat) / len(lat):.0f} s p50 "
+                     f"{lat[len(lat) // 2]} s max {lat[-1]} s")
+        return line
+
+
+class Server:
+    def __init__(self, args):
+        self.args = args
+        self.appkeys = [bytes.fromhex(key) for key in
+                        args.appkey or ["AA" * 16, "CC" * 16]]
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.bind(("127.0.0.1", args.port))
+        self.devices = {}
+        self.by_addr = {}
+        self.next_addr = 0x26000001
+        self.timers = []
+        self.start = time.monotonic()
+        self.csv = open(args.csv, "w") if args.csv else None
+        if self.csv:
+            self.csv.write("time,deveui,fcnt,port,bytes,sf,airtime,"
+                           "confirmed,delivered\n")
+
+    def now(self):
+        return time.monotonic() - self.start
+
+    def at(self, delay, func, *args):
+        heapq.heappush(self.timers, (self.now() + delay, id(args), func,
+                                     args))
+
+    def log(self, msg):
+        print(f"[{self.now():9.3f}] {msg}", flush=True)
+
+    def lost(self, sf):
+        if random.random() < self.args.loss:
+            return True
+        return self.args.snr < SNR_FLOOR.get(sf, 0)
+
+    def run(self):
+        self.at(self.args.report, self.report_all)
+        while True:
+            timeout = None
+            if self.timers:
+                timeout = max(0, self.timers[0][0] - self.now())
+            ready, _, _ = select.select([self.sock], [], [], timeout)
+            if ready:
+                data, addr = self.sock.recvfrom(512)
+                self.receive(data, addr)
+            while self.timers and self.timers[0][0] <= self.now():
+                _, _, func, args = heapq.heappop(self.timers)
+                func(*args)
+
+    def receive(self, data, addr):
+        if len(data) <= HDR.size:
+            return
+        kind, freq, sf, bw, _ = HDR.unpack_from(data)
+        if kind != UPLINK:
+            return
+        frame = data[HDR.size:]
+        toa = airtime(sf, 125 << bw, len(frame))
+        # the frame is received once it was on air
+        self.at(toa, self.uplink, frame, addr, (freq, sf, bw), toa)
+
+    def send(self, dev, phy, frame):
+        """Sends a downlink at once, the radio keeps it until its receive
+        window opens"""
+        dev.sent_down += 1
+        if self.lost(phy[1]):
+            dev.lost_down += 1
+            self.log(f"{dev.deveui.hex()} downlink lost")
+            return
+        snr = max(-128, min(127, round(self.args.snr)))
+        self.sock.sendto(HDR.pack(DOWNLINK, phy[0], phy[1], phy[2], snr) +
+                         frame, dev.addr)
+
+    def uplink(self, frame, addr, phy, toa):
+        mtype = frame[0] >> 5
+        if mtype == JOIN_REQUEST and len(frame) == 23:
+            self.join(frame, addr, phy)
+        elif mtype in (UNCONFIRMED_UP, CONFIRMED_UP) and len(frame) >= 12:
+            self.data(frame, addr, phy, toa)
+
+    def join(self, frame, addr, phy):
+        deveui = frame[9:17][::-1]
+        dev = self.devices.get(deveui)
+        if dev is None:
+            dev = self.devices[deveui] = Device(deveui, addr)
+        dev.addr = addr
+        if dev.join_start is None:
+            dev.join_start = self.now()
+        if self.lost(phy[1]):
+            dev.lost += 1
+            self.log(f"{deveui.hex()} join request lost")
+            return
+        appkey = next((key for key in self.appkeys
+                       if cmac(key, frame[:19])[:4] == frame[19:]), None)
+        if appkey is None:
+            self.log(f"{deveui.hex()} join request with wrong MIC, "
+                     "check the AppKey")
+            return
+
+        devnonce = frame[17:19]
+        appnonce = os.urandom(3)
+        netid = bytes(3)
+        if dev.devaddr is None:
+            dev.devaddr = self.next_addr
+            self.next_addr += 1
+        self.by_addr[dev.devaddr] = dev
+        # DLSettings 0: RX1 at the data rate of the uplink, RX2 at DR0
+        body = appnonce + netid + struct.pack("<I", dev.devaddr) + \
+            bytes([0, RX_DELAY])
+        mhdr = bytes([JOIN_ACCEPT << 5])
+        mic = cmac(appkey, mhdr + body)[:4]
+        # the server encrypts with AES decrypt, so that the node can use
+        # AES encrypt to decrypt it
+        accept = mhdr + aes_decrypt(appkey, body + mic)
+
+        keys = appnonce + netid + devnonce
+        dev.nwkskey = aes_encrypt(appkey, b"\x01" + keys + bytes(7))
+        dev.appskey = aes_encrypt(appkey, b"\x02" + keys + bytes(7))
+        dev.fcnt_up = None
+        dev.fcnt_down = 0
+        dev.joins += 1
+        dev.downlinks = [(port, bytes.fromhex(data)) for port, data in
+                         self.args.downlink]
+        self.log(f"{deveui.hex()} joined as {dev.devaddr:08x} after "
+                 f"{self.now() - dev.join_start:.1f} s")
+        dev.join_start = None
+        self.send(dev, phy, accept)
+
+    def data(self, frame, addr, phy, toa):
+        devaddr, fctrl, fcnt16 = struct.unpack_from("<IBH", frame, 1)
+        dev = self.by_addr.get(devaddr)
+        if dev is None:
+            self.log(f"uplink of unknown device {devaddr:08x}, restart it "
+                     "to join again")
+            return
+        dev.addr = addr
+        confirmed = frame[0] >> 5 == CONFIRMED_UP
+        if self.lost(phy[1]):
+            dev.lost += 1
+            self.log(f"{dev.deveui.hex()} uplink lost")
+            self.record(dev, fcnt16, None, b"", phy, toa, confirmed, False)
+            return
+
+        # restore the upper bits of the frame counter
+        fcnt = fcnt16
+        if dev.fcnt_up is not None:
+            fcnt |= dev.fcnt_up & ~0xFFFF
+            if fcnt < dev.fcnt_up - 0x8000:
+                fcnt += 0x10000
+        msg, mic = frame[:-4], frame[-4:]
+        if frame_mic(dev.nwkskey, 0, devaddr, fcnt, msg) != mic:
+            self.log(f"{dev.deveui.hex()} uplink with wrong MIC")
+            return
+        if dev.fcnt_up is not None:
+            if fcnt <= dev.fcnt_up:
+                dev.duplicates += 1
+            else:
+                dev.missed += fcnt - dev.fcnt_up - 1
+        dev.fcnt_up = max(fcnt, dev.fcnt_up or 0)
+
+        fopts_len = fctrl & 0x0F
+        fopts = msg[8:8 + fopts_len]
+        port = None
+        payload = b""
+        if len(msg) > 8 + fopts_len:
+            port = msg[8 + fopts_len]
+            key = dev.nwkskey if port == 0 else dev.appskey
+            payload = frm_crypt(key, 0, devaddr, fcnt, msg[9 + fopts_len:])
+            if port == 0:
+                fopts = payload
+
+        dev.uplinks += 1
+        dev.confirmed += confirmed
+        dev.bytes += len(payload)
+        dev.airtime += toa
+        dev.first = dev.first if dev.first is not None else self.now()
+        dev.last = self.now()
+        self.log(f"{dev.deveui.hex()} fcnt {fcnt} port {port} SF{phy[1]} "
+                 f"{len(payload)} B {toa * 1000:.0f} ms: {payload.hex()}")
+        if self.args.journal and port:
+            self.ages(dev, payload)
+        self.record(dev, fcnt, port, payload, phy, toa, confirmed, True)
+
+        link_check = self.mac(fopts)
+        self.answer(dev, phy, confirmed, link_check)
+
+    def ages(self, dev, payload):
+        pos = 0
+        while pos + 3 <= len(payload):
+            length = payload[pos]
+            dev.latency.append(int.from_bytes(payload[pos + 1:pos + 3],
+                                              "big"))
+            pos += 3 + length
+
+    def mac(self, cmds):
+        """Returns whether the MAC commands contain a LinkCheckReq"""
+        link_check = False
+        pos = 0
+        while pos < len(cmds):
+            cid = cmds[pos]
+            if cid not in MAC_ANS_LEN:
+                break
+            link_check |= cid == 0x02
+            pos += 1 + MAC_ANS_LEN[cid]
+        return link_check
+
+    def answer(self, dev, phy, ack, link_check):
+        if not (ack or link_check or dev.downlinks):
+            return
+        fopts = b""
+        if link_check:
+            margin = self.args.snr - SNR_FLOOR.get(phy[1], 0)
+            fopts = bytes([0x02, max(0, min(254, int(margin))),
+                           self.args.gateways])
+        fctrl = (0x20 if ack else 0) | len(fopts)
+        fcnt = dev.fcnt_down
+        dev.fcnt_down += 1
+        msg = bytes([UNCONFIRMED_DOWN << 5]) + \
+            struct.pack("<IBH", dev.devaddr, fctrl, fcnt & 0xFFFF) + fopts
+        if dev.downlinks:
+            port, data = dev.downlinks.pop(0)
+            msg += bytes([port]) + \
+                frm_crypt(dev.appskey, 1, dev.devaddr, fcnt, data)
+        msg += frame_mic(dev.nwkskey, 1, dev.devaddr, fcnt, msg)
+        self.send(dev, phy, msg)
+
+    def record(self, dev, fcnt, port, payload, phy, toa, confirmed,
+               delivered):
+        if self.csv:
+            self.csv.write(f"{self.now():.3f},{dev.deveui.hex()},{fcnt},"
+                           f"{'' if port is None else port},{len(payload)},"
+                           f"{phy[1]},{toa:.4f},{int(confirmed)},"
+                           f"{int(delivered)}\n")
+            self.csv.flush()
+
+    def report_all(self):
+        for dev in self.devices.values():
+            self.log(dev.report())
+        self.at(self.args.report, self.report_all)
+
+
+def _downlink(arg):
+    port, _, data = arg.partition(":")
+    bytes.fromhex(data)
+    if not 1 <= int(port) <= 223:
+        raise ValueError("port out of range")
+    return int(port), data
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__.split("\n\n")[0])
+    parser.add_argument("--port", type=int, default=17000,
+                        help="UDP port, LORA_SIM_PORT of the nodes")
+    parser.add_argument("--appkey", action="append",
+                        help="AppKey of nodes in hex, may be repeated")
+    parser.add_argument("--snr", type=float, default=10,
+                        help="SNR of the link in dB, frames at spreading "
+                             "factors that need more are lost")
+    parser.add_argument("--loss", type=float, default=0,
+                        help="probability that a frame is lost")
+    parser.add_argument("--gateways", type=int, default=1,
+                        help="gateways reported in LinkCheckAns")
+    parser.add_argument("--downlink", type=_downlink, action="append",
+                        default=[], metavar="PORT:HEX",
+                        help="downlink queued for each device after its "
+                             "join, may be repeated")
+    parser.add_argument("--journal", action="store_true",
+                        help="uplinks carry uplink_journal records, report "
+                             "their age as latency")
+    parser.add_argument("--report", type=float, default=60,
+                        help="interval of the report in s")
+    parser.add_argument("--csv", help="write each uplink to a CSV file")
+    parser.add_argument("--seed", type=int, help="seed of the frame loss")
+    args = parser.parse_args()
+    if args.seed is not None:
+        random.seed(args.seed)
+
+    server = Server(args)
+    signal.signal(signal.SIGTERM, lambda *_: sys.exit(0))
+    print(f"listening on 127.0.0.1:{args.port}", flush=True)
+    try:
+        server.run()
+    except (KeyboardInterrupt, SystemExit):
+        pass
+    for dev in server.devices.values():
+        print(dev.report())
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,401 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     netdev_lora_sim
+ * @{
+ *
+ * @file
+ * @brief       Simulated LoRa radio implementation
+ *
+ * @}
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "assert.h"
+#include "async_read.h"
+#include "byteorder.h"
+#include "irq.h"
+#include "kernel_defines.h"
+#include "lorawan_airtime.h"
+#include "native_internal.h"
+#include "net/gnrc/netif/lorawan_base.h"
+#include "net/lora.h"
+#include "net/netdev/lora.h"
+#include "netdev_lora_sim.h"
+#include "random.h"
+
+#define ENABLE_DEBUG 0
+#include "debug.h"
+
+/* events for the netdev ISR */
+#define EV_TX_DONE      (1U << 0)
+#define EV_RX_DONE      (1U << 1)
+#define EV_RX_TIMEOUT   (1U << 2)
+
+static netdev_lora_sim_t _dev;
+static gnrc_netif_t _netif;
+static char _stack[THREAD_STACKSIZE_DEFAULT];
+
+static uint16_t _bw_khz(uint8_t bw)
+{
+    return 125U << bw;
+}
+
+/* Duration of a symbol in us */
+static uint32_t _symbol(const netdev_lora_sim_phy_t *phy)
+{
+    return ((uint32_t)US_PER_MS << phy->sf) / _bw_khz(phy->bw);
+}
+
+/* Runs in interrupt context, hands the events to the netdev ISR */
+static void _signal(netdev_lora_sim_t *dev, uint8_t event)
+{
+    dev->pending |= event;
+    dev->netdev.event_callback(&dev->netdev, NETDEV_EVENT_ISR);
+}
+
+static void _timer_cb(void *arg)
+{
+    netdev_lora_sim_t *dev = arg;
+
+    switch (dev->state) {
+    case NETOPT_STATE_TX:
+        _signal(dev, EV_TX_DONE);
+        break;
+    case NETOPT_STATE_RX:
+        _signal(dev, dev->rx_busy ? EV_RX_DONE : EV_RX_TIMEOUT);
+        break;
+    default:
+        break;
+    }
+}
+
+static bool _match(const netdev_lora_sim_t *dev)
+{
+    return dev->rx_len && dev->iq_invert &&
+           dev->rx_phy.freq == dev->phy.freq &&
+           dev->rx_phy.sf == dev->phy.sf && dev->rx_phy.bw == dev->phy.bw;
+}
+
+/* Starts receiving the kept downlink if the window matches it, otherwise
+ * arms the symbol timeout of a single receive window */
+static void _rx_start(netdev_lora_sim_t *dev)
+{
+    if (_match(dev)) {
+        dev->rx_busy = true;
+        ztimer_set(ZTIMER_USEC, &dev->timer,
+                   lorawan_airtime_lora(dev->phy.sf, _bw_khz(dev->phy.bw),
+                                        dev->rx_len));
+    }
+    else if (dev->single) {
+        ztimer_set(ZTIMER_USEC, &dev->timer,
+                   (uint32_t)dev->symbols * _symbol(&dev->phy));
+    }
+}
+
+/* Runs in interrupt context when a datagram arrived */
+static void _sock_cb(int fd, void *arg)
+{
+    netdev_lora_sim_t *dev = arg;
+    uint8_t buf[NETDEV_LORA_SIM_HDR_LEN + NETDEV_LORA_SIM_FRAME_MAX];
+
+    ssize_t len = real_recv(fd, buf, sizeof(buf), 0);
+    if (len > (ssize_t)NETDEV_LORA_SIM_HDR_LEN &&
+        buf[0] == NETDEV_LORA_SIM_DOWNLINK && !dev->rx_busy) {
+        dev->rx_phy.freq = byteorder_bebuftohl(&buf[1]);
+        dev->rx_phy.sf = buf[5];
+        dev->rx_phy.bw = buf[6];
+        dev->rx_snr = (int8_t)buf[7];
+        dev->rx_len = (uint8_t)(len - NETDEV_LORA_SIM_HDR_LEN);
+        memcpy(dev->rx_buf, &buf[NETDEV_LORA_SIM_HDR_LEN], dev->rx_len);
+        DEBUG("netdev_lora_sim: downlink of %u bytes\n", dev->rx_len);
+
+        /* a continuous receiver takes it right away */
+        if (dev->state == NETOPT_STATE_RX && !dev->single) {
+            _rx_start(dev);
+        }
+    }
+    native_async_read_continue(fd);
+}
+
+static int _send(netdev_t *netdev, const iolist_t *iolist)
+{
+    netdev_lora_sim_t *dev = container_of(netdev, netdev_lora_sim_t, netdev);
+    uint8_t buf[NETDEV_LORA_SIM_HDR_LEN + NETDEV_LORA_SIM_FRAME_MAX];
+    size_t len = 0;
+
+    for (const iolist_t *iol = iolist; iol; iol = iol->iol_next) {
+        if (len + iol->iol_len > NETDEV_LORA_SIM_FRAME_MAX) {
+            return -EOVERFLOW;
+        }
+        memcpy(&buf[NETDEV_LORA_SIM_HDR_LEN + len], iol->iol_base,
+               iol->iol_len);
+        len += iol->iol_len;
+    }
+
+    buf[0] = NETDEV_LORA_SIM_UPLINK;
+    byteorder_htobebufl(&buf[1], dev->phy.freq);
+    buf[5] = dev->phy.sf;
+    buf[6] = dev->phy.bw;
+    buf[7] = 0;
+
+    /* a downlink that was not received is gone */
+    unsigned state = irq_disable();
+    ztimer_remove(ZTIMER_USEC, &dev->timer);
+    dev->rx_len = 0;
+    dev->rx_busy = false;
+    dev->state = NETOPT_STATE_TX;
+    irq_restore(state);
+
+    if (real_send(dev->sock, buf, NETDEV_LORA_SIM_HDR_LEN + len, 0) < 0) {
+        DEBUG("netdev_lora_sim: emulator not reachable\n");
+    }
+
+    /* the radio is busy for the time-on-air of the frame */
+    ztimer_set(ZTIMER_USEC, &dev->timer,
+               lorawan_airtime_lora(dev->phy.sf, _bw_khz(dev->phy.bw), len));
+    return len;
+}
+
+static int _recv(netdev_t *netdev, void *buf, size_t len, void *info)
+{
+    netdev_lora_sim_t *dev = container_of(netdev, netdev_lora_sim_t, netdev);
+    size_t size = dev->rx_busy ? dev->rx_len : 0;
+
+    if (!buf) {
+        if (len) {
+            /* drop the frame */
+            dev->rx_len = 0;
+            dev->rx_busy = false;
+        }
+        return size;
+    }
+    if (len < size) {
+        return -ENOBUFS;
+    }
+
+    memcpy(buf, dev->rx_buf, size);
+    if (info) {
+        netdev_lora_rx_info_t *rx_info = info;
+        rx_info->snr = dev->rx_snr;
+        /* the emulator only gives the SNR, assume a noise floor of a
+         * 125 kHz channel */
+        rx_info->rssi = -117 + dev->rx_snr;
+    }
+    dev->rx_len = 0;
+    dev->rx_busy = false;
+    return size;
+}
+
+static int _init(netdev_t *netdev)
+{
+    netdev_lora_sim_t *dev = container_of(netdev, netdev_lora_sim_t, netdev);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_NETDEV_LORA_SIM_PORT),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+
+    dev->sock = real_socket(AF_INET, SOCK_DGRAM, 0);
+    if (dev->sock < 0 ||
+        real_connect(dev->sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        return -EIO;
+    }
+
+    native_async_read_setup();
+    native_async_read_add_handler(dev->sock, dev, _sock_cb);
+
+    dev->timer.callback = _timer_cb;
+    dev->timer.arg = dev;
+    dev->state = NETOPT_STATE_STANDBY;
+    dev->phy = (netdev_lora_sim_phy_t){
+        .freq = 868100000LU, .sf = LORA_SF12, .bw = LORA_BW_125_KHZ,
+    };
+    dev->cr = LORA_CR_4_5;
+
+    netdev->event_callback(netdev, NETDEV_EVENT_LINK_UP);
+    return 0;
+}
+
+static void _isr(netdev_t *netdev)
+{
+    netdev_lora_sim_t *dev = container_of(netdev, netdev_lora_sim_t, netdev);
+
+    unsigned state = irq_disable();
+    uint8_t pending = dev->pending;
+    dev->pending = 0;
+    irq_restore(state);
+
+    if (pending & EV_TX_DONE) {
+        dev->state = NETOPT_STATE_STANDBY;
+        netdev->event_callback(netdev, NETDEV_EVENT_TX_COMPLETE);
+    }
+    if (pending & EV_RX_DONE) {
+        if (dev->single) {
+            dev->state = NETOPT_STATE_STANDBY;
+        }
+        netdev->event_callback(netdev, NETDEV_EVENT_RX_COMPLETE);
+    }
+    if (pending & EV_RX_TIMEOUT) {
+        dev->state = NETOPT_STATE_STANDBY;
+        netdev->event_callback(netdev, NETDEV_EVENT_RX_TIMEOUT);
+    }
+}
+
+static int _get(netdev_t *netdev, netopt_t opt, void *val, size_t max_len)
+{
+    netdev_lora_sim_t *dev = container_of(netdev, netdev_lora_sim_t, netdev);
+
+    switch (opt) {
+    case NETOPT_DEVICE_TYPE:
+        assert(max_len >= sizeof(uint16_t));
+        *(uint16_t *)val = NETDEV_TYPE_LORA;
+        return sizeof(uint16_t);
+    case NETOPT_STATE:
+        assert(max_len >= sizeof(netopt_state_t));
+        *(netopt_state_t *)val = dev->state;
+        return sizeof(netopt_state_t);
+    case NETOPT_CHANNEL_FREQUENCY:
+        assert(max_len >= sizeof(uint32_t));
+        *(uint32_t *)val = dev->phy.freq;
+        return sizeof(uint32_t);
+    case NETOPT_SPREADING_FACTOR:
+        assert(max_len >= sizeof(uint8_t));
+        *(uint8_t *)val = dev->phy.sf;
+        return sizeof(uint8_t);
+    case NETOPT_BANDWIDTH:
+        assert(max_len >= sizeof(uint8_t));
+        *(uint8_t *)val = dev->phy.bw;
+        return sizeof(uint8_t);
+    case NETOPT_CODING_RATE:
+        assert(max_len >= sizeof(uint8_t));
+        *(uint8_t *)val = dev->cr;
+        return sizeof(uint8_t);
+    case NETOPT_MAX_PDU_SIZE:
+        assert(max_len >= sizeof(uint16_t));
+        *(uint16_t *)val = NETDEV_LORA_SIM_FRAME_MAX;
+        return sizeof(uint16_t);
+    case NETOPT_RANDOM:
+        assert(max_len >= sizeof(uint32_t));
+        *(uint32_t *)val = random_uint32();
+        return sizeof(uint32_t);
+    default:
+        return -ENOTSUP;
+    }
+}
+
+static int _set_state(netdev_lora_sim_t *dev, netopt_state_t state)
+{
+    unsigned irq = irq_disable();
+    ztimer_remove(ZTIMER_USEC, &dev->timer);
+    dev->rx_busy = false;
+    irq_restore(irq);
+
+    switch (state) {
+    case NETOPT_STATE_RX:
+    case NETOPT_STATE_IDLE:
+        dev->state = NETOPT_STATE_RX;
+        _rx_start(dev);
+        break;
+    case NETOPT_STATE_SLEEP:
+    case NETOPT_STATE_STANDBY:
+    case NETOPT_STATE_OFF:
+        dev->state = state;
+        break;
+    case NETOPT_STATE_RESET:
+        dev->state = NETOPT_STATE_STANDBY;
+        dev->rx_len = 0;
+        break;
+    default:
+        return -ENOTSUP;
+    }
+    return sizeof(netopt_state_t);
+}
+
+static int _set(netdev_t *netdev, netopt_t opt, const void *val, size_t len)
+{
+    netdev_lora_sim_t *dev = container_of(netdev, netdev_lora_sim_t, netdev);
+
+    switch (opt) {
+    case NETOPT_STATE:
+        assert(len == sizeof(netopt_state_t));
+        return _set_state(dev, *(const netopt_state_t *)val);
+    case NETOPT_CHANNEL_FREQUENCY:
+        assert(len == sizeof(uint32_t));
+        dev->phy.freq = *(const uint32_t *)val;
+        return len;
+    case NETOPT_SPREADING_FACTOR:
+        assert(len == sizeof(uint8_t));
+        dev->phy.sf = *(const uint8_t *)val;
+        return len;
+    case NETOPT_BANDWIDTH:
+        assert(len == sizeof(uint8_t));
+        dev->phy.bw = *(const uint8_t *)val;
+        return len;
+    case NETOPT_CODING_RATE:
+        assert(len == sizeof(uint8_t));
+        dev->cr = *(const uint8_t *)val;
+        return len;
+    case NETOPT_IQ_INVERT:
+        dev->iq_invert = *(const netopt_enable_t *)val == NETOPT_ENABLE;
+        return len;
+    case NETOPT_SINGLE_RECEIVE:
+        dev->single = *(const netopt_enable_t *)val == NETOPT_ENABLE;
+        return len;
+    case NETOPT_RX_SYMBOL_TIMEOUT:
+        assert(len == sizeof(uint16_t));
+        dev->symbols = *(const uint16_t *)val;
+        return len;
+    /* accepted, but without effect on the simulation */
+    case NETOPT_TX_POWER:
+    case NETOPT_SYNCWORD:
+    case NETOPT_PREAMBLE_LENGTH:
+    case NETOPT_INTEGRITY_CHECK:
+    case NETOPT_FIXED_HEADER:
+    case NETOPT_CHANNEL_HOP:
+    case NETOPT_RX_TIMEOUT:
+    case NETOPT_TX_TIMEOUT:
+        return len;
+    default:
+        return -ENOTSUP;
+    }
+}
+
+static const netdev_driver_t _driver = {
+    .send = _send,
+    .recv = _recv,
+    .init = _init,
+    .isr = _isr,
+    .get = _get,
+    .set = _set,
+};
+
+void netdev_lora_sim_setup(netdev_lora_sim_t *dev)
+{
+    memset(dev, 0, sizeof(*dev));
+    dev->netdev.driver = &_driver;
+    dev->sock = -1;
+}
+
+gnrc_netif_t *netdev_lora_sim_auto_init(void)
+{
+    netdev_lora_sim_setup(&_dev);
+    if (gnrc_netif_lorawan_create(&_netif, _stack, sizeof(_stack),
+                                  GNRC_NETIF_PRIO, "lora_sim",
+                                  &_dev.netdev) < 0) {
+        return NULL;
+    }
+    return &_netif;
+}
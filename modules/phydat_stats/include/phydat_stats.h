@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    phydat_stats Streaming statistics of phydat values
+ * @brief       Running and windowed statistics of sensor readings
+ *
+ * Keeps for each dimension of a stream of @ref phydat_t values:
+ *
+ * - minimum, maximum, mean and variance since the last reset
+ * - an exponentially weighted moving average (EWMA)
+ * - minimum, maximum and mean of fixed, consecutive time windows
+ *
+ * Adding a sample takes constant time and only needs integer additions,
+ * multiplications and comparisons. The divisions needed for mean and variance
+ * are done when they are queried. No floating point is used.
+ *
+ * The module also offers a hysteresis comparator, which reports a change only
+ * once a value left a band around the threshold, so that noise around the
+ * threshold does not cause a stream of events.
+ * @{
+ *
+ * @file
+ * @brief       Streaming statistics definitions
+ */
+
+#ifndef PHYDAT_STATS_H
+#define PHYDAT_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "phydat.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Weight of a new sample in the EWMA, as power of two:
+ *          alpha = 2^-CONFIG_PHYDAT_STATS_EWMA_SHIFT
+ */
+#ifndef CONFIG_PHYDAT_STATS_EWMA_SHIFT
+#define CONFIG_PHYDAT_STATS_EWMA_SHIFT  (3U)
+#endif
+
+/**
+ * @brief   Fractional bits of the EWMA
+ */
+#define PHYDAT_STATS_FRAC_BITS          (8U)
+
+/**
+ * @brief   Aggregate of one time window
+ */
+typedef struct {
+    uint16_t count;                 /**< samples in the window */
+    int16_t min[PHYDAT_DIM];        /**< minimum per dimension */
+    int16_t max[PHYDAT_DIM];        /**< maximum per dimension */
+    int32_t sum[PHYDAT_DIM];        /**< sum per dimension */
+} phydat_stats_window_t;
+
+/**
+ * @brief   Statistics of one stream of values
+ *
+ * All values are kept at the scale of the first sample.
+ */
+typedef struct {
+    uint32_t count;                 /**< samples since the reset */
+    uint8_t dims;                   /**< dimensions of the values */
+    uint8_t unit;                   /**< unit of the values */
+    int8_t scale;                   /**< scale of the values */
+    int16_t min[PHYDAT_DIM];        /**< minimum per dimension */
+    int16_t max[PHYDAT_DIM];        /**< maximum per dimension */
+    int16_t offset[PHYDAT_DIM];     /**< first value per dimension, the
+                                         sums are kept relative to it */
+    int64_t sum[PHYDAT_DIM];        /**< sum per dimension */
+    uint64_t sumsq[PHYDAT_DIM];     /**< sum of squares per dimension */
+    int32_t ewma[PHYDAT_DIM];       /**< EWMA, PHYDAT_STATS_FRAC_BITS
+                                         fractional bits */
+    uint32_t window;                /**< length of a window, 0 for none */
+    uint32_t window_start;          /**< start of the current window */
+    phydat_stats_window_t cur;      /**< aggregate of the current window */
+    phydat_stats_window_t last;     /**< aggregate of the last full window */
+} phydat_stats_t;
+
+/**
+ * @brief   Statistics of one dimension, converted to phydat values
+ *
+ * The mean, standard deviation and EWMA carry one more decimal than the
+ * samples.
+ */
+typedef struct {
+    phydat_t min;                   /**< minimum */
+    phydat_t max;                   /**< maximum */
+    phydat_t mean;                  /**< mean */
+    phydat_t stddev;                /**< standard deviation */
+    phydat_t ewma;                  /**< EWMA */
+} phydat_stats_summary_t;
+
+/**
+ * @brief   Hysteresis comparator
+ */
+typedef struct {
+    int16_t high;                   /**< the state turns on at or above */
+    int16_t low;                    /**< the state turns off below */
+    bool on;                        /**< current state */
+} phydat_stats_hyst_t;
+
+/**
+ * @brief   Initializes or resets statistics
+ *
+ * @param[out] stats    statistics to initialize
+ * @param[in]  window   length of the aggregation windows, 0 for none
+ * @param[in]  now      current time, in the unit of @p window
+ */
+void phydat_stats_init(phydat_stats_t *stats, uint32_t window, uint32_t now);
+
+/**
+ * @brief   Adds a sample
+ *
+ * Values at a different scale than the first sample are converted.
+ *
+ * @param[in,out] stats     statistics
+ * @param[in]     data      sample
+ * @param[in]     dims      valid dimensions of @p data
+ * @param[in]     now       time of the sample, in the unit of the window
+ */
+void phydat_stats_add(phydat_stats_t *stats, const phydat_t *data,
+                      uint8_t dims, uint32_t now);
+
+/**
+ * @brief   Returns the variance of one dimension since the reset
+ *
+ * @return  variance at the scale of the samples, squared, with
+ *          2 * PHYDAT_STATS_FRAC_BITS fractional bits
+ */
+uint64_t phydat_stats_variance(const phydat_stats_t *stats, unsigned dim);
+
+/**
+ * @brief   Summarizes one dimension since the reset
+ *
+ * @return  false if there were no samples
+ */
+bool phydat_stats_summary(const phydat_stats_t *stats, unsigned dim,
+                          phydat_stats_summary_t *summary);
+
+/**
+ * @brief   Summarizes one dimension of the last full window
+ *
+ * Only minimum, maximum and mean are set.
+ *
+ * @return  false if no window was completed yet
+ */
+bool phydat_stats_window(const phydat_stats_t *stats, unsigned dim,
+                         phydat_stats_summary_t *summary);
+
+/**
+ * @brief   Initializes a hysteresis comparator, the state starts off
+ *
+ * @param[out] hyst     comparator
+ * @param[in]  high     value at which the state turns on
+ * @param[in]  low      value below which the state turns off, <= @p high
+ */
+void phydat_stats_hyst_init(phydat_stats_hyst_t *hyst, int16_t high,
+                            int16_t low);
+
+/**
+ * @brief   Feeds a value to a hysteresis comparator
+ *
+ * @return  true if the state changed
+ */
+bool phydat_stats_hyst_update(phydat_stats_hyst_t *hyst, int16_t value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PHYDAT_STATS_H */
+/** @} */
@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     phydat_stats
+ * @{
+ *
+ * @file
+ * @brief       Streaming statistics implementation
+ *
+ * @}
+ */
+
+#include <string.h>
+
+#include "kernel_defines.h"
+#include "phydat_stats.h"
+
+#define FRAC_ONE        (1L << PHYDAT_STATS_FRAC_BITS)
+
+static int16_t _clamp(int32_t value)
+{
+    if (value > PHYDAT_MAX) {
+        return PHYDAT_MAX;
+    }
+    if (value < PHYDAT_MIN) {
+        return PHYDAT_MIN;
+    }
+    return value;
+}
+
+/* converts a value from one scale to another */
+static int16_t _rescale(int32_t value, int8_t from, int8_t to)
+{
+    for (; from > to && value >= PHYDAT_MIN && value <= PHYDAT_MAX; from--) {
+        value *= 10;
+    }
+    for (; from < to; from++) {
+        value /= 10;
+    }
+    return _clamp(value);
+}
+
+/* integer square root, rounded down */
+static uint32_t _isqrt(uint64_t value)
+{
+    uint64_t root = 0;
+    uint64_t bit = 1ULL << 62;
+
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+/* sets a phydat value from a value with one more decimal than the samples */
+static void _set_decimal(phydat_t *dst, const phydat_stats_t *stats,
+                         int32_t value)
+{
+    memset(dst, 0, sizeof(*dst));
+    dst->unit = stats->unit;
+    dst->scale = stats->scale - 1;
+    phydat_fit(dst, &value, 1);
+}
+
+static void _set(phydat_t *dst, const phydat_stats_t *stats, int16_t value)
+{
+    memset(dst, 0, sizeof(*dst));
+    dst->val[0] = value;
+    dst->unit = stats->unit;
+    dst->scale = stats->scale;
+}
+
+static void _window_add(phydat_stats_window_t *window, const int16_t *values,
+                        uint8_t dims)
+{
+    /* the sums of a window are 32 bit wide, a full window takes no more */
+    if (window->count == UINT16_MAX) {
+        return;
+    }
+    for (unsigned d = 0; d < dims; d++) {
+        if (!window->count || values[d] < window->min[d]) {
+            window->min[d] = values[d];
+        }
+        if (!window->count || values[d] > window->max[d]) {
+            window->max[d] = values[d];
+        }
+        window->sum[d] += values[d];
+    }
+    window->count++;
+}
+
+void phydat_stats_init(phydat_stats_t *stats, uint32_t window, uint32_t now)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->window = window;
+    stats->window_start = now;
+}
+
+void phydat_stats_add(phydat_stats_t *stats, const phydat_t *data,
+                      uint8_t dims, uint32_t now)
+{
+    int16_t values[PHYDAT_DIM];
+
+    if (stats->count == 0) {
+        stats->dims = dims;
+        stats->unit = data->unit;
+        stats->scale = data->scale;
+    }
+    dims = MIN(dims, stats->dims);
+
+    for (unsigned d = 0; d < dims; d++) {
+        int16_t value = _rescale(data->val[d], data->scale, stats->scale);
+        int32_t fixed = (int32_t)value * FRAC_ONE;
+
+        if (stats->count == 0) {
+            stats->min[d] = value;
+            stats->max[d] = value;
+            stats->ewma[d] = fixed;
+            stats->offset[d] = value;
+        }
+        else {
+            stats->min[d] = MIN(stats->min[d], value);
+            stats->max[d] = MAX(stats->max[d], value);
+            stats->ewma[d] += (fixed - stats->ewma[d]) /
+                              (1L << CONFIG_PHYDAT_STATS_EWMA_SHIFT);
+        }
+        int32_t diff = (int32_t)value - stats->offset[d];
+        stats->sum[d] += diff;
+        stats->sumsq[d] += (uint64_t)((int64_t)diff * diff);
+        values[d] = value;
+    }
+    stats->count++;
+
+    if (stats->window) {
+        uint32_t elapsed = now - stats->window_start;
+        if (elapsed >= stats->window) {
+            /* empty windows in between leave an empty last window */
+            stats->last = (elapsed < 2 * stats->window)
+                        ? stats->cur : (phydat_stats_window_t){ 0 };
+            memset(&stats->cur, 0, sizeof(stats->cur));
+            stats->window_start += elapsed - elapsed % stats->window;
+        }
+        _window_add(&stats->cur, values, dims);
+    }
+}
+
+uint64_t phydat_stats_variance(const phydat_stats_t *stats, unsigned dim)
+{
+    if (stats->count == 0 || dim >= stats->dims) {
+        return 0;
+    }
+
+    /* E[x^2] - E[x]^2 of the values relative to the first one, which keeps
+     * both terms small, with the fractional bits applied before dividing */
+    int64_t mean = stats->sum[dim] * FRAC_ONE / (int64_t)stats->count;
+    uint64_t mean_sq = (uint64_t)(mean * mean);
+    uint64_t sq_mean = stats->sumsq[dim];
+    if (sq_mean < (UINT64_MAX >> (2 * PHYDAT_STATS_FRAC_BITS))) {
+        sq_mean = (sq_mean << (2 * PHYDAT_STATS_FRAC_BITS)) / stats->count;
+    }
+    else {
+        sq_mean = (sq_mean / stats->count) << (2 * PHYDAT_STATS_FRAC_BITS);
+    }
+
+    return (sq_mean > mean_sq) ? sq_mean - mean_sq : 0;
+}
+
+bool phydat_stats_summary(const phydat_stats_t *stats, unsigned dim,
+                          phydat_stats_summary_t *summary)
+{
+    if (stats->count == 0 || dim >= stats->dims) {
+        return false;
+    }
+
+    _set(&summary->min, stats, stats->min[dim]);
+    _set(&summary->max, stats, stats->max[dim]);
+    _set_decimal(&summary->mean, stats, stats->offset[dim] * 10 +
+                 stats->sum[dim] * 10 / (int64_t)stats->count);
+
+    uint32_t stddev = _isqrt(phydat_stats_variance(stats, dim));
+    _set_decimal(&summary->stddev, stats,
+                 ((uint64_t)stddev * 10 + FRAC_ONE / 2) >> PHYDAT_STATS_FRAC_BITS);
+    _set_decimal(&summary->ewma, stats, stats->ewma[dim] * 10 / FRAC_ONE);
+    return true;
+}
+
+bool phydat_stats_window(const phydat_stats_t *stats, unsigned dim,
+                         phydat_stats_summary_t *summary)
+{
+    const phydat_stats_window_t *last = &stats->last;
+
+    if (last->count == 0 || dim >= stats->dims) {
+        return false;
+    }
+
+    memset(summary, 0, sizeof(*summary));
+    _set(&summary->min, stats, last->min[dim]);
+    _set(&summary->max, stats, last->max[dim]);
+    _set_decimal(&summary->mean, stats,
+                 (int64_t)last->sum[dim] * 10 / last->count);
+    return true;
+}
+
+void phydat_stats_hyst_init(phydat_stats_hyst_t *hyst, int16_t high,
+                            int16_t low)
+{
+    hyst->high = high;
+    hyst->low = MIN(low, high);
+    hyst->on = false;
+}
+
+bool phydat_stats_hyst_update(phydat_stats_hyst_t *hyst, int16_t value)
+{
+    bool on = hyst->on ? (value >= hyst->low) : (value >= hyst->high);
+
+    if (on == hyst->on) {
+        return false;
+    }
+    hyst->on = on;
+    return true;
+}
@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    phydat_ts Compressed time series of phydat values
+ * @brief       Stores sensor history in little RAM
+ *
+ * Samples are appended to fixed-size blocks. The first sample of a block is
+ * stored as is, each following one as the delta-of-delta of its time stamp
+ * and of each dimension, as zig-zag encoded varint. Sensors sampled at a fixed
+ * period with slowly changing values mostly produce deltas-of-deltas of 0,
+ * which take one byte each.
+ *
+ * The store keeps a ring of blocks given by the application. When all blocks
+ * are full the oldest one is dropped, or, if a flash region was configured
+ * with @ref phydat_ts_spill, written to flash first. Spilled blocks are read
+ * back by queries and dropped in turn when the flash region is full. On the
+ * `native` board the `mtd_native` device stores them in a file.
+ *
+ * The store is not thread safe, callers have to serialize access.
+ * @{
+ *
+ * @file
+ * @brief       Time series store definitions
+ */
+
+#ifndef PHYDAT_TS_H
+#define PHYDAT_TS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kernel_defines.h"
+#include "phydat.h"
+#if IS_USED(MODULE_MTD)
+#include "mtd.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Size of a block including its header, in bytes
+ */
+#ifndef CONFIG_PHYDAT_TS_BLOCK_SIZE
+#define CONFIG_PHYDAT_TS_BLOCK_SIZE     (256U)
+#endif
+
+/**
+ * @brief   Header of a block
+ */
+typedef struct {
+    uint32_t first;             /**< time stamp of the first sample */
+    uint32_t last;              /**< time stamp of the last sample */
+    uint16_t count;             /**< number of samples */
+    uint16_t len;               /**< bytes of encoded data */
+    uint8_t dims;               /**< dimensions of the samples */
+    uint8_t unit;               /**< unit of the samples */
+    int8_t scale;               /**< scale of the samples */
+    int16_t val[PHYDAT_DIM];    /**< values of the first sample */
+} phydat_ts_block_hdr_t;
+
+/**
+ * @brief   Bytes of encoded data a block can hold
+ */
+#define PHYDAT_TS_BLOCK_DATA    (CONFIG_PHYDAT_TS_BLOCK_SIZE - \
+                                 sizeof(phydat_ts_block_hdr_t))
+
+/**
+ * @brief   A block of samples
+ */
+typedef struct {
+    phydat_ts_block_hdr_t hdr;              /**< header */
+    uint8_t data[PHYDAT_TS_BLOCK_DATA];     /**< encoded samples */
+} phydat_ts_block_t;
+
+/**
+ * @brief   Delta encoding state of the last sample
+ */
+typedef struct {
+    uint32_t time;                  /**< time stamp */
+    int32_t dtime;                  /**< delta of the time stamp */
+    int16_t val[PHYDAT_DIM];        /**< values */
+    int32_t dval[PHYDAT_DIM];       /**< deltas of the values */
+} phydat_ts_delta_t;
+
+/**
+ * @brief   Blocks spilled to flash
+ */
+typedef struct {
+#if IS_USED(MODULE_MTD) || DOXYGEN
+    mtd_dev_t *mtd;                 /**< flash device, NULL if not used */
+#endif
+    uint32_t sector;                /**< first sector of the region */
+    uint32_t slots;                 /**< blocks the region can hold */
+    uint32_t slots_per_sector;      /**< blocks per sector */
+    uint32_t pages_per_slot;        /**< pages per block */
+    uint32_t first;                 /**< slot of the oldest block */
+    uint32_t count;                 /**< blocks in the region */
+    uint32_t samples;               /**< samples in the region */
+    uint32_t bytes;                 /**< bytes used by these samples */
+} phydat_ts_spill_t;
+
+/**
+ * @brief   A time series store
+ */
+typedef struct {
+    phydat_ts_block_t *blocks;      /**< ring of blocks in RAM */
+    unsigned num;                   /**< number of blocks in the ring */
+    unsigned first;                 /**< index of the oldest block */
+    unsigned used;                  /**< blocks in use, the last one is
+                                         appended to */
+    phydat_ts_delta_t prev;         /**< encoding state of the last block */
+    phydat_ts_spill_t spill;        /**< blocks spilled to flash */
+    uint32_t dropped;               /**< samples dropped with old blocks */
+} phydat_ts_t;
+
+/**
+ * @brief   Iterator over a time range
+ */
+typedef struct {
+    const phydat_ts_t *ts;          /**< store */
+    uint32_t from;                  /**< first time stamp of the range */
+    uint32_t to;                    /**< last time stamp of the range */
+    uint32_t block;                 /**< current block, spilled ones first */
+    const phydat_ts_block_t *blk;   /**< current block, NULL before the
+                                         first one */
+    uint16_t pos;                   /**< read offset in the block data */
+    uint16_t idx;                   /**< index of the next sample */
+    phydat_ts_delta_t prev;         /**< decoding state */
+#if IS_USED(MODULE_MTD) || DOXYGEN
+    phydat_ts_block_t buf;          /**< spilled block read back */
+#endif
+} phydat_ts_iter_t;
+
+/**
+ * @brief   Usage of a store
+ */
+typedef struct {
+    uint32_t samples;               /**< samples stored */
+    uint32_t bytes;                 /**< bytes used by the samples, including
+                                         the block headers */
+    uint32_t first;                 /**< time stamp of the oldest sample */
+    uint32_t last;                  /**< time stamp of the newest sample */
+    uint32_t blocks;                /**< blocks in RAM */
+    uint32_t spilled;               /**< blocks in flash */
+} phydat_ts_usage_t;
+
+/**
+ * @brief   Initializes a store
+ *
+ * @param[out] ts       store
+ * @param[in]  blocks   blocks to use
+ * @param[in]  num      number of blocks, at least 1
+ */
+void phydat_ts_init(phydat_ts_t *ts, phydat_ts_block_t *blocks, unsigned num);
+
+#if IS_USED(MODULE_MTD) || DOXYGEN
+/**
+ * @brief   Spills blocks that would be dropped to a flash region
+ *
+ * The region is considered empty, it is erased sector by sector as it is
+ * written.
+ *
+ * @param[in,out] ts        store
+ * @param[in]     mtd       flash device
+ * @param[in]     sector    first sector of the region
+ * @param[in]     sectors   number of sectors of the region
+ *
+ * @return  0 on success
+ * @return  -EINVAL if a sector is smaller than a block
+ */
+int phydat_ts_spill(phydat_ts_t *ts, mtd_dev_t *mtd, uint32_t sector,
+                    uint32_t sectors);
+#endif
+
+/**
+ * @brief   Appends a sample
+ *
+ * Time stamps have to increase. They are compared across a wrap of the
+ * clock, e.g. of ZTIMER_MSEC after 49.7 days, so the samples of a store and
+ * a queried range must span less than 2^31 ticks. A sample of another unit,
+ * scale or number of dimensions than the previous one starts a new block.
+ *
+ * @param[in,out] ts    store
+ * @param[in]     time  time stamp of the sample
+ * @param[in]     data  sample
+ * @param[in]     dims  valid dimensions of @p data
+ *
+ * @return  0 on success
+ * @return  -EINVAL if @p time is before the last time stamp
+ */
+int phydat_ts_append(phydat_ts_t *ts, uint32_t time, const phydat_t *data,
+                     uint8_t dims);
+
+/**
+ * @brief   Starts iterating over the samples of a time range, oldest first
+ *
+ * Appending to the store invalidates the iterator.
+ *
+ * @param[in]  ts       store
+ * @param[out] it       iterator
+ * @param[in]  from     first time stamp of the range
+ * @param[in]  to       last time stamp of the range
+ */
+void phydat_ts_iter_init(const phydat_ts_t *ts, phydat_ts_iter_t *it,
+                         uint32_t from, uint32_t to);
+
+/**
+ * @brief   Returns the next sample of the range
+ *
+ * @param[in,out] it    iterator
+ * @param[out]    time  time stamp of the sample
+ * @param[out]    data  sample
+ *
+ * @return  number of dimensions of the sample
+ * @return  0 at the end of the range
+ * @return  negative errno value if a spilled block could not be read
+ */
+int phydat_ts_iter_next(phydat_ts_iter_t *it, uint32_t *time, phydat_t *data);
+
+/**
+ * @brief   Copies the samples of a time range
+ *
+ * @param[in]  ts       store
+ * @param[in]  from     first time stamp of the range
+ * @param[in]  to       last time stamp of the range
+ * @param[out] times    time stamps of the samples
+ * @param[out] data     samples
+ * @param[in]  max      capacity of @p times and @p data
+ *
+ * @return  number of samples copied, at most @p max
+ */
+size_t phydat_ts_query(const phydat_ts_t *ts, uint32_t from, uint32_t to,
+                       uint32_t *times, phydat_t *data, size_t max);
+
+/**
+ * @brief   Returns the usage of a store
+ *
+ * @param[in]  ts       store
+ * @param[out] usage    usage
+ */
+void phydat_ts_usage(const phydat_ts_t *ts, phydat_ts_usage_t *usage);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PHYDAT_TS_H */
+/** @} */
@@ -0,0 +1,399 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     phydat_ts
+ * @{
+ *
+ * @file
+ * @brief       Time series store implementation
+ *
+ * @}
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "phydat_ts.h"
+
+/* a zig-zag encoded 32 bit value takes at most 5 varint bytes */
+#define VARINT_MAX      (5U)
+#define SAMPLE_MAX      (VARINT_MAX * (1 + PHYDAT_DIM))
+
+static size_t _put_varint(uint8_t *buf, int32_t value)
+{
+    /* zig-zag maps small magnitudes of either sign to small numbers */
+    uint32_t zz = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    size_t len = 0;
+
+    while (zz >= 0x80) {
+        buf[len++] = (zz & 0x7f) | 0x80;
+        zz >>= 7;
+    }
+    buf[len++] = zz;
+    return len;
+}
+
+/* returns the number of bytes read, 0 if the data ends early */
+static size_t _get_varint(const uint8_t *buf, size_t len, int32_t *value)
+{
+    uint32_t zz = 0;
+
+    for (size_t i = 0; i < len && i < VARINT_MAX; i++) {
+        zz |= (uint32_t)(buf[i] & 0x7f) << (7 * i);
+        if (!(buf[i] & 0x80)) {
+            *value = (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/* Compares time stamps across a wrap of the clock, see phydat_ts_append */
+static bool _before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+static phydat_ts_block_t *_block(const phydat_ts_t *ts, unsigned idx)
+{
+    return &ts->blocks[(ts->first + idx) % ts->num];
+}
+
+static void _delta_start(phydat_ts_delta_t *delta,
+                         const phydat_ts_block_hdr_t *hdr)
+{
+    memset(delta, 0, sizeof(*delta));
+    delta->time = hdr->first;
+    memcpy(delta->val, hdr->val, sizeof(delta->val));
+}
+
+#if IS_USED(MODULE_MTD)
+static uint32_t _slot_page(const phydat_ts_spill_t *spill, uint32_t slot)
+{
+    mtd_dev_t *mtd = spill->mtd;
+    uint32_t sector = spill->sector + slot / spill->slots_per_sector;
+
+    return sector * mtd->pages_per_sector +
+           (slot % spill->slots_per_sector) * spill->pages_per_slot;
+}
+
+static int _spill_read(const phydat_ts_spill_t *spill, uint32_t slot,
+                       void *dst, size_t len)
+{
+    return mtd_read_page(spill->mtd, dst, _slot_page(spill, slot), 0, len);
+}
+
+/* Writes a block to the next slot, erasing its sector first when it is the
+ * first slot of the sector and dropping the blocks still stored there */
+static void _spill_write(phydat_ts_t *ts, const phydat_ts_block_t *blk)
+{
+    phydat_ts_spill_t *spill = &ts->spill;
+    uint32_t slot = (spill->first + spill->count) % spill->slots;
+
+    if (slot % spill->slots_per_sector == 0) {
+        while (spill->count > spill->slots - spill->slots_per_sector) {
+            phydat_ts_block_hdr_t hdr;
+            if (_spill_read(spill, spill->first, &hdr, sizeof(hdr)) == 0) {
+                spill->samples -= hdr.count;
+                spill->bytes -= sizeof(hdr) + hdr.len;
+                ts->dropped += hdr.count;
+            }
+            spill->first = (spill->first + 1) % spill->slots;
+            spill->count--;
+        }
+        if (mtd_erase_sector(spill->mtd,
+                             spill->sector + slot / spill->slots_per_sector,
+                             1) < 0) {
+            ts->dropped += blk->hdr.count;
+            return;
+        }
+    }
+
+    if (mtd_write_page_raw(spill->mtd, blk, _slot_page(spill, slot), 0,
+                           sizeof(*blk)) < 0) {
+        ts->dropped += blk->hdr.count;
+        return;
+    }
+    spill->count++;
+    spill->samples += blk->hdr.count;
+    spill->bytes += sizeof(blk->hdr) + blk->hdr.len;
+}
+
+int phydat_ts_spill(phydat_ts_t *ts, mtd_dev_t *mtd, uint32_t sector,
+                    uint32_t sectors)
+{
+    uint32_t pages = DIV_ROUND_UP(sizeof(phydat_ts_block_t), mtd->page_size);
+
+    if (pages > mtd->pages_per_sector) {
+        return -EINVAL;
+    }
+
+    ts->spill = (phydat_ts_spill_t){
+        .mtd = mtd,
+        .sector = sector,
+        .slots_per_sector = mtd->pages_per_sector / pages,
+        .pages_per_slot = pages,
+    };
+    ts->spill.slots = sectors * ts->spill.slots_per_sector;
+    return 0;
+}
+#endif
+
+/* Makes room for a new block, returns it */
+static phydat_ts_block_t *_new_block(phydat_ts_t *ts)
+{
+    if (ts->used == ts->num) {
+        phydat_ts_block_t *oldest = _block(ts, 0);
+#if IS_USED(MODULE_MTD)
+        if (ts->spill.mtd) {
+            _spill_write(ts, oldest);
+        }
+        else
+#endif
+        {
+            ts->dropped += oldest->hdr.count;
+        }
+        ts->first = (ts->first + 1) % ts->num;
+        ts->used--;
+    }
+    return _block(ts, ts->used++);
+}
+
+void phydat_ts_init(phydat_ts_t *ts, phydat_ts_block_t *blocks, unsigned num)
+{
+    assert(num > 0);
+
+    memset(ts, 0, sizeof(*ts));
+    ts->blocks = blocks;
+    ts->num = num;
+}
+
+int phydat_ts_append(phydat_ts_t *ts, uint32_t time, const phydat_t *data,
+                     uint8_t dims)
+{
+    dims = MIN(dims, PHYDAT_DIM);
+
+    if (ts->used) {
+        phydat_ts_block_t *blk = _block(ts, ts->used - 1);
+        phydat_ts_delta_t *prev = &ts->prev;
+
+        if (_before(time, blk->hdr.last)) {
+            return -EINVAL;
+        }
+
+        if (blk->hdr.dims == dims && blk->hdr.unit == data->unit &&
+            blk->hdr.scale == data->scale) {
+            uint8_t enc[SAMPLE_MAX];
+            phydat_ts_delta_t next = { .time = time };
+            size_t len;
+
+            next.dtime = time - prev->time;
+            len = _put_varint(enc, next.dtime - prev->dtime);
+            for (unsigned d = 0; d < dims; d++) {
+                next.val[d] = data->val[d];
+                next.dval[d] = (int32_t)data->val[d] - prev->val[d];
+                len += _put_varint(&enc[len], next.dval[d] - prev->dval[d]);
+            }
+
+            if (blk->hdr.len + len <= PHYDAT_TS_BLOCK_DATA) {
+                memcpy(&blk->data[blk->hdr.len], enc, len);
+                blk->hdr.len += len;
+                blk->hdr.count++;
+                blk->hdr.last = time;
+                *prev = next;
+                return 0;
+            }
+        }
+    }
+
+    /* the sample does not fit or differs, it starts a new block */
+    phydat_ts_block_t *blk = _new_block(ts);
+    blk->hdr = (phydat_ts_block_hdr_t){
+        .first = time,
+        .last = time,
+        .count = 1,
+        .dims = dims,
+        .unit = data->unit,
+        .scale = data->scale,
+    };
+    memcpy(blk->hdr.val, data->val, dims * sizeof(data->val[0]));
+    _delta_start(&ts->prev, &blk->hdr);
+    return 0;
+}
+
+void phydat_ts_iter_init(const phydat_ts_t *ts, phydat_ts_iter_t *it,
+                         uint32_t from, uint32_t to)
+{
+    it->ts = ts;
+    it->from = from;
+    it->to = to;
+    it->block = 0;
+    it->blk = NULL;
+}
+
+/* Loads the first block at or after it->block that overlaps the range.
+ * Returns 1 if one was found, 0 at the end and a negative errno value if a
+ * spilled block could not be read. */
+static int _iter_load(phydat_ts_iter_t *it)
+{
+    const phydat_ts_t *ts = it->ts;
+    uint32_t total = ts->spill.count + ts->used;
+
+    for (; it->block < total; it->block++) {
+        const phydat_ts_block_t *blk;
+
+        if (it->block < ts->spill.count) {
+#if IS_USED(MODULE_MTD)
+            uint32_t slot = (ts->spill.first + it->block) % ts->spill.slots;
+            int res = _spill_read(&ts->spill, slot, &it->buf.hdr,
+                                  sizeof(it->buf.hdr));
+            if (res == 0 && !_before(it->buf.hdr.last, it->from) &&
+                !_before(it->to, it->buf.hdr.first)) {
+                res = _spill_read(&ts->spill, slot, &it->buf, sizeof(it->buf));
+            }
+            if (res < 0) {
+                return res;
+            }
+            blk = &it->buf;
+#else
+            return -ENODEV;
+#endif
+        }
+        else {
+            blk = _block(ts, it->block - ts->spill.count);
+        }
+
+        if (_before(it->to, blk->hdr.first)) {
+            break;
+        }
+        if (!_before(blk->hdr.last, it->from)) {
+            it->blk = blk;
+            it->pos = 0;
+            it->idx = 0;
+            return 1;
+        }
+    }
+
+    it->block = UINT32_MAX;
+    return 0;
+}
+
+/* Decodes the next sample of the current block into it->prev */
+static bool _iter_decode(phydat_ts_iter_t *it)
+{
+    const phydat_ts_block_t *blk = it->blk;
+    phydat_ts_delta_t *prev = &it->prev;
+
+    if (it->idx == 0) {
+        _delta_start(prev, &blk->hdr);
+        it->idx++;
+        return true;
+    }
+
+    int32_t dod;
+    size_t n = _get_varint(&blk->data[it->pos], blk->hdr.len - it->pos, &dod);
+    if (!n) {
+        return false;
+    }
+    it->pos += n;
+    prev->dtime += dod;
+    prev->time += prev->dtime;
+
+    for (unsigned d = 0; d < blk->hdr.dims; d++) {
+        n = _get_varint(&blk->data[it->pos], blk->hdr.len - it->pos, &dod);
+        if (!n) {
+            return false;
+        }
+        it->pos += n;
+        prev->dval[d] += dod;
+        prev->val[d] += prev->dval[d];
+    }
+    it->idx++;
+    return true;
+}
+
+int phydat_ts_iter_next(phydat_ts_iter_t *it, uint32_t *time, phydat_t *data)
+{
+    while (1) {
+        if (it->blk && it->idx == it->blk->hdr.count) {
+            it->blk = NULL;
+            it->block++;
+        }
+        if (!it->blk) {
+            int res = _iter_load(it);
+            if (res <= 0) {
+                return res;
+            }
+        }
+
+        if (!_iter_decode(it)) {
+            /* corrupted block, continue with the next one */
+            it->idx = it->blk->hdr.count;
+            continue;
+        }
+        if (_before(it->prev.time, it->from)) {
+            continue;
+        }
+        if (_before(it->to, it->prev.time)) {
+            it->blk = NULL;
+            it->block = UINT32_MAX;
+            return 0;
+        }
+
+        memset(data, 0, sizeof(*data));
+        memcpy(data->val, it->prev.val, sizeof(data->val));
+        data->unit = it->blk->hdr.unit;
+        data->scale = it->blk->hdr.scale;
+        *time = it->prev.time;
+        return it->blk->hdr.dims;
+    }
+}
+
+size_t phydat_ts_query(const phydat_ts_t *ts, uint32_t from, uint32_t to,
+                       uint32_t *times, phydat_t *data, size_t max)
+{
+    phydat_ts_iter_t it;
+    size_t count = 0;
+
+    phydat_ts_iter_init(ts, &it, from, to);
+    while (count < max &&
+           phydat_ts_iter_next(&it, &times[count], &data[count]) > 0) {
+        count++;
+    }
+    return count;
+}
+
+void phydat_ts_usage(const phydat_ts_t *ts, phydat_ts_usage_t *usage)
+{
+    memset(usage, 0, sizeof(*usage));
+    usage->blocks = ts->used;
+    usage->spilled = ts->spill.count;
+    usage->samples = ts->spill.samples;
+    usage->bytes = ts->spill.bytes;
+
+    for (unsigned i = 0; i < ts->used; i++) {
+        const phydat_ts_block_t *blk = _block(ts, i);
+        usage->samples += blk->hdr.count;
+        usage->bytes += sizeof(blk->hdr) + blk->hdr.len;
+    }
+
+    if (ts->used) {
+        usage->first = _block(ts, 0)->hdr.first;
+        usage->last = _block(ts, ts->used - 1)->hdr.last;
+    }
+#if IS_USED(MODULE_MTD)
+    phydat_ts_block_hdr_t hdr;
+    if (ts->spill.count &&
+        _spill_read(&ts->spill, ts->spill.first, &hdr, sizeof(hdr)) == 0) {
+        usage->first = hdr.first;
+    }
+#endif
+}
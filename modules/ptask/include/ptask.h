@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    ptask Stackless tasks
+ * @brief       Many cooperative tasks on the thread of one event queue
+ *
+ * A thread needs a stack of its own, as in 06-threads, which limits a node to
+ * a handful of them. A task here is a function that returns whenever it
+ * waits, in the style of protothreads, and is resumed where it left off. All
+ * tasks of an event queue share the stack of its thread, a task costs only
+ * its @ref ptask_t.
+ *
+ * A task waits for a timeout, for a @ref ptask_event_t or for flags of its
+ * own, the counterpart of thread flags. Whatever it waits for posts the task
+ * to its event queue, so tasks mix with the other events of the queue.
+ *
+ * A wait is a `case` label of the line it is on. Local variables of the task
+ * function are lost while it waits, a `switch` statement may not span a wait
+ * and a line may hold only one wait. Keep the state in a struct that holds
+ * the @ref ptask_t:
+ *
+ * ```
+ * typedef struct {
+ *     ptask_t task;
+ *     unsigned count;
+ * } blinky_t;
+ *
+ * static int _blinky(ptask_t *task)
+ * {
+ *     blinky_t *blinky = container_of(task, blinky_t, task);
+ *
+ *     PTASK_BEGIN(task);
+ *     for (blinky->count = 0; blinky->count < 10; blinky->count++) {
+ *         LED0_TOGGLE;
+ *         PTASK_SLEEP(task, ZTIMER_MSEC, 250);
+ *     }
+ *     PTASK_END(task);
+ * }
+ *
+ * ptask_start(&blinky.task, EVENT_PRIO_MEDIUM, _blinky);
+ * ```
+ * @{
+ *
+ * @file
+ * @brief       Stackless task definitions
+ */
+
+#ifndef PTASK_H
+#define PTASK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "event.h"
+#include "thread_flags.h"
+#include "ztimer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Returned by a task function that waits
+ */
+#define PTASK_WAITING       (0)
+
+/**
+ * @brief   Returned by a task function that is done
+ */
+#define PTASK_DONE          (1)
+
+typedef struct ptask ptask_t;
+
+/**
+ * @brief   Task function, runs on the thread of the event queue of the task
+ *
+ * @param[in] task      the task
+ *
+ * @return  @ref PTASK_WAITING or @ref PTASK_DONE, as left by the macros
+ */
+typedef int (*ptask_fn_t)(ptask_t *task);
+
+/**
+ * @brief   A task
+ */
+struct ptask {
+    event_t super;                  /**< posted to resume the task */
+    event_queue_t *queue;           /**< queue the task runs on */
+    ptask_fn_t fn;                  /**< task function */
+    ztimer_t timer;                 /**< timer of @ref PTASK_SLEEP */
+    ztimer_clock_t *clock;          /**< clock of @ref timer */
+    uint16_t line;                  /**< where the task waits, 0 at its
+                                         start */
+    thread_flags_t flags;           /**< flags set and not cleared yet */
+    bool expired;                   /**< the timer fired */
+    bool done;                      /**< the task function returned
+                                         @ref PTASK_DONE */
+};
+
+/**
+ * @brief   An event a task can wait for
+ *
+ * Posting an event that is not taken yet has no effect. One task at a time
+ * may wait for an event.
+ */
+typedef struct {
+    ptask_t *waiter;                /**< task waiting for the event */
+    bool posted;                    /**< posted and not taken yet */
+} ptask_event_t;
+
+/**
+ * @brief   Static initializer of an event
+ */
+#define PTASK_EVENT_INIT    { .waiter = NULL, .posted = false }
+
+/**
+ * @brief   Starts a task
+ *
+ * @param[out] task     task
+ * @param[in]  queue    queue the task runs on
+ * @param[in]  fn       task function
+ */
+void ptask_start(ptask_t *task, event_queue_t *queue, ptask_fn_t fn);
+
+/**
+ * @brief   Resumes a task to check what it waits for, may be called from
+ *          interrupts
+ *
+ * @param[in] task      task
+ */
+static inline void ptask_wake(ptask_t *task)
+{
+    event_post(task->queue, &task->super);
+}
+
+/**
+ * @brief   Sets flags of a task, may be called from interrupts
+ *
+ * @param[in,out] task  task
+ * @param[in]     flags flags to set
+ */
+void ptask_flags_set(ptask_t *task, thread_flags_t flags);
+
+/**
+ * @brief   Clears flags of a task
+ *
+ * @param[in,out] task  task
+ * @param[in]     mask  flags to clear
+ *
+ * @return  the flags of @p mask that were set
+ */
+thread_flags_t ptask_flags_clear(ptask_t *task, thread_flags_t mask);
+
+/**
+ * @brief   Posts an event, may be called from interrupts
+ *
+ * @param[in,out] event event
+ */
+void ptask_event_post(ptask_event_t *event);
+
+/**
+ * @brief   Takes a posted event
+ *
+ * @param[in,out] event event
+ *
+ * @return  true if the event was posted
+ */
+bool ptask_event_take(ptask_event_t *event);
+
+/**
+ * @brief   Arms the timer of a task, use @ref PTASK_SLEEP
+ *
+ * @param[in,out] task  task
+ * @param[in]     clock clock
+ * @param[in]     ticks time until the task is resumed
+ */
+void ptask_timer_set(ptask_t *task, ztimer_clock_t *clock, uint32_t ticks);
+
+/**
+ * @brief   Starts the body of a task function
+ *
+ * @param[in] task      task
+ */
+#define PTASK_BEGIN(task) \
+    switch ((task)->line) { \
+    case 0:
+
+/**
+ * @brief   Ends the body of a task function, the task is done
+ *
+ * @param[in] task      task
+ */
+#define PTASK_END(task) \
+    } \
+    (task)->line = 0; \
+    return PTASK_DONE
+
+/**
+ * @brief   Waits until a condition is true
+ *
+ * The condition is checked whenever the task is resumed.
+ *
+ * @param[in] task      task
+ * @param[in] cond      condition
+ */
+#define PTASK_AWAIT(task, cond) \
+    do { \
+        (task)->line = __LINE__; \
+        /* fall through */ \
+    case __LINE__: \
+        if (!(cond)) { \
+            return PTASK_WAITING; \
+        } \
+    } while (0)
+
+/**
+ * @brief   Lets the other events of the queue run first
+ *
+ * @param[in] task      task
+ */
+#define PTASK_YIELD(task) \
+    do { \
+        (task)->line = __LINE__; \
+        ptask_wake(task); \
+        return PTASK_WAITING; \
+    case __LINE__:; \
+    } while (0)
+
+/**
+ * @brief   Waits for a time
+ *
+ * @param[in] task      task
+ * @param[in] clock     clock, e.g. ZTIMER_MSEC
+ * @param[in] ticks     time to wait, in ticks of @p clock
+ */
+#define PTASK_SLEEP(task, clock, ticks) \
+    do { \
+        ptask_timer_set(task, clock, ticks); \
+        PTASK_AWAIT(task, (task)->expired); \
+    } while (0)
+
+/**
+ * @brief   Waits for an event and takes it
+ *
+ * @param[in] task      task
+ * @param[in] event     event
+ */
+#define PTASK_AWAIT_EVENT(task, event) \
+    do { \
+        (event)->waiter = (task); \
+        PTASK_AWAIT(task, ptask_event_take(event)); \
+    } while (0)
+
+/**
+ * @brief   Waits for any of a set of flags and clears them
+ *
+ * @param[in]  task     task
+ * @param[in]  mask     flags to wait for
+ * @param[out] result   lvalue that gets the flags of @p mask that were set
+ */
+#define PTASK_AWAIT_FLAGS(task, mask, result) \
+    do { \
+        PTASK_AWAIT(task, (task)->flags & (mask)); \
+        (result) = ptask_flags_clear(task, mask); \
+    } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PTASK_H */
+/** @} */
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     ptask
+ * @{
+ *
+ * @file
+ * @brief       Stackless task implementation
+ *
+ * @}
+ */
+
+#include "irq.h"
+#include "kernel_defines.h"
+
+#include "ptask.h"
+
+static void _run(event_t *event)
+{
+    ptask_t *task = container_of(event, ptask_t, super);
+
+    /* a wake-up may still come in after the task is done */
+    if (task->done) {
+        return;
+    }
+    if (task->fn(task) == PTASK_DONE) {
+        task->done = true;
+        if (task->clock) {
+            ztimer_remove(task->clock, &task->timer);
+        }
+    }
+}
+
+static void _timer_cb(void *arg)
+{
+    ptask_t *task = arg;
+
+    task->expired = true;
+    ptask_wake(task);
+}
+
+void ptask_start(ptask_t *task, event_queue_t *queue, ptask_fn_t fn)
+{
+    *task = (ptask_t){
+        .super = { .handler = _run },
+        .queue = queue,
+        .fn = fn,
+        .timer = { .callback = _timer_cb, .arg = task },
+    };
+    event_post(queue, &task->super);
+}
+
+void ptask_flags_set(ptask_t *task, thread_flags_t flags)
+{
+    unsigned state = irq_disable();
+    task->flags |= flags;
+    irq_restore(state);
+
+    ptask_wake(task);
+}
+
+thread_flags_t ptask_flags_clear(ptask_t *task, thread_flags_t mask)
+{
+    unsigned state = irq_disable();
+    thread_flags_t flags = task->flags & mask;
+    task->flags &= ~mask;
+    irq_restore(state);
+
+    return flags;
+}
+
+void ptask_event_post(ptask_event_t *event)
+{
+    unsigned state = irq_disable();
+    event->posted = true;
+    ptask_t *waiter = event->waiter;
+    irq_restore(state);
+
+    if (waiter) {
+        ptask_wake(waiter);
+    }
+}
+
+bool ptask_event_take(ptask_event_t *event)
+{
+    unsigned state = irq_disable();
+    bool posted = event->posted;
+    if (posted) {
+        event->posted = false;
+        event->waiter = NULL;
+    }
+    irq_restore(state);
+
+    return posted;
+}
+
+void ptask_timer_set(ptask_t *task, ztimer_clock_t *clock, uint32_t ticks)
+{
+    task->expired = false;
+    task->clock = clock;
+    ztimer_set(clock, &task->timer, ticks);
+}
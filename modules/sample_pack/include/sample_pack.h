@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    sample_pack Bit-packed sample batches
+ * @brief       Packs many periodic samples into one small payload
+ *
+ * Samples are collected between two transmissions and packed into one
+ * payload. A schema, known to sender and receiver by its ID, lists the fields
+ * of a sample. Each field of the batch is stored as a base value, the minimum
+ * of the batch, and the difference of each sample to it, with just as many
+ * bits as the largest difference needs. Values that change little within a
+ * batch take a few bits per sample.
+ *
+ * The payload is a bit stream, most significant bit first:
+ *
+ * | bits                  | content                                        |
+ * |-----------------------|------------------------------------------------|
+ * | 8                     | schema ID                                      |
+ * | 8                     | number of samples n                            |
+ * | 16                    | period between two samples in s                |
+ * | per field: bits + 5   | base value, two's complement if signed, and    |
+ * |                       | width w of the differences                     |
+ * | n * sum of w          | differences, sample by sample, oldest first    |
+ *
+ * The last sample was taken shortly before the transmission, sample i of n
+ * one period times n - 1 - i before it.
+ * @{
+ *
+ * @file
+ * @brief       Sample packing definitions
+ */
+
+#ifndef SAMPLE_PACK_H
+#define SAMPLE_PACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Maximum number of fields of a schema
+ */
+#ifndef CONFIG_SAMPLE_PACK_FIELDS_MAX
+#define CONFIG_SAMPLE_PACK_FIELDS_MAX   (4U)
+#endif
+
+/**
+ * @brief   Maximum number of samples in one payload
+ */
+#define SAMPLE_PACK_COUNT_MAX           (UINT8_MAX)
+
+/**
+ * @brief   A field of a sample
+ */
+typedef struct {
+    uint8_t bits;               /**< width of a value, at most 16 */
+    bool is_signed;             /**< values may be negative */
+} sample_pack_field_t;
+
+/**
+ * @brief   Fields of a sample
+ */
+typedef struct {
+    uint8_t id;                         /**< ID sent with the payload */
+    uint8_t fields;                     /**< number of fields */
+    const sample_pack_field_t *field;   /**< the fields */
+} sample_pack_schema_t;
+
+/**
+ * @brief   Samples collected for packing
+ */
+typedef struct {
+    const sample_pack_schema_t *schema; /**< schema of the samples */
+    int16_t *values;                    /**< values, sample by sample */
+    uint16_t capacity;                  /**< samples @ref values can hold */
+    uint16_t count;                     /**< samples collected */
+    uint16_t period;                    /**< period of the samples in s */
+} sample_pack_t;
+
+/**
+ * @brief   Header of a decoded payload
+ */
+typedef struct {
+    const sample_pack_schema_t *schema; /**< schema of the samples */
+    uint16_t count;                     /**< number of samples */
+    uint16_t period;                    /**< period of the samples in s */
+} sample_pack_info_t;
+
+/**
+ * @brief   Initializes a collection of samples
+ *
+ * @param[out] pack     collection
+ * @param[in]  schema   schema of the samples
+ * @param[in]  values   room for @p capacity samples of @p schema
+ * @param[in]  capacity number of samples @p values can hold
+ * @param[in]  period   period of the samples in s
+ */
+void sample_pack_init(sample_pack_t *pack, const sample_pack_schema_t *schema,
+                      int16_t *values, uint16_t capacity, uint16_t period);
+
+/**
+ * @brief   Adds a sample
+ *
+ * Values that do not fit into their field are clamped.
+ *
+ * @param[in,out] pack      collection
+ * @param[in]     sample    one value per field of the schema
+ *
+ * @return  0 on success
+ * @return  -ENOBUFS if the oldest sample was dropped to make room
+ */
+int sample_pack_add(sample_pack_t *pack, const int16_t *sample);
+
+/**
+ * @brief   Returns the size of a payload of the oldest samples
+ *
+ * @param[in] pack      collection
+ * @param[in] count     number of samples, at most the number collected
+ *
+ * @return  size of the payload in bytes
+ */
+size_t sample_pack_size(const sample_pack_t *pack, size_t count);
+
+/**
+ * @brief   Returns how many of the oldest samples fit into a payload
+ *
+ * @param[in] pack      collection
+ * @param[in] len       maximum size of the payload
+ *
+ * @return  number of samples
+ */
+size_t sample_pack_fit(const sample_pack_t *pack, size_t len);
+
+/**
+ * @brief   Packs as many of the oldest samples as fit and removes them
+ *
+ * @param[in,out] pack  collection
+ * @param[out]    buf   payload
+ * @param[in]     len   size of @p buf
+ *
+ * @return  size of the payload, 0 if no sample fits
+ */
+size_t sample_pack_encode(sample_pack_t *pack, uint8_t *buf, size_t len);
+
+/**
+ * @brief   Unpacks a payload
+ *
+ * @param[in]  buf      payload
+ * @param[in]  len      size of the payload
+ * @param[in]  schemas  known schemas
+ * @param[in]  num      number of @p schemas
+ * @param[out] info     schema, number and period of the samples
+ * @param[out] values   values, sample by sample
+ * @param[in]  max      number of values @p values can hold
+ *
+ * @return  number of samples
+ * @return  -ENOENT if the schema is unknown
+ * @return  -EBADMSG if the payload is truncated
+ * @return  -ENOBUFS if @p values is too small
+ */
+int sample_pack_decode(const uint8_t *buf, size_t len,
+                       const sample_pack_schema_t *const *schemas, size_t num,
+                       sample_pack_info_t *info, int16_t *values, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SAMPLE_PACK_H */
+/** @} */
@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     sample_pack
+ * @{
+ *
+ * @file
+ * @brief       Sample packing implementation
+ *
+ * @}
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+#include "kernel_defines.h"
+#include "sample_pack.h"
+
+#define WIDTH_BITS      (5U)
+#define HEADER_BITS     (8U + 8U + 16U)
+
+typedef struct {
+    uint8_t *buf;
+    size_t pos;             /* in bits */
+} _writer_t;
+
+typedef struct {
+    const uint8_t *buf;
+    size_t pos;             /* in bits */
+    size_t len;             /* in bits */
+} _reader_t;
+
+static void _put(_writer_t *w, uint32_t value, unsigned bits)
+{
+    while (bits--) {
+        if ((value >> bits) & 1) {
+            w->buf[w->pos >> 3] |= 0x80 >> (w->pos & 7);
+        }
+        w->pos++;
+    }
+}
+
+static bool _get(_reader_t *r, unsigned bits, uint32_t *value)
+{
+    if (r->pos + bits > r->len) {
+        return false;
+    }
+    *value = 0;
+    while (bits--) {
+        *value = (*value << 1) | ((r->buf[r->pos >> 3] >> (7 - (r->pos & 7))) & 1);
+        r->pos++;
+    }
+    return true;
+}
+
+static int32_t _field_min(const sample_pack_field_t *field)
+{
+    return field->is_signed ? -(1L << (field->bits - 1)) : 0;
+}
+
+static int32_t _field_max(const sample_pack_field_t *field)
+{
+    return field->is_signed ? (1L << (field->bits - 1)) - 1
+                            : (1L << field->bits) - 1;
+}
+
+/* bits needed for the difference of two values of a field */
+static unsigned _width(int32_t min, int32_t max)
+{
+    uint32_t range = max - min;
+    unsigned bits = 0;
+
+    while (range) {
+        range >>= 1;
+        bits++;
+    }
+    return bits;
+}
+
+static size_t _header_bits(const sample_pack_schema_t *schema)
+{
+    size_t bits = HEADER_BITS;
+
+    for (unsigned f = 0; f < schema->fields; f++) {
+        bits += schema->field[f].bits + WIDTH_BITS;
+    }
+    return bits;
+}
+
+/* Finds minimum and width of each field over the oldest samples, returns the
+ * bits per sample */
+static size_t _ranges(const sample_pack_t *pack, size_t count, int16_t *min,
+                      uint8_t *width)
+{
+    const sample_pack_schema_t *schema = pack->schema;
+    size_t bits = 0;
+
+    for (unsigned f = 0; f < schema->fields; f++) {
+        int16_t lo = pack->values[f];
+        int16_t hi = lo;
+        for (size_t i = 1; i < count; i++) {
+            int16_t value = pack->values[i * schema->fields + f];
+            lo = MIN(lo, value);
+            hi = MAX(hi, value);
+        }
+        min[f] = lo;
+        width[f] = _width(lo, hi);
+        bits += width[f];
+    }
+    return bits;
+}
+
+void sample_pack_init(sample_pack_t *pack, const sample_pack_schema_t *schema,
+                      int16_t *values, uint16_t capacity, uint16_t period)
+{
+    assert(schema->fields <= CONFIG_SAMPLE_PACK_FIELDS_MAX);
+
+    pack->schema = schema;
+    pack->values = values;
+    pack->capacity = capacity;
+    pack->count = 0;
+    pack->period = period;
+}
+
+int sample_pack_add(sample_pack_t *pack, const int16_t *sample)
+{
+    const sample_pack_schema_t *schema = pack->schema;
+    int res = 0;
+
+    if (pack->count == pack->capacity) {
+        memmove(pack->values, &pack->values[schema->fields],
+                (pack->count - 1) * schema->fields * sizeof(pack->values[0]));
+        pack->count--;
+        res = -ENOBUFS;
+    }
+
+    int16_t *dst = &pack->values[pack->count * schema->fields];
+    for (unsigned f = 0; f < schema->fields; f++) {
+        int32_t value = sample[f];
+        value = MAX(value, _field_min(&schema->field[f]));
+        value = MIN(value, _field_max(&schema->field[f]));
+        dst[f] = value;
+    }
+    pack->count++;
+    return res;
+}
+
+size_t sample_pack_size(const sample_pack_t *pack, size_t count)
+{
+    int16_t min[CONFIG_SAMPLE_PACK_FIELDS_MAX];
+    uint8_t width[CONFIG_SAMPLE_PACK_FIELDS_MAX];
+
+    count = MIN(count, MIN(pack->count, SAMPLE_PACK_COUNT_MAX));
+    if (!count) {
+        return 0;
+    }
+
+    size_t bits = _header_bits(pack->schema) +
+                  count * _ranges(pack, count, min, width);
+    return DIV_ROUND_UP(bits, 8);
+}
+
+size_t sample_pack_fit(const sample_pack_t *pack, size_t len)
+{
+    const sample_pack_schema_t *schema = pack->schema;
+    int16_t lo[CONFIG_SAMPLE_PACK_FIELDS_MAX];
+    int16_t hi[CONFIG_SAMPLE_PACK_FIELDS_MAX];
+    size_t header = _header_bits(schema);
+    size_t limit = MIN(pack->count, SAMPLE_PACK_COUNT_MAX);
+    size_t n;
+
+    /* the size only grows with the number of samples, add one at a time */
+    for (n = 0; n < limit; n++) {
+        const int16_t *sample = &pack->values[n * schema->fields];
+        size_t bits = 0;
+
+        for (unsigned f = 0; f < schema->fields; f++) {
+            lo[f] = n ? MIN(lo[f], sample[f]) : sample[f];
+            hi[f] = n ? MAX(hi[f], sample[f]) : sample[f];
+            bits += _width(lo[f], hi[f]);
+        }
+        if (header + (n + 1) * bits > len * 8) {
+            break;
+        }
+    }
+    return n;
+}
+
+size_t sample_pack_encode(sample_pack_t *pack, uint8_t *buf, size_t len)
+{
+    const sample_pack_schema_t *schema = pack->schema;
+    int16_t min[CONFIG_SAMPLE_PACK_FIELDS_MAX];
+    uint8_t width[CONFIG_SAMPLE_PACK_FIELDS_MAX];
+    size_t count = sample_pack_fit(pack, len);
+
+    if (!count) {
+        return 0;
+    }
+
+    size_t bits = _header_bits(schema) +
+                  count * _ranges(pack, count, min, width);
+    _writer_t w = { .buf = buf };
+
+    memset(buf, 0, DIV_ROUND_UP(bits, 8));
+    _put(&w, schema->id, 8);
+    _put(&w, count, 8);
+    _put(&w, pack->period, 16);
+    for (unsigned f = 0; f < schema->fields; f++) {
+        _put(&w, (uint16_t)min[f], schema->field[f].bits);
+        _put(&w, width[f], WIDTH_BITS);
+    }
+    for (size_t i = 0; i < count; i++) {
+        const int16_t *sample = &pack->values[i * schema->fields];
+        for (unsigned f = 0; f < schema->fields; f++) {
+            _put(&w, (int32_t)sample[f] - min[f], width[f]);
+        }
+    }
+
+    /* the packed samples are gone, move the rest to the front */
+    pack->count -= count;
+    memmove(pack->values, &pack->values[count * schema->fields],
+            pack->count * schema->fields * sizeof(pack->values[0]));
+    return DIV_ROUND_UP(bits, 8);
+}
+
+int sample_pack_decode(const uint8_t *buf, size_t len,
+                       const sample_pack_schema_t *const *schemas, size_t num,
+                       sample_pack_info_t *info, int16_t *values, size_t max)
+{
+    _reader_t r = { .buf = buf, .len = len * 8 };
+    int32_t min[CONFIG_SAMPLE_PACK_FIELDS_MAX];
+    uint8_t width[CONFIG_SAMPLE_PACK_FIELDS_MAX];
+    uint32_t id, count, period, value;
+
+    if (!_get(&r, 8, &id) || !_get(&r, 8, &count) || !_get(&r, 16, &period)) {
+        return -EBADMSG;
+    }
+
+    const sample_pack_schema_t *schema = NULL;
+    for (size_t i = 0; i < num; i++) {
+        if (schemas[i]->id == id) {
+            schema = schemas[i];
+            break;
+        }
+    }
+    if (!schema) {
+        return -ENOENT;
+    }
+
+    for (unsigned f = 0; f < schema->fields; f++) {
+        const sample_pack_field_t *field = &schema->field[f];
+        if (!_get(&r, field->bits, &value)) {
+            return -EBADMSG;
+        }
+        /* sign extend negative base values */
+        min[f] = value;
+        if (field->is_signed && (value >> (field->bits - 1))) {
+            min[f] -= 1L << field->bits;
+        }
+        if (!_get(&r, WIDTH_BITS, &value) || value > 16) {
+            return -EBADMSG;
+        }
+        width[f] = value;
+    }
+
+    if (count * schema->fields > max) {
+        return -ENOBUFS;
+    }
+    for (size_t i = 0; i < count * schema->fields; i++) {
+        unsigned f = i % schema->fields;
+        if (!_get(&r, width[f], &value)) {
+            return -EBADMSG;
+        }
+        values[i] = min[f] + value;
+    }
+
+    info->schema = schema;
+    info->count = count;
+    info->period = period;
+    return count;
+}
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    saul_sampler SAUL sampler
+ * @brief       Periodic background reads of SAUL devices
+ *
+ * A single thread reads any number of SAUL devices, each with its own period.
+ * When the thread wakes up it also reads the devices that fall due within
+ * @ref CONFIG_SAUL_SAMPLER_GROUP_WINDOW, so that devices with related periods
+ * share wake-ups.
+ *
+ * The samples are stored with their time stamp in a ring buffer. Any number
+ * of threads can read it, each with its own cursor, without locking and
+ * without ever delaying the sampler. When a reader falls behind by more than
+ * the size of the ring it loses the oldest samples and is told so.
+ *
+ * The sampler is the only writer of the ring. The check for overwritten
+ * samples relies on a single core, as found on all MCUs supported by RIOT.
+ * @{
+ *
+ * @file
+ * @brief       SAUL sampler definitions
+ */
+
+#ifndef SAUL_SAMPLER_H
+#define SAUL_SAMPLER_H
+
+#include <stdint.h>
+
+#include "phydat.h"
+#include "saul_reg.h"
+#include "thread.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Maximum number of devices that are sampled
+ */
+#ifndef CONFIG_SAUL_SAMPLER_DEVS_MAX
+#define CONFIG_SAUL_SAMPLER_DEVS_MAX        (8U)
+#endif
+
+/**
+ * @brief   Number of samples kept in the ring buffer, a power of two
+ */
+#ifndef CONFIG_SAUL_SAMPLER_RING_SIZE
+#define CONFIG_SAUL_SAMPLER_RING_SIZE       (32U)
+#endif
+
+/**
+ * @brief   Devices due within this time of a wake-up are read with it, in ms
+ */
+#ifndef CONFIG_SAUL_SAMPLER_GROUP_WINDOW
+#define CONFIG_SAUL_SAMPLER_GROUP_WINDOW    (10U)
+#endif
+
+/**
+ * @brief   Priority of the sampler thread
+ *
+ * Readers of the ring buffer should run at a lower priority.
+ */
+#ifndef CONFIG_SAUL_SAMPLER_PRIO
+#define CONFIG_SAUL_SAMPLER_PRIO            (THREAD_PRIORITY_MAIN - 1)
+#endif
+
+/**
+ * @brief   Stack size of the sampler thread
+ */
+#ifndef CONFIG_SAUL_SAMPLER_STACKSIZE
+#define CONFIG_SAUL_SAMPLER_STACKSIZE       (THREAD_STACKSIZE_DEFAULT)
+#endif
+
+/**
+ * @brief   Thread flag set on the thread given to @ref saul_sampler_notify
+ *          after new samples were stored
+ */
+#ifndef CONFIG_SAUL_SAMPLER_NOTIFY_FLAG
+#define CONFIG_SAUL_SAMPLER_NOTIFY_FLAG     (0x0001U)
+#endif
+
+/**
+ * @brief   A timestamped sample of one device
+ */
+typedef struct {
+    uint32_t time;      /**< time of the read, ZTIMER_MSEC */
+    uint8_t dev;        /**< index of the device, see @ref saul_sampler_add */
+    uint8_t dims;       /**< number of valid dimensions in @p data */
+    phydat_t data;      /**< the value read */
+} saul_sampler_sample_t;
+
+/**
+ * @brief   Read position of one reader of the ring buffer
+ */
+typedef struct {
+    uint32_t seq;       /**< sequence number of the next sample to read */
+} saul_sampler_cursor_t;
+
+/**
+ * @brief   Statistics of the sampler
+ */
+typedef struct {
+    uint32_t wakeups;   /**< wake-ups that read at least one device */
+    uint32_t reads;     /**< successful reads */
+    uint32_t errors;    /**< failed reads */
+    uint32_t overruns;  /**< due times skipped because the sampler fell behind */
+    uint32_t late_max;  /**< longest delay of a read after its due time, ms */
+    uint32_t busy;      /**< time spent reading devices, us, only counted
+                             when ztimer_usec is used */
+} saul_sampler_stats_t;
+
+/**
+ * @brief   Starts the sampler thread
+ *
+ * @return  PID of the sampler thread
+ * @return  negative errno value on error
+ */
+int saul_sampler_init(void);
+
+/**
+ * @brief   Adds a device to sample
+ *
+ * The device is read for the first time right away.
+ *
+ * @param[in] dev       device to read
+ * @param[in] period    time between two reads, in ms
+ *
+ * @return  index of the device, used in its samples
+ * @return  -ENOMEM if @ref CONFIG_SAUL_SAMPLER_DEVS_MAX devices are sampled
+ */
+int saul_sampler_add(saul_reg_t *dev, uint32_t period);
+
+/**
+ * @brief   Stops sampling a device
+ *
+ * @param[in] idx       index returned by @ref saul_sampler_add
+ */
+void saul_sampler_remove(int idx);
+
+/**
+ * @brief   Returns the device sampled under an index
+ *
+ * @return  the device, NULL if the index is not used
+ */
+saul_reg_t *saul_sampler_dev(int idx);
+
+/**
+ * @brief   Sets the thread to notify about new samples
+ *
+ * After each wake-up that stored samples the sampler sets
+ * @ref CONFIG_SAUL_SAMPLER_NOTIFY_FLAG on the thread.
+ *
+ * @param[in] thread    thread to notify, NULL to notify none
+ */
+void saul_sampler_notify(thread_t *thread);
+
+/**
+ * @brief   Initializes a cursor, the first sample read is the next one stored
+ *
+ * @param[out] cursor   cursor to initialize
+ */
+void saul_sampler_cursor_init(saul_sampler_cursor_t *cursor);
+
+/**
+ * @brief   Reads the next sample from the ring buffer, never blocks
+ *
+ * @param[in,out] cursor    read position of the caller
+ * @param[out]    sample    sample read
+ *
+ * @return  1 if a sample was read
+ * @return  0 if there is no new sample
+ * @return  -EOVERFLOW if a sample was read, but older ones were lost
+ */
+int saul_sampler_read(saul_sampler_cursor_t *cursor,
+                      saul_sampler_sample_t *sample);
+
+/**
+ * @brief   Reads the statistics of the sampler
+ *
+ * @param[out] stats    statistics
+ */
+void saul_sampler_stats(saul_sampler_stats_t *stats);
+
+/**
+ * @brief   Resets the statistics of the sampler
+ */
+void saul_sampler_stats_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SAUL_SAMPLER_H */
+/** @} */
@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     saul_sampler
+ * @{
+ *
+ * @file
+ * @brief       SAUL sampler implementation
+ *
+ * @}
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "mutex.h"
+#include "thread_flags.h"
+#include "ztimer.h"
+
+#include "saul_sampler.h"
+
+static_assert((CONFIG_SAUL_SAMPLER_RING_SIZE &
+               (CONFIG_SAUL_SAMPLER_RING_SIZE - 1)) == 0,
+              "the ring size must be a power of two");
+static_assert(CONFIG_SAUL_SAMPLER_DEVS_MAX <= UINT8_MAX,
+              "device indices are stored in 8 bit");
+
+#define RING_MASK       (CONFIG_SAUL_SAMPLER_RING_SIZE - 1)
+
+/* wakes up the sampler after the device table changed */
+#define FLAG_WAKEUP     (0x0001U)
+
+typedef struct {
+    saul_reg_t *dev;    /**< device, NULL if the entry is free */
+    uint32_t period;    /**< time between two reads */
+    uint32_t due;       /**< time of the next read */
+} _entry_t;
+
+static _entry_t _entries[CONFIG_SAUL_SAMPLER_DEVS_MAX];
+static mutex_t _lock = MUTEX_INIT;
+
+static saul_sampler_sample_t _ring[CONFIG_SAUL_SAMPLER_RING_SIZE];
+/* number of samples ever stored, the next one goes to _head & RING_MASK */
+static atomic_uint_least32_t _head;
+
+static saul_sampler_stats_t _stats;
+static thread_t *_notify;
+static thread_t *_thread;
+static char _stack[CONFIG_SAUL_SAMPLER_STACKSIZE];
+
+static void _store(const saul_sampler_sample_t *sample)
+{
+    uint32_t head = atomic_load_explicit(&_head, memory_order_relaxed);
+
+    /* readers detect that this slot is being overwritten by the head value,
+     * it is only advanced once the sample is complete */
+    _ring[head & RING_MASK] = *sample;
+    atomic_store_explicit(&_head, head + 1, memory_order_release);
+}
+
+/* Reads all devices due before @p until, returns the number of samples */
+static unsigned _read_due(uint32_t now, uint32_t until)
+{
+    unsigned count = 0;
+
+    for (unsigned i = 0; i < ARRAY_SIZE(_entries); i++) {
+        _entry_t *entry = &_entries[i];
+        if (!entry->dev || (int32_t)(entry->due - until) > 0) {
+            continue;
+        }
+
+        saul_sampler_sample_t sample = { .dev = i };
+        int dims = saul_reg_read(entry->dev, &sample.data);
+        sample.time = ztimer_now(ZTIMER_MSEC);
+
+        if ((int32_t)(sample.time - entry->due) > (int32_t)_stats.late_max) {
+            _stats.late_max = sample.time - entry->due;
+        }
+        if (dims > 0) {
+            sample.dims = dims;
+            _store(&sample);
+            _stats.reads++;
+            count++;
+        }
+        else {
+            _stats.errors++;
+        }
+
+        /* keep the phase of the device, unless it fell a period behind */
+        entry->due += entry->period;
+        if ((int32_t)(entry->due - now) <= 0) {
+            entry->due = now + entry->period;
+            _stats.overruns++;
+        }
+    }
+    return count;
+}
+
+/* Time until the next device is due, UINT32_MAX if there is none */
+static uint32_t _next_due(uint32_t now)
+{
+    uint32_t next = UINT32_MAX;
+
+    for (unsigned i = 0; i < ARRAY_SIZE(_entries); i++) {
+        if (!_entries[i].dev) {
+            continue;
+        }
+        int32_t until = _entries[i].due - now;
+        next = MIN(next, (uint32_t)MAX(until, 0));
+    }
+    return next;
+}
+
+static void *_sampler_thread(void *arg)
+{
+    (void)arg;
+    ztimer_t timer = { 0 };
+
+    while (1) {
+        mutex_lock(&_lock);
+        uint32_t now = ztimer_now(ZTIMER_MSEC);
+#if IS_USED(MODULE_ZTIMER_USEC)
+        uint32_t start = ztimer_now(ZTIMER_USEC);
+#endif
+        unsigned count = _read_due(now, now + CONFIG_SAUL_SAMPLER_GROUP_WINDOW);
+        if (count) {
+            _stats.wakeups++;
+#if IS_USED(MODULE_ZTIMER_USEC)
+            _stats.busy += ztimer_now(ZTIMER_USEC) - start;
+#endif
+        }
+        uint32_t wait = _next_due(ztimer_now(ZTIMER_MSEC));
+        thread_t *notify = _notify;
+        mutex_unlock(&_lock);
+
+        if (count && notify) {
+            thread_flags_set(notify, CONFIG_SAUL_SAMPLER_NOTIFY_FLAG);
+        }
+
+        if (wait == 0) {
+            continue;
+        }
+        if (wait != UINT32_MAX) {
+            ztimer_set_timeout_flag(ZTIMER_MSEC, &timer, wait);
+        }
+        thread_flags_wait_any(FLAG_WAKEUP | THREAD_FLAG_TIMEOUT);
+        ztimer_remove(ZTIMER_MSEC, &timer);
+    }
+
+    return NULL;
+}
+
+int saul_sampler_init(void)
+{
+    kernel_pid_t pid = thread_create(_stack, sizeof(_stack),
+                                     CONFIG_SAUL_SAMPLER_PRIO,
+                                     THREAD_CREATE_STACKTEST,
+                                     _sampler_thread, NULL, "saul_sampler");
+    if (pid < 0) {
+        return pid;
+    }
+    _thread = thread_get(pid);
+    return pid;
+}
+
+int saul_sampler_add(saul_reg_t *dev, uint32_t period)
+{
+    int idx = -ENOMEM;
+
+    mutex_lock(&_lock);
+    for (unsigned i = 0; i < ARRAY_SIZE(_entries); i++) {
+        if (!_entries[i].dev) {
+            _entries[i] = (_entry_t){
+                .dev = dev,
+                .period = period,
+                .due = ztimer_now(ZTIMER_MSEC),
+            };
+            idx = i;
+            break;
+        }
+    }
+    mutex_unlock(&_lock);
+
+    /* the new device may be due before the sampler wakes up */
+    if (idx >= 0 && _thread) {
+        thread_flags_set(_thread, FLAG_WAKEUP);
+    }
+    return idx;
+}
+
+void saul_sampler_remove(int idx)
+{
+    assert(idx >= 0 && (unsigned)idx < ARRAY_SIZE(_entries));
+
+    mutex_lock(&_lock);
+    _entries[idx].dev = NULL;
+    mutex_unlock(&_lock);
+}
+
+saul_reg_t *saul_sampler_dev(int idx)
+{
+    if (idx < 0 || (unsigned)idx >= ARRAY_SIZE(_entries)) {
+        return NULL;
+    }
+    return _entries[idx].dev;
+}
+
+void saul_sampler_notify(thread_t *thread)
+{
+    mutex_lock(&_lock);
+    _notify = thread;
+    mutex_unlock(&_lock);
+}
+
+void saul_sampler_cursor_init(saul_sampler_cursor_t *cursor)
+{
+    cursor->seq = atomic_load_explicit(&_head, memory_order_acquire);
+}
+
+int saul_sampler_read(saul_sampler_cursor_t *cursor,
+                      saul_sampler_sample_t *sample)
+{
+    int res = 1;
+    uint32_t head = atomic_load_explicit(&_head, memory_order_acquire);
+
+    while (cursor->seq != head) {
+        if (head - cursor->seq > CONFIG_SAUL_SAMPLER_RING_SIZE) {
+            /* the ring wrapped, continue with the oldest sample */
+            cursor->seq = head - CONFIG_SAUL_SAMPLER_RING_SIZE;
+            res = -EOVERFLOW;
+        }
+
+        *sample = _ring[cursor->seq & RING_MASK];
+
+        /* while the head is RING_SIZE ahead the sampler may be writing the
+         * slot that was just copied, the copy is only valid below that */
+        atomic_thread_fence(memory_order_acquire);
+        head = atomic_load_explicit(&_head, memory_order_relaxed);
+        if (head - cursor->seq < CONFIG_SAUL_SAMPLER_RING_SIZE) {
+            cursor->seq++;
+            return res;
+        }
+
+        /* skip past the slot being written instead of waiting for it */
+        cursor->seq = head - CONFIG_SAUL_SAMPLER_RING_SIZE + 1;
+        res = -EOVERFLOW;
+    }
+    return 0;
+}
+
+void saul_sampler_stats(saul_sampler_stats_t *stats)
+{
+    mutex_lock(&_lock);
+    *stats = _stats;
+    mutex_unlock(&_lock);
+}
+
+void saul_sampler_stats_reset(void)
+{
+    mutex_lock(&_lock);
+    memset(&_stats, 0, sizeof(_stats));
+    mutex_unlock(&_lock);
+}
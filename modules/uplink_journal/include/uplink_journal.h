@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    uplink_journal Uplink journal
+ * @brief       Keeps uplink payloads until they were delivered
+ *
+ * Payloads that could not be sent yet, because of the duty cycle, a missing
+ * join or a radio error, are kept as records in the journal. When the channel
+ * is free, as many records as fit are coalesced into one uplink, those of
+ * higher priority first and oldest first within a priority. The records stay
+ * in the journal until the uplink is acknowledged: for unconfirmed uplinks
+ * once it was sent, for confirmed uplinks once the network acknowledged it.
+ * Records of an uplink that failed are sent again with the next one.
+ *
+ * An uplink carries each record framed as:
+ *
+ * | bytes | content                                                    |
+ * |-------|------------------------------------------------------------|
+ * | 1     | length n of the record                                     |
+ * | 2     | age of the record when the uplink was built, in s, big     |
+ * |       | endian, at most 65535                                      |
+ * | n     | the record                                                 |
+ *
+ * The journal holds @ref CONFIG_UPLINK_JOURNAL_SIZE records in RAM. When it
+ * is full, the record of lowest priority, the oldest among them, is dropped,
+ * or, if a flash region was configured with @ref uplink_journal_spill,
+ * written to flash. Spilled records are read back as records in RAM are
+ * delivered. Spilled records survive a restart, those in RAM are lost. A
+ * record read back is tagged in flash, so that it is not read again after a
+ * restart. The tag takes a page per record.
+ *
+ * The journal is not thread safe, callers have to serialize access.
+ * @{
+ *
+ * @file
+ * @brief       Uplink journal definitions
+ */
+
+#ifndef UPLINK_JOURNAL_H
+#define UPLINK_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kernel_defines.h"
+#if IS_USED(MODULE_MTD)
+#include "mtd.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Number of records kept in RAM
+ */
+#ifndef CONFIG_UPLINK_JOURNAL_SIZE
+#define CONFIG_UPLINK_JOURNAL_SIZE          (8U)
+#endif
+
+/**
+ * @brief   Maximum size of a record, at most 255
+ */
+#ifndef CONFIG_UPLINK_JOURNAL_RECORD_MAX
+#define CONFIG_UPLINK_JOURNAL_RECORD_MAX    (64U)
+#endif
+
+/**
+ * @brief   Bytes an uplink adds to each record
+ */
+#define UPLINK_JOURNAL_FRAME                (3U)
+
+/**
+ * @brief   State of a record
+ */
+typedef enum {
+    UPLINK_JOURNAL_FREE,                /**< unused */
+    UPLINK_JOURNAL_PENDING,             /**< waiting to be sent */
+    UPLINK_JOURNAL_INFLIGHT,            /**< sent, not acknowledged yet */
+} uplink_journal_state_t;
+
+/**
+ * @brief   A record
+ */
+typedef struct {
+    uint32_t seq;                       /**< order in which it was added */
+    uint32_t time;                      /**< time it was added, in ms */
+    uint8_t prio;                       /**< priority, higher first */
+    uint8_t len;                        /**< length of the payload */
+    uint8_t state;                      /**< @ref uplink_journal_state_t */
+    uint8_t data[CONFIG_UPLINK_JOURNAL_RECORD_MAX]; /**< payload */
+} uplink_journal_record_t;
+
+/**
+ * @brief   Records spilled to flash
+ */
+typedef struct {
+#if IS_USED(MODULE_MTD) || DOXYGEN
+    mtd_dev_t *mtd;                     /**< flash device, NULL if not used */
+#endif
+    uint32_t sector;                    /**< first sector of the region */
+    uint32_t slots;                     /**< records the region can hold */
+    uint32_t first;                     /**< slot of the oldest record */
+    uint32_t count;                     /**< records in the region */
+    uint32_t pos;                       /**< position of the next write */
+    uint32_t restored;                  /**< records of the last run among
+                                             the oldest ones */
+    uint32_t restored_at;               /**< time of the restart, in ms */
+} uplink_journal_spill_t;
+
+/**
+ * @brief   Statistics of a journal
+ */
+typedef struct {
+    uint32_t added;                     /**< records added */
+    uint32_t delivered;                 /**< records acknowledged */
+    uint32_t retried;                   /**< records of failed uplinks */
+    uint32_t spilled;                   /**< records written to flash */
+    uint32_t dropped;                   /**< records lost */
+    uint32_t uplinks;                   /**< uplinks built */
+} uplink_journal_stats_t;
+
+/**
+ * @brief   A journal
+ */
+typedef struct {
+    uplink_journal_record_t records[CONFIG_UPLINK_JOURNAL_SIZE]; /**< RAM */
+    uplink_journal_spill_t spill;       /**< records in flash */
+    uplink_journal_stats_t stats;       /**< statistics */
+    uint32_t seq;                       /**< sequence number of the next
+                                             record */
+} uplink_journal_t;
+
+/**
+ * @brief   Initializes an empty journal
+ *
+ * @param[out] journal  journal
+ */
+void uplink_journal_init(uplink_journal_t *journal);
+
+#if IS_USED(MODULE_MTD) || DOXYGEN
+/**
+ * @brief   Spills records that would be dropped to a flash region
+ *
+ * The records the last run left in the region are taken over, they are sent
+ * before the records added after them. Their time in the last run is lost,
+ * their age counts from @p now. The region is erased sector by sector as it
+ * is written. Call it before records are added.
+ *
+ * @param[in,out] journal   journal
+ * @param[in]     mtd       flash device
+ * @param[in]     sector    first sector of the region
+ * @param[in]     sectors   number of sectors of the region, at least 2
+ * @param[in]     now       current time in ms
+ *
+ * @return  0 on success
+ * @return  -EINVAL if the region is too small or a page too short for a
+ *          record
+ */
+int uplink_journal_spill(uplink_journal_t *journal, mtd_dev_t *mtd,
+                         uint32_t sector, uint32_t sectors, uint32_t now);
+#endif
+
+/**
+ * @brief   Adds a record
+ *
+ * @param[in,out] journal   journal
+ * @param[in]     prio      priority, higher is sent first
+ * @param[in]     data      payload
+ * @param[in]     len       length of @p data
+ * @param[in]     now       current time in ms
+ *
+ * @return  0 on success
+ * @return  -EMSGSIZE if @p len exceeds @ref CONFIG_UPLINK_JOURNAL_RECORD_MAX
+ * @return  -ENOBUFS if the journal was full and a record was dropped, which
+ *          may be the new one
+ */
+int uplink_journal_add(uplink_journal_t *journal, uint8_t prio,
+                       const void *data, size_t len, uint32_t now);
+
+/**
+ * @brief   Builds an uplink of as many pending records as fit
+ *
+ * The records are in flight until @ref uplink_journal_ack or
+ * @ref uplink_journal_nack is called. No further uplink is built meanwhile.
+ *
+ * @param[in,out] journal   journal
+ * @param[out]    buf       uplink payload
+ * @param[in]     max       maximum size of the payload
+ * @param[in]     now       current time in ms
+ *
+ * @return  size of the payload, 0 if nothing is pending or an uplink is
+ *          in flight
+ */
+size_t uplink_journal_take(uplink_journal_t *journal, uint8_t *buf,
+                           size_t max, uint32_t now);
+
+/**
+ * @brief   Removes the records of the uplink in flight, it was delivered
+ *
+ * @param[in,out] journal   journal
+ */
+void uplink_journal_ack(uplink_journal_t *journal);
+
+/**
+ * @brief   Returns the records of the uplink in flight, it failed
+ *
+ * @param[in,out] journal   journal
+ */
+void uplink_journal_nack(uplink_journal_t *journal);
+
+/**
+ * @brief   Returns the number of records that were not delivered yet
+ *
+ * @param[in] journal   journal
+ *
+ * @return  records in RAM and in flash
+ */
+unsigned uplink_journal_pending(const uplink_journal_t *journal);
+
+/**
+ * @brief   Returns the size of the pending records in RAM
+ *
+ * @param[in]  journal  journal
+ * @param[in]  now      current time in ms
+ * @param[out] age      time the oldest of them waits, in ms, 0 if none
+ *
+ * @return  bytes they take in uplinks, including the framing
+ */
+size_t uplink_journal_backlog(const uplink_journal_t *journal, uint32_t now,
+                              uint32_t *age);
+
+/**
+ * @brief   Returns whether an uplink is in flight
+ *
+ * @param[in] journal   journal
+ *
+ * @return  true if records wait for @ref uplink_journal_ack or
+ *          @ref uplink_journal_nack
+ */
+bool uplink_journal_inflight(const uplink_journal_t *journal);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UPLINK_JOURNAL_H */
+/** @} */
@@ -0,0 +1,405 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     uplink_journal
+ * @{
+ *
+ * @file
+ * @brief       Uplink journal implementation
+ *
+ * @}
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "time_units.h"
+#include "uplink_journal.h"
+
+/* true if record a is sent before record b */
+static bool _before(const uplink_journal_record_t *a,
+                    const uplink_journal_record_t *b)
+{
+    if (a->prio != b->prio) {
+        return a->prio > b->prio;
+    }
+    return (int32_t)(a->seq - b->seq) < 0;
+}
+
+static uplink_journal_record_t *_find_free(uplink_journal_t *journal)
+{
+    for (unsigned i = 0; i < ARRAY_SIZE(journal->records); i++) {
+        if (journal->records[i].state == UPLINK_JOURNAL_FREE) {
+            return &journal->records[i];
+        }
+    }
+    return NULL;
+}
+
+/* Returns the oldest pending record of the lowest priority */
+static uplink_journal_record_t *_victim(uplink_journal_t *journal)
+{
+    uplink_journal_record_t *victim = NULL;
+
+    for (unsigned i = 0; i < ARRAY_SIZE(journal->records); i++) {
+        uplink_journal_record_t *rec = &journal->records[i];
+        if (rec->state != UPLINK_JOURNAL_PENDING) {
+            continue;
+        }
+        if (!victim || rec->prio < victim->prio ||
+            (rec->prio == victim->prio && _before(rec, victim))) {
+            victim = rec;
+        }
+    }
+    return victim;
+}
+
+#if IS_USED(MODULE_MTD)
+/* Tags of a slot in flash, neither is what erased flash reads */
+#define SLOT_RECORD     (0x554a5231UL)      /* "UJR1" */
+#define SLOT_TAKEN      (0x554a5454UL)      /* "UJTT" */
+
+/* A record in flash. The last page of its slot is left erased until the
+ * record is moved back to RAM, it is then tagged with SLOT_TAKEN. */
+typedef struct {
+    uint32_t tag;                       /* SLOT_RECORD */
+    uint32_t pos;                       /* position of the write */
+    uplink_journal_record_t rec;
+} _slot_t;
+
+static uint32_t _pages_per_slot(const mtd_dev_t *mtd)
+{
+    return DIV_ROUND_UP(sizeof(_slot_t), mtd->page_size) + 1;
+}
+
+static uint32_t _slot_page(const uplink_journal_spill_t *spill, uint32_t slot)
+{
+    uint32_t per_slot = _pages_per_slot(spill->mtd);
+    uint32_t per_sector = spill->mtd->pages_per_sector / per_slot;
+
+    return (spill->sector + slot / per_sector) * spill->mtd->pages_per_sector +
+           (slot % per_sector) * per_slot;
+}
+
+/* Reads a slot, returns true if it holds a record not moved to RAM yet */
+static bool _slot_read(const uplink_journal_spill_t *spill, uint32_t slot,
+                       _slot_t *stored)
+{
+    uint32_t page = _slot_page(spill, slot);
+    uint32_t taken;
+
+    if (mtd_read_page(spill->mtd, stored, page, 0, sizeof(*stored)) < 0 ||
+        mtd_read_page(spill->mtd, &taken,
+                      page + _pages_per_slot(spill->mtd) - 1, 0,
+                      sizeof(taken)) < 0) {
+        return false;
+    }
+    return stored->tag == SLOT_RECORD && taken != SLOT_TAKEN &&
+           stored->rec.state == UPLINK_JOURNAL_PENDING &&
+           stored->rec.len <= sizeof(stored->rec.data);
+}
+
+/* Removes the oldest record of the region */
+static void _spill_pop(uplink_journal_spill_t *spill)
+{
+    spill->first = (spill->first + 1) % spill->slots;
+    spill->count--;
+    if (spill->restored) {
+        spill->restored--;
+    }
+}
+
+/* Writes a record to the next slot, erasing its sector first when it is the
+ * first slot of the sector and dropping the records still stored there */
+static bool _spill_write(uplink_journal_t *journal,
+                         const uplink_journal_record_t *rec)
+{
+    uplink_journal_spill_t *spill = &journal->spill;
+    uint32_t per_sector = spill->mtd->pages_per_sector /
+                          _pages_per_slot(spill->mtd);
+    uint32_t slot = (spill->first + spill->count) % spill->slots;
+
+    if (slot % per_sector == 0) {
+        while (spill->count > spill->slots - per_sector) {
+            _spill_pop(spill);
+            journal->stats.dropped++;
+        }
+        if (mtd_erase_sector(spill->mtd, spill->sector + slot / per_sector,
+                             1) < 0) {
+            return false;
+        }
+    }
+
+    _slot_t stored = {
+        .tag = SLOT_RECORD,
+        .pos = spill->pos,
+        .rec = *rec,
+    };
+    if (mtd_write_page_raw(spill->mtd, &stored, _slot_page(spill, slot), 0,
+                           sizeof(stored)) < 0) {
+        return false;
+    }
+    spill->pos++;
+    spill->count++;
+    journal->stats.spilled++;
+    return true;
+}
+
+/* Moves spilled records back to free records in RAM, oldest first */
+static void _refill(uplink_journal_t *journal)
+{
+    uplink_journal_spill_t *spill = &journal->spill;
+    uplink_journal_record_t *rec;
+
+    while (spill->count && (rec = _find_free(journal))) {
+        _slot_t stored;
+        bool valid = _slot_read(spill, spill->first, &stored);
+        bool restored = spill->restored;
+
+        /* a record that fails to read is not read again after a restart */
+        uint32_t taken = SLOT_TAKEN;
+        mtd_write_page_raw(spill->mtd, &taken,
+                           _slot_page(spill, spill->first) +
+                           _pages_per_slot(spill->mtd) - 1, 0, sizeof(taken));
+        _spill_pop(spill);
+        if (!valid) {
+            journal->stats.dropped++;
+            continue;
+        }
+        *rec = stored.rec;
+        if (restored) {
+            /* the time of the last run is lost, they age from the restart */
+            rec->time = spill->restored_at;
+        }
+    }
+}
+
+/* Finds the records a restart left in the region. The slots of records not
+ * moved back to RAM follow each other in the ring, with consecutive write
+ * positions. */
+static void _recover(uplink_journal_t *journal, uint32_t now)
+{
+    uplink_journal_spill_t *spill = &journal->spill;
+    _slot_t stored;
+    _slot_t prev;
+
+    /* the oldest one is not preceded by the one written before it */
+    bool prev_valid = _slot_read(spill, spill->slots - 1, &prev);
+    for (uint32_t i = 0; i < spill->slots; i++) {
+        bool valid = _slot_read(spill, i, &stored);
+        if (valid && !(prev_valid && prev.pos + 1 == stored.pos)) {
+            spill->first = i;
+            break;
+        }
+        prev = stored;
+        prev_valid = valid;
+    }
+
+    uint32_t pos = 0;
+    while (spill->count < spill->slots &&
+           _slot_read(spill, (spill->first + spill->count) % spill->slots,
+                      &stored) &&
+           (!spill->count || stored.pos == pos + 1)) {
+        pos = stored.pos;
+        spill->count++;
+        /* new records are sent after them */
+        if (spill->count == 1 ||
+            (int32_t)(stored.rec.seq - journal->seq) >= 0) {
+            journal->seq = stored.rec.seq + 1;
+        }
+    }
+
+    spill->pos = spill->count ? pos + 1 : 0;
+    spill->restored = spill->count;
+    spill->restored_at = now;
+}
+
+int uplink_journal_spill(uplink_journal_t *journal, mtd_dev_t *mtd,
+                         uint32_t sector, uint32_t sectors, uint32_t now)
+{
+    uint32_t per_slot = _pages_per_slot(mtd);
+
+    if (sectors < 2 || per_slot > mtd->pages_per_sector) {
+        return -EINVAL;
+    }
+
+    journal->spill = (uplink_journal_spill_t){
+        .mtd = mtd,
+        .sector = sector,
+        .slots = sectors * (mtd->pages_per_sector / per_slot),
+    };
+    _recover(journal, now);
+    return 0;
+}
+#endif
+
+/* Makes room for a record, returns false if it was dropped */
+static bool _evict(uplink_journal_t *journal,
+                   const uplink_journal_record_t *rec)
+{
+#if IS_USED(MODULE_MTD)
+    if (journal->spill.mtd && _spill_write(journal, rec)) {
+        return true;
+    }
+#else
+    (void)rec;
+#endif
+    journal->stats.dropped++;
+    return false;
+}
+
+void uplink_journal_init(uplink_journal_t *journal)
+{
+    memset(journal, 0, sizeof(*journal));
+}
+
+int uplink_journal_add(uplink_journal_t *journal, uint8_t prio,
+                       const void *data, size_t len, uint32_t now)
+{
+    uplink_journal_record_t *rec;
+    int res = 0;
+
+    if (len > CONFIG_UPLINK_JOURNAL_RECORD_MAX) {
+        return -EMSGSIZE;
+    }
+    journal->stats.added++;
+
+    uplink_journal_record_t new = {
+        .seq = journal->seq++,
+        .time = now,
+        .prio = prio,
+        .len = len,
+        .state = UPLINK_JOURNAL_PENDING,
+    };
+    memcpy(new.data, data, len);
+
+    if (!(rec = _find_free(journal))) {
+        /* the new record goes if all others have a higher priority */
+        rec = _victim(journal);
+        if (!rec || new.prio < rec->prio) {
+            return _evict(journal, &new) ? 0 : -ENOBUFS;
+        }
+        if (!_evict(journal, rec)) {
+            res = -ENOBUFS;
+        }
+    }
+
+    *rec = new;
+    return res;
+}
+
+size_t uplink_journal_take(uplink_journal_t *journal, uint8_t *buf,
+                           size_t max, uint32_t now)
+{
+    uplink_journal_record_t *order[CONFIG_UPLINK_JOURNAL_SIZE];
+    unsigned num = 0;
+    size_t len = 0;
+
+    if (uplink_journal_inflight(journal)) {
+        return 0;
+    }
+
+    /* sort the pending records in the order they are sent */
+    for (unsigned i = 0; i < ARRAY_SIZE(journal->records); i++) {
+        uplink_journal_record_t *rec = &journal->records[i];
+        if (rec->state != UPLINK_JOURNAL_PENDING) {
+            continue;
+        }
+        unsigned pos = num++;
+        for (; pos > 0 && _before(rec, order[pos - 1]); pos--) {
+            order[pos] = order[pos - 1];
+        }
+        order[pos] = rec;
+    }
+
+    /* records that do not fit are left for the next uplink, smaller ones
+     * after them may still fit */
+    for (unsigned i = 0; i < num; i++) {
+        uplink_journal_record_t *rec = order[i];
+        if (len + UPLINK_JOURNAL_FRAME + rec->len > max) {
+            continue;
+        }
+
+        uint32_t age = MIN((now - rec->time) / MS_PER_SEC, UINT16_MAX);
+        buf[len++] = rec->len;
+        buf[len++] = age >> 8;
+        buf[len++] = age & 0xff;
+        memcpy(&buf[len], rec->data, rec->len);
+        len += rec->len;
+        rec->state = UPLINK_JOURNAL_INFLIGHT;
+    }
+
+    if (len) {
+        journal->stats.uplinks++;
+    }
+    return len;
+}
+
+void uplink_journal_ack(uplink_journal_t *journal)
+{
+    for (unsigned i = 0; i < ARRAY_SIZE(journal->records); i++) {
+        uplink_journal_record_t *rec = &journal->records[i];
+        if (rec->state == UPLINK_JOURNAL_INFLIGHT) {
+            rec->state = UPLINK_JOURNAL_FREE;
+            journal->stats.delivered++;
+        }
+    }
+#if IS_USED(MODULE_MTD)
+    _refill(journal);
+#endif
+}
+
+void uplink_journal_nack(uplink_journal_t *journal)
+{
+    for (unsigned i = 0; i < ARRAY_SIZE(journal->records); i++) {
+        uplink_journal_record_t *rec = &journal->records[i];
+        if (rec->state == UPLINK_JOURNAL_INFLIGHT) {
+            rec->state = UPLINK_JOURNAL_PENDING;
+            journal->stats.retried++;
+        }
+    }
+}
+
+unsigned uplink_journal_pending(const uplink_journal_t *journal)
+{
+    unsigned count = journal->spill.count;
+
+    for (unsigned i = 0; i < ARRAY_SIZE(journal->records); i++) {
+        if (journal->records[i].state != UPLINK_JOURNAL_FREE) {
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t uplink_journal_backlog(const uplink_journal_t *journal, uint32_t now,
+                              uint32_t *age)
+{
+    size_t bytes = 0;
+
+    *age = 0;
+    for (unsigned i = 0; i < ARRAY_SIZE(journal->records); i++) {
+        const uplink_journal_record_t *rec = &journal->records[i];
+        if (rec->state == UPLINK_JOURNAL_PENDING) {
+            bytes += UPLINK_JOURNAL_FRAME + rec->len;
+            *age = MAX(*age, now - rec->time);
+        }
+    }
+    return bytes;
+}
+
+bool uplink_journal_inflight(const uplink_journal_t *journal)
+{
+    for (unsigned i = 0; i < ARRAY_SIZE(journal->records); i++) {
+        if (journal->records[i].state == UPLINK_JOURNAL_INFLIGHT) {
+            return true;
+        }
+    }
+    return false;
+}
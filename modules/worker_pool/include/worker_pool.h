@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    worker_pool Worker pool
+ * @brief       Runs jobs on a fixed set of worker threads
+ *
+ * Instead of a hand-written thread with its own stack for each kind of work,
+ * as in 06-threads, jobs are submitted to a pool of worker threads. The pool
+ * holds the stacks of its workers, a `static` pool allocates everything at
+ * build time.
+ *
+ * Each worker has a bounded queue of jobs. A job is submitted to an idle
+ * worker if there is one, else to the workers in turn. A worker that runs out
+ * of jobs takes them from the queues of the others, so a worker blocked in a
+ * long job does not hold back the jobs queued behind it. The queues are
+ * lock-free, jobs can be submitted from interrupts and from any thread.
+ *
+ * When a job has run, its completion handler is posted to an event queue of
+ * the caller's choice.
+ *
+ * RIOT does not preempt threads of the same priority. On a single core, a
+ * worker runs until its job blocks, e.g. waits for a timer, a driver or a
+ * peripheral. The pool then hands the remaining jobs to the other workers.
+ *
+ * ```
+ * static worker_pool_t pool;
+ * static worker_job_t encode;
+ *
+ * worker_pool_start(&pool, THREAD_PRIORITY_MAIN - 1, "worker");
+ * worker_job_init(&encode, _encode, EVENT_PRIO_MEDIUM, _encoded, &data);
+ * worker_pool_submit(&pool, &encode);
+ * ```
+ * @{
+ *
+ * @file
+ * @brief       Worker pool definitions
+ */
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "event.h"
+#include "thread.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Worker threads of a pool
+ */
+#ifndef CONFIG_WORKER_POOL_WORKERS
+#define CONFIG_WORKER_POOL_WORKERS      (2U)
+#endif
+
+/**
+ * @brief   Jobs a worker can hold queued, a power of two
+ */
+#ifndef CONFIG_WORKER_POOL_QUEUE_SIZE
+#define CONFIG_WORKER_POOL_QUEUE_SIZE   (8U)
+#endif
+
+/**
+ * @brief   Stack size of a worker
+ */
+#ifndef CONFIG_WORKER_POOL_STACKSIZE
+#define CONFIG_WORKER_POOL_STACKSIZE    (THREAD_STACKSIZE_DEFAULT)
+#endif
+
+/**
+ * @brief   Thread flag that wakes up an idle worker
+ */
+#ifndef CONFIG_WORKER_POOL_THREAD_FLAG
+#define CONFIG_WORKER_POOL_THREAD_FLAG  (0x0004U)
+#endif
+
+typedef struct worker_job worker_job_t;
+typedef struct worker_pool worker_pool_t;
+
+/**
+ * @brief   Function of a job, the work in a worker or the completion in the
+ *          thread of the event queue
+ *
+ * @param[in] job       the job
+ */
+typedef void (*worker_job_fn_t)(worker_job_t *job);
+
+/**
+ * @brief   A job
+ */
+struct worker_job {
+    event_t super;                  /**< posted when the job has run */
+    worker_job_fn_t run;            /**< work, runs in a worker */
+    event_queue_t *queue;           /**< queue of the completion, may be NULL */
+    worker_job_fn_t done;           /**< completion, runs on @ref queue */
+    void *arg;                      /**< argument of the job */
+    atomic_bool busy;               /**< submitted and not completed yet */
+};
+
+/**
+ * @brief   A slot of the queue of a worker
+ */
+typedef struct {
+    atomic_uint_least32_t seq;      /**< round of the slot */
+    worker_job_t *job;              /**< the job */
+} worker_slot_t;
+
+/**
+ * @brief   A worker
+ */
+typedef struct {
+    worker_pool_t *pool;            /**< pool of the worker */
+    worker_slot_t slot[CONFIG_WORKER_POOL_QUEUE_SIZE]; /**< queued jobs */
+    atomic_uint_least32_t head;     /**< jobs ever taken */
+    atomic_uint_least32_t tail;     /**< jobs ever queued */
+    thread_t *thread;               /**< thread, NULL until it runs */
+    uint32_t runs;                  /**< jobs run */
+    uint32_t stolen;                /**< jobs taken from other workers */
+    char stack[CONFIG_WORKER_POOL_STACKSIZE]; /**< stack of the thread */
+} worker_t;
+
+/**
+ * @brief   A pool
+ */
+struct worker_pool {
+    worker_t workers[CONFIG_WORKER_POOL_WORKERS]; /**< workers */
+    atomic_uint idle;               /**< bit of each idle worker */
+    atomic_uint next;               /**< next worker to submit to */
+    atomic_uint_least32_t dropped;  /**< submits that found all queues full */
+};
+
+/**
+ * @brief   Initializes a pool and starts its workers
+ *
+ * @param[out] pool     pool
+ * @param[in]  priority priority of the workers
+ * @param[in]  name     name of the worker threads
+ */
+void worker_pool_start(worker_pool_t *pool, uint8_t priority,
+                       const char *name);
+
+/**
+ * @brief   Initializes a job
+ *
+ * @param[out] job      job
+ * @param[in]  run      work, runs in a worker
+ * @param[in]  queue    queue @p done is posted to, NULL for none
+ * @param[in]  done     completion, runs on @p queue, may be NULL
+ * @param[in]  arg      argument of the job
+ */
+void worker_job_init(worker_job_t *job, worker_job_fn_t run,
+                     event_queue_t *queue, worker_job_fn_t done, void *arg);
+
+/**
+ * @brief   Submits a job, may be called from interrupts
+ *
+ * A job can be submitted again once its completion runs, or once it has run
+ * if it has none.
+ *
+ * @param[in,out] pool  pool
+ * @param[in,out] job   job
+ *
+ * @return  0 on success
+ * @return  -EBUSY if the job is still submitted
+ * @return  -ENOBUFS if the queues of all workers are full
+ */
+int worker_pool_submit(worker_pool_t *pool, worker_job_t *job);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WORKER_POOL_H */
+/** @} */
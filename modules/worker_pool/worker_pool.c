@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     worker_pool
+ * @{
+ *
+ * @file
+ * @brief       Worker pool implementation
+ *
+ * The queue of a worker is a bounded multi-producer, multi-consumer ring:
+ * each slot carries a sequence number that tells whether it is free for the
+ * round of the tail or filled for the round of the head. Producers and
+ * consumers claim a slot by advancing tail or head with a compare-and-swap,
+ * so an interrupt never waits for the thread it interrupted.
+ *
+ * @}
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+#include "bitarithm.h"
+#include "kernel_defines.h"
+#include "thread_flags.h"
+
+#include "worker_pool.h"
+
+static_assert((CONFIG_WORKER_POOL_QUEUE_SIZE &
+               (CONFIG_WORKER_POOL_QUEUE_SIZE - 1)) == 0,
+              "the queue size must be a power of two");
+static_assert(CONFIG_WORKER_POOL_WORKERS <= 8 * sizeof(unsigned),
+              "the idle workers must fit in a mask");
+
+#define QUEUE_MASK      (CONFIG_WORKER_POOL_QUEUE_SIZE - 1)
+
+static bool _push(worker_t *worker, worker_job_t *job)
+{
+    uint32_t pos = atomic_load_explicit(&worker->tail, memory_order_relaxed);
+    worker_slot_t *slot;
+
+    while (1) {
+        slot = &worker->slot[pos & QUEUE_MASK];
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff < 0) {
+            /* the slot still holds a job of the last round */
+            return false;
+        }
+        if (diff == 0 &&
+            atomic_compare_exchange_weak_explicit(&worker->tail, &pos,
+                                                  pos + 1,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+            break;
+        }
+        if (diff > 0) {
+            pos = atomic_load_explicit(&worker->tail, memory_order_relaxed);
+        }
+    }
+
+    slot->job = job;
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    return true;
+}
+
+static worker_job_t *_take(worker_t *worker)
+{
+    uint32_t pos = atomic_load_explicit(&worker->head, memory_order_relaxed);
+    worker_slot_t *slot;
+
+    while (1) {
+        slot = &worker->slot[pos & QUEUE_MASK];
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int32_t diff = (int32_t)(seq - (pos + 1));
+        if (diff < 0) {
+            /* empty, or the job is not written yet */
+            return NULL;
+        }
+        if (diff == 0 &&
+            atomic_compare_exchange_weak_explicit(&worker->head, &pos,
+                                                  pos + 1,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+            break;
+        }
+        if (diff > 0) {
+            pos = atomic_load_explicit(&worker->head, memory_order_relaxed);
+        }
+    }
+
+    worker_job_t *job = slot->job;
+    atomic_store_explicit(&slot->seq, pos + CONFIG_WORKER_POOL_QUEUE_SIZE,
+                          memory_order_release);
+    return job;
+}
+
+/* Takes a job of the worker, else of the others, starting with the next */
+static worker_job_t *_find(worker_pool_t *pool, unsigned idx)
+{
+    worker_t *worker = &pool->workers[idx];
+    worker_job_t *job = _take(worker);
+
+    for (unsigned i = 1; !job && i < CONFIG_WORKER_POOL_WORKERS; i++) {
+        job = _take(&pool->workers[(idx + i) % CONFIG_WORKER_POOL_WORKERS]);
+        if (job) {
+            worker->stolen++;
+        }
+    }
+    return job;
+}
+
+static void _done(event_t *event)
+{
+    worker_job_t *job = container_of(event, worker_job_t, super);
+
+    atomic_store(&job->busy, false);
+    if (job->done) {
+        job->done(job);
+    }
+}
+
+static void *_worker(void *arg)
+{
+    worker_t *worker = arg;
+    worker_pool_t *pool = worker->pool;
+    unsigned idx = worker - pool->workers;
+
+    worker->thread = thread_get_active();
+
+    while (1) {
+        worker_job_t *job = _find(pool, idx);
+        if (!job) {
+            /* a submit after the idle bit is set sees it and wakes us up */
+            atomic_fetch_or(&pool->idle, 1U << idx);
+            job = _find(pool, idx);
+            if (!job) {
+                thread_flags_wait_any(CONFIG_WORKER_POOL_THREAD_FLAG);
+            }
+            atomic_fetch_and(&pool->idle, ~(1U << idx));
+            if (!job) {
+                continue;
+            }
+        }
+
+        job->run(job);
+        worker->runs++;
+
+        if (job->queue) {
+            event_post(job->queue, &job->super);
+        }
+        else {
+            atomic_store(&job->busy, false);
+        }
+    }
+
+    return NULL;
+}
+
+void worker_pool_start(worker_pool_t *pool, uint8_t priority,
+                       const char *name)
+{
+    memset(pool, 0, sizeof(*pool));
+    for (unsigned i = 0; i < CONFIG_WORKER_POOL_WORKERS; i++) {
+        pool->workers[i].pool = pool;
+        for (unsigned j = 0; j < CONFIG_WORKER_POOL_QUEUE_SIZE; j++) {
+            atomic_init(&pool->workers[i].slot[j].seq, j);
+        }
+    }
+
+    for (unsigned i = 0; i < CONFIG_WORKER_POOL_WORKERS; i++) {
+        thread_create(pool->workers[i].stack,
+                      sizeof(pool->workers[i].stack), priority,
+                      THREAD_CREATE_STACKTEST, _worker, &pool->workers[i],
+                      name);
+    }
+}
+
+void worker_job_init(worker_job_t *job, worker_job_fn_t run,
+                     event_queue_t *queue, worker_job_fn_t done, void *arg)
+{
+    *job = (worker_job_t){
+        .super = { .handler = _done },
+        .run = run,
+        .queue = queue,
+        .done = done,
+        .arg = arg,
+    };
+}
+
+int worker_pool_submit(worker_pool_t *pool, worker_job_t *job)
+{
+    if (atomic_exchange(&job->busy, true)) {
+        return -EBUSY;
+    }
+
+    unsigned idle = atomic_load(&pool->idle);
+    unsigned first = idle ? bitarithm_lsb(idle)
+                          : atomic_fetch_add(&pool->next, 1);
+    unsigned idx = 0;
+    bool queued = false;
+
+    for (unsigned i = 0; !queued && i < CONFIG_WORKER_POOL_WORKERS; i++) {
+        idx = (first + i) % CONFIG_WORKER_POOL_WORKERS;
+        queued = _push(&pool->workers[idx], job);
+    }
+    if (!queued) {
+        atomic_fetch_add(&pool->dropped, 1);
+        atomic_store(&job->busy, false);
+        return -ENOBUFS;
+    }
+
+    /* wake up the worker of the queue, else any idle one to take the job */
+    idle = atomic_load(&pool->idle);
+    if (idle) {
+        unsigned wake = (idle & (1U << idx)) ? idx : bitarithm_lsb(idle);
+        thread_flags_set(pool->workers[wake].thread,
+                         CONFIG_WORKER_POOL_THREAD_FLAG);
+    }
+    return 0;
+}
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2023 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @brief       Unit tests of the LoRaWAN data rate and batch policy
+ *
+ * The expected data rates follow from the demodulation floors of the policy
+ * and CONFIG_LORAWAN_POLICY_MARGIN, the expected uplinks from the time-on-air
+ * of lorawan_airtime.
+ */
+
+#include "embUnit.h"
+#include "lorawan_airtime.h"
+#include "lorawan_policy.h"
+
+#define MAX_DELAY       (15UL * 60UL * 1000UL)
+#define BUDGET          (30000UL)
+
+static const lorawan_policy_params_t _params = {
+    .dr_min = 0,
+    .dr_max = 5,
+    .dr_start = 5,
+    .max_delay = MAX_DELAY,
+};
+
+static lorawan_policy_t _policy;
+
+static void set_up(void)
+{
+    lorawan_policy_init(&_policy, &_params, 0);
+}
+
+static void test_dr_start(void)
+{
+    TEST_ASSERT_EQUAL_INT(5, lorawan_policy_dr(&_policy));
+}
+
+static void test_dr_margin(void)
+{
+    /* 10 dB above the floor of DR0: DR2 keeps 5 dB, DR3 does not */
+    lorawan_policy_link(&_policy, 0, 10);
+    TEST_ASSERT_EQUAL_INT(2, lorawan_policy_dr(&_policy));
+
+    /* exactly the margin is enough */
+    lorawan_policy_link(&_policy, 3, CONFIG_LORAWAN_POLICY_MARGIN);
+    TEST_ASSERT_EQUAL_INT(3, lorawan_policy_dr(&_policy));
+
+    /* no data rate keeps the margin */
+    lorawan_policy_link(&_policy, 0, 0);
+    TEST_ASSERT_EQUAL_INT(0, lorawan_policy_dr(&_policy));
+
+    /* DR6 would keep it, but is above dr_max */
+    lorawan_policy_link(&_policy, 0, 30);
+    TEST_ASSERT_EQUAL_INT(5, lorawan_policy_dr(&_policy));
+}
+
+static void test_dr_margin_of_other_dr(void)
+{
+    /* a margin reported for DR5 tells the SNR as well */
+    lorawan_policy_link(&_policy, 5, 0);
+    TEST_ASSERT_EQUAL_INT(3, lorawan_policy_dr(&_policy));
+}
+
+static void test_failure_backoff(void)
+{
+    lorawan_policy_link(&_policy, 4, CONFIG_LORAWAN_POLICY_MARGIN);
+    TEST_ASSERT_EQUAL_INT(4, lorawan_policy_dr(&_policy));
+
+    /* only consecutive failures count */
+    for (unsigned i = 1; i < CONFIG_LORAWAN_POLICY_FAIL_LIMIT; i++) {
+        lorawan_policy_result(&_policy, false);
+    }
+    lorawan_policy_result(&_policy, true);
+    lorawan_policy_result(&_policy, false);
+    TEST_ASSERT_EQUAL_INT(4, lorawan_policy_dr(&_policy));
+
+    for (unsigned i = 1; i < CONFIG_LORAWAN_POLICY_FAIL_LIMIT; i++) {
+        lorawan_policy_result(&_policy, false);
+    }
+    TEST_ASSERT_EQUAL_INT(3, lorawan_policy_dr(&_policy));
+
+    /* the steps stop at dr_min */
+    for (unsigned i = 0; i < 10 * CONFIG_LORAWAN_POLICY_FAIL_LIMIT; i++) {
+        lorawan_policy_result(&_policy, false);
+    }
+    TEST_ASSERT_EQUAL_INT(0, lorawan_policy_dr(&_policy));
+
+    /* the next report of the link undoes them */
+    lorawan_policy_link(&_policy, 4, CONFIG_LORAWAN_POLICY_MARGIN);
+    TEST_ASSERT_EQUAL_INT(4, lorawan_policy_dr(&_policy));
+}
+
+static void test_adr(void)
+{
+    lorawan_policy_link(&_policy, 0, 30);
+
+    /* the data rate of the network takes precedence over the link */
+    lorawan_policy_adr(&_policy, 1);
+    TEST_ASSERT_EQUAL_INT(1, lorawan_policy_dr(&_policy));
+
+    /* and over the steps after failures */
+    for (unsigned i = 0; i < CONFIG_LORAWAN_POLICY_FAIL_LIMIT; i++) {
+        lorawan_policy_result(&_policy, false);
+    }
+    TEST_ASSERT_EQUAL_INT(1, lorawan_policy_dr(&_policy));
+
+    /* but not over dr_max */
+    lorawan_policy_adr(&_policy, 6);
+    TEST_ASSERT_EQUAL_INT(5, lorawan_policy_dr(&_policy));
+
+    /* the policy picks again, with the steps it took meanwhile */
+    lorawan_policy_adr(&_policy, -1);
+    TEST_ASSERT_EQUAL_INT(4, lorawan_policy_dr(&_policy));
+}
+
+static void test_pick_waits_to_fill(void)
+{
+    lorawan_policy_pick_t pick;
+
+    TEST_ASSERT(!lorawan_policy_pick(&_policy, 0, 0, 0, &pick));
+    TEST_ASSERT_EQUAL_INT(MAX_DELAY, pick.wait);
+
+    TEST_ASSERT(!lorawan_policy_pick(&_policy, 10, 1000, 0, &pick));
+    TEST_ASSERT_EQUAL_INT(MAX_DELAY - 1000, pick.wait);
+
+    /* overdue data is sent as it is */
+    TEST_ASSERT(lorawan_policy_pick(&_policy, 10, MAX_DELAY, 0, &pick));
+    TEST_ASSERT_EQUAL_INT(5, pick.dr);
+    TEST_ASSERT_EQUAL_INT(10, pick.len);
+    TEST_ASSERT_EQUAL_INT(lorawan_airtime_toa(5, 10), pick.toa);
+
+    /* a full uplink right away */
+    size_t max = lorawan_airtime_max_payload(5);
+    TEST_ASSERT(lorawan_policy_pick(&_policy, max + 10, 0, 0, &pick));
+    TEST_ASSERT_EQUAL_INT(max, pick.len);
+}
+
+static void test_budget_raises_dr(void)
+{
+    lorawan_policy_params_t params = _params;
+    lorawan_policy_pick_t pick;
+
+    params.budget = BUDGET;
+    lorawan_policy_init(&_policy, &params, 0);
+
+    /* DR1 keeps the margin, DR2 is still demodulated */
+    lorawan_policy_link(&_policy, 1, CONFIG_LORAWAN_POLICY_MARGIN);
+
+    /* the rest of the budget only fits the uplink at DR2 */
+    lorawan_policy_sent(&_policy, BUDGET * 1000 - lorawan_airtime_toa(2, 20),
+                        0);
+    TEST_ASSERT(lorawan_policy_pick(&_policy, 20, MAX_DELAY, 0, &pick));
+    TEST_ASSERT_EQUAL_INT(2, pick.dr);
+    TEST_ASSERT_EQUAL_INT(20, pick.len);
+}
+
+static void test_budget_shrinks_uplink(void)
+{
+    lorawan_policy_params_t params = _params;
+    lorawan_policy_pick_t pick;
+
+    params.budget = BUDGET;
+    lorawan_policy_init(&_policy, &params, 0);
+
+    /* without a report no higher data rate is known to work */
+    uint32_t left = lorawan_airtime_toa(5, 10);
+    lorawan_policy_sent(&_policy, BUDGET * 1000 - left, 0);
+    TEST_ASSERT(lorawan_policy_pick(&_policy, 40, MAX_DELAY, 0, &pick));
+    TEST_ASSERT_EQUAL_INT(5, pick.dr);
+    TEST_ASSERT(pick.len >= 10 && pick.len < 40);
+    TEST_ASSERT(pick.toa <= left);
+    TEST_ASSERT(lorawan_airtime_toa(5, pick.len + 1) > left);
+}
+
+static void test_budget_holds_until_window(void)
+{
+    lorawan_policy_params_t params = _params;
+    lorawan_policy_pick_t pick;
+
+    params.budget = BUDGET;
+    lorawan_policy_init(&_policy, &params, 0);
+
+    lorawan_policy_sent(&_policy, BUDGET * 1000, 1000);
+    TEST_ASSERT(!lorawan_policy_pick(&_policy, 10, MAX_DELAY, 2000, &pick));
+    TEST_ASSERT_EQUAL_INT(CONFIG_LORAWAN_POLICY_WINDOW - 2000, pick.wait);
+
+    /* the next window brings the budget back */
+    TEST_ASSERT(lorawan_policy_pick(&_policy, 10, MAX_DELAY,
+                                    CONFIG_LORAWAN_POLICY_WINDOW, &pick));
+}
+
+static Test *tests_lorawan_policy(void)
+{
+    EMB_UNIT_TESTFIXTURES(fixtures) {
+        new_TestFixture(test_dr_start),
+        new_TestFixture(test_dr_margin),
+        new_TestFixture(test_dr_margin_of_other_dr),
+        new_TestFixture(test_failure_backoff),
+        new_TestFixture(test_adr),
+        new_TestFixture(test_pick_waits_to_fill),
+        new_TestFixture(test_budget_raises_dr),
+        new_TestFixture(test_budget_shrinks_uplink),
+        new_TestFixture(test_budget_holds_until_window),
+    };
+
+    EMB_UNIT_TESTCALLER(lorawan_policy_tests, set_up, NULL, fixtures);
+
+    return (Test *)&lorawan_policy_tests;
+}
+
+int main(void)
+{
+    TESTS_START();
+    TESTS_RUN(tests_lorawan_policy());
+    TESTS_END();
+
+    return 0;
+}